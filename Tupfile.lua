@@ -454,6 +454,9 @@ comp = 'etc/shaders/*.comp'
 function compileShaders(stage)
   pattern = 'etc/shaders/*.' .. stage
   tup.foreach_rule(pattern, 'glslangValidator --quiet --target-env vulkan1.1 --vn lovr_shader_%B_' .. stage .. ' -o %o %f', '%f.h')
+  if stage ~= 'comp' then
+    tup.foreach_rule(pattern, 'glslangValidator --quiet --target-env vulkan1.1 -DLOVR_BINDLESS --vn lovr_shader_%B_' .. stage .. '_bindless -o %o %f', '%f.bindless.h')
+  end
 end
 
 compileShaders('vert')
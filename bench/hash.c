@@ -0,0 +1,120 @@
+// Microbenchmark for hash64 at the places lovr hashes on a hot path.  Each case reproduces the
+// key that the real call site hashes and the map lookup that follows it, and runs it against the
+// FNV-1a hash that hash64 used to be, so a change to hash64 can be checked against both.
+//
+// Build with -DLOVR_BUILD_BENCH=ON and run lovr-bench-hash.
+
+#include "util.h"
+#include "core/gpu.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 15
+#define PATH_COUNT 2000
+
+typedef struct {
+  uint32_t hash;
+  uint32_t location;
+  uint32_t type;
+  uint32_t offset;
+} BufferField;
+
+static volatile uint64_t sink;
+static char paths[PATH_COUNT][64];
+
+static uint64_t fnv1a(const void* data, size_t length) {
+  const uint8_t* bytes = (const uint8_t*) data;
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3;
+  }
+  return hash;
+}
+
+static double now(void) {
+  struct timespec t;
+  timespec_get(&t, TIME_UTC);
+  return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// Best of several rounds, in nanoseconds per iteration
+#define BENCH(name, fn, iterations, body) do {\
+  double best = 1e30;\
+  for (int r = 0; r < ROUNDS; r++) {\
+    double start = now();\
+    for (int it = 0; it < (iterations); it++) { body }\
+    double t = (now() - start) / (iterations);\
+    if (t < best) best = t;\
+  }\
+  printf("%-24s %-8s %8.1f ns\n", name, #fn, best);\
+} while (0)
+
+// Synthetic archive paths, shaped like the files in a typical project (avg ~30 bytes)
+static void makePaths(void) {
+  const char* dirs[] = { "assets", "assets/models", "assets/textures/env", "shaders", "lib/ui", "sounds/sfx" };
+  const char* exts[] = { "png", "glb", "lua", "ktx2", "ogg", "glsl" };
+  for (int i = 0; i < PATH_COUNT; i++) {
+    snprintf(paths[i], sizeof(paths[i]), "%s/%s_%04d.%s", dirs[i % 6], i & 1 ? "item" : "level", i, exts[i / 6 % 6]);
+  }
+}
+
+#define RUN(fn) do {\
+  /* Pass:draw pipeline miss: hash the whole pipeline info, then look for a cached pipeline */\
+  static gpu_pipeline_info infos[64];\
+  map_t pipelines;\
+  map_init(&pipelines, 64);\
+  for (int i = 0; i < 64; i++) {\
+    memset(&infos[i], 0, sizeof(infos[i]));\
+    infos[i].shader = (gpu_shader*) (uintptr_t) (0x1000 + 64 * (i % 8));\
+    infos[i].drawMode = i % 3;\
+    infos[i].depth.test = i / 8 % 4;\
+    infos[i].attachmentCount = 1;\
+    map_set(&pipelines, fn(&infos[i], sizeof(infos[i])), i);\
+  }\
+  BENCH("pipeline lookup", fn, 200000, {\
+    gpu_pipeline_info* info = &infos[it & 63];\
+    sink += map_get(&pipelines, fn(info, sizeof(*info)));\
+  });\
+  map_free(&pipelines);\
+\
+  /* lovrGraphicsGetBuffer: hash a position/normal/uv vertex format */\
+  BufferField fields[3] = { { 1, 10, 3, 0 }, { 2, 11, 3, 12 }, { 3, 12, 2, 24 } };\
+  BENCH("buffer format", fn, 2000000, {\
+    fields[0].hash = it;\
+    sink += fn(fields, sizeof(fields));\
+  });\
+\
+  /* lovrFontGetGlyph: one lookup per character of ASCII text */\
+  const char* text = "The quick brown fox jumps over the lazy dog, 0123456789 times!";\
+  size_t length = strlen(text);\
+  map_t glyphs;\
+  map_init(&glyphs, 128);\
+  for (uint32_t c = 32; c < 127; c++) {\
+    map_set(&glyphs, fn(&c, 4), c);\
+  }\
+  BENCH("glyph lookup", fn, 2000000, {\
+    uint32_t c = (uint8_t) text[it % length];\
+    sink += map_get(&glyphs, fn(&c, 4));\
+  });\
+  map_free(&glyphs);\
+\
+  /* zip_lookup: hash a path and look it up in the archive index */\
+  map_t zip;\
+  map_init(&zip, PATH_COUNT);\
+  for (int i = 0; i < PATH_COUNT; i++) {\
+    map_set(&zip, fn(paths[i], strlen(paths[i])), i);\
+  }\
+  BENCH("zip lookup", fn, 1000000, {\
+    const char* path = paths[it % PATH_COUNT];\
+    sink += map_get(&zip, fn(path, strlen(path)));\
+  });\
+  map_free(&zip);\
+} while (0)
+
+int main(void) {
+  makePaths();
+  RUN(fnv1a);
+  RUN(hash64);
+  return 0;
+}
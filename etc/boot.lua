@@ -27,7 +27,11 @@ function lovr.boot()
       vsync = true,
       stencil = false,
       antialias = true,
-      shadercache = true
+      shadercache = true,
+      fontcache = true,
+      asyncpipelines = false,
+      asynccompute = false,
+      bindless = false
     },
     headset = {
       drivers = { 'openxr', 'webxr', 'desktop' },
@@ -1,16 +1,30 @@
 #include "shaders/unlit.vert.h"
+#include "shaders/unlit.vert.bindless.h"
 #include "shaders/unlit.frag.h"
+#include "shaders/unlit.frag.bindless.h"
 #include "shaders/normal.frag.h"
+#include "shaders/normal.frag.bindless.h"
+#include "shaders/font.vert.h"
+#include "shaders/font.vert.bindless.h"
 #include "shaders/font.frag.h"
+#include "shaders/font.frag.bindless.h"
 #include "shaders/cubemap.vert.h"
+#include "shaders/cubemap.vert.bindless.h"
 #include "shaders/cubemap.frag.h"
+#include "shaders/cubemap.frag.bindless.h"
 #include "shaders/equirect.frag.h"
+#include "shaders/equirect.frag.bindless.h"
 #include "shaders/fill.vert.h"
+#include "shaders/fill.vert.bindless.h"
 #include "shaders/fill_array.frag.h"
+#include "shaders/fill_array.frag.bindless.h"
 #include "shaders/fill_layer.frag.h"
+#include "shaders/fill_layer.frag.bindless.h"
 #include "shaders/animator.comp.h"
 #include "shaders/timewizard.comp.h"
+#include "shaders/cull.comp.h"
 #include "shaders/logo.frag.h"
+#include "shaders/logo.frag.bindless.h"
 
 #include "shaders/lovr.glsl.h"
 
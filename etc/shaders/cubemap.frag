@@ -4,7 +4,12 @@
 
 #include "lovr.glsl"
 
+#ifdef LOVR_BINDLESS
+layout(set = 1, binding = 1) uniform textureCube SkyboxTextures[];
+#define SkyboxTexture SkyboxTextures[MaterialTextureIndex(0u)]
+#else
 layout(set = 1, binding = 1) uniform textureCube SkyboxTexture;
+#endif
 
 vec4 lovrmain() {
   return Color * getPixel(SkyboxTexture, Normal * vec3(-1, 1, 1));
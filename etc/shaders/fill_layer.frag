@@ -4,7 +4,12 @@
 
 #include "lovr.glsl"
 
+#ifdef LOVR_BINDLESS
+layout(set = 1, binding = 1) uniform texture2DArray ArrayTextures[];
+#define ArrayTexture ArrayTextures[MaterialTextureIndex(0u)]
+#else
 layout(set = 1, binding = 1) uniform texture2DArray ArrayTexture;
+#endif
 
 vec4 lovrmain() {
   return Color * getPixel(ArrayTexture, UV, 0);
@@ -0,0 +1,22 @@
+#version 460
+#extension GL_EXT_multiview : require
+#extension GL_GOOGLE_include_directive : require
+
+#define LOVR_GLYPH_QUADS
+#include "lovr.glsl"
+
+// One instance per glyph, the quad's corners come from the vertex index
+layout(location = 0) in vec4 GlyphRect;
+layout(location = 1) in vec4 GlyphUV;
+layout(location = 2) in vec4 GlyphColor;
+
+vec4 lovrmain() {
+  const int corners[6] = int[6](0, 2, 1, 1, 2, 3);
+  int corner = corners[(VertexIndex - BaseVertex) % 6];
+  vec2 mask = vec2(corner & 1, corner >> 1);
+  vec4 position = vec4(mix(GlyphRect.xy, GlyphRect.zw, mask), 0., 1.);
+  UV = mix(GlyphUV.xy, GlyphUV.zw, mask);
+  if (flag_vertexColors) Color *= GlyphColor;
+  PositionWorld = vec3(WorldFromLocal * position);
+  return ClipFromLocal * position;
+}
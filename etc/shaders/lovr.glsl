@@ -1,3 +1,7 @@
+#ifdef LOVR_BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
+
 // Flags
 layout(constant_id = 1000) const float flag_pointSize = 1.f;
 layout(constant_id = 1001) const uint flag_attachmentCount = 1;
@@ -37,6 +41,38 @@ layout(set = 0, binding = 1) uniform CameraBuffer { Camera Cameras[6]; };
 layout(set = 0, binding = 2) uniform DrawBuffer { Draw Draws[256]; };
 layout(set = 0, binding = 3) uniform sampler Sampler;
 
+#ifdef LOVR_BINDLESS
+struct MaterialData {
+  vec4 color;
+  vec4 glow;
+  vec2 uvShift;
+  vec2 uvScale;
+  vec2 sdfRange;
+  float metalness;
+  float roughness;
+  float clearcoat;
+  float clearcoatRoughness;
+  float occlusionStrength;
+  float normalScale;
+  float alphaCutoff;
+};
+
+// All materials live in one bundle: each block of 256 materials is a storage buffer, and each
+// material owns 8 consecutive slots in the texture array.  The material index is stored in the
+// unused last element of the draw's normal matrix.
+layout(set = 1, binding = 0) readonly buffer MaterialBlock { MaterialData materials[]; } MaterialBlocks[];
+layout(set = 1, binding = 1) uniform texture2D Textures[];
+
+#define MaterialTextureIndex(i) nonuniformEXT(MaterialID * 8u + (i))
+#define Material MaterialBlocks[nonuniformEXT(MaterialID >> 8)].materials[MaterialID & 0xffu]
+#define ColorTexture Textures[MaterialTextureIndex(0u)]
+#define GlowTexture Textures[MaterialTextureIndex(1u)]
+#define MetalnessTexture Textures[MaterialTextureIndex(2u)]
+#define RoughnessTexture Textures[MaterialTextureIndex(3u)]
+#define ClearcoatTexture Textures[MaterialTextureIndex(4u)]
+#define OcclusionTexture Textures[MaterialTextureIndex(5u)]
+#define NormalTexture Textures[MaterialTextureIndex(6u)]
+#else
 layout(set = 1, binding = 0) uniform MaterialBuffer {
   vec4 color;
   vec4 glow;
@@ -60,6 +96,7 @@ layout(set = 1, binding = 5) uniform texture2D ClearcoatTexture;
 layout(set = 1, binding = 6) uniform texture2D OcclusionTexture;
 layout(set = 1, binding = 7) uniform texture2D NormalTexture;
 #endif
+#endif
 
 // Attributes
 #ifdef GL_VERTEX_SHADER
@@ -76,12 +113,16 @@ layout(location = 0) out vec4 PixelColor[flag_attachmentCount];
 #endif
 
 // Varyings
+// Locations 10-15 are reserved for these, custom varyings should use locations 0-9
 #ifdef GL_VERTEX_SHADER
 layout(location = 10) out vec3 PositionWorld;
 layout(location = 11) out vec3 Normal;
 layout(location = 12) out vec4 Color;
 layout(location = 13) out vec2 UV;
 layout(location = 14) out vec3 Tangent;
+#ifdef LOVR_BINDLESS
+layout(location = 15) flat out uint FragmentMaterialID;
+#endif
 #endif
 
 #ifdef GL_FRAGMENT_SHADER
@@ -90,6 +131,9 @@ layout(location = 11) in vec3 Normal;
 layout(location = 12) in vec4 Color;
 layout(location = 13) in vec2 UV;
 layout(location = 14) in vec3 Tangent;
+#ifdef LOVR_BINDLESS
+layout(location = 15) flat in uint FragmentMaterialID;
+#endif
 #endif
 
 // Macros
@@ -107,7 +151,7 @@ layout(location = 14) in vec3 Tangent;
 #define ClipDistance gl_ClipDistance
 #define CullDistance gl_CullDistance
 #define DrawIndex gl_DrawIndex
-#define InstanceIndex (gl_InstanceIndex - gl_BaseInstance)
+#define InstanceIndex (AutoInstanced ? 0 : gl_InstanceIndex - gl_BaseInstance)
 #define FragCoord gl_FragCoord
 #define FragDepth gl_FragDepth
 #define FrontFacing gl_FrontFacing
@@ -122,7 +166,17 @@ layout(location = 14) in vec3 Tangent;
 #define VertexIndex gl_VertexIndex
 #define ViewIndex gl_ViewIndex
 
-#define DrawID gl_BaseInstance
+// When consecutive shape draws are merged into one instanced draw, bit 8 of the base instance is
+// set and each instance uses its own draw data.  BaseInstance is left as the raw value, and draws
+// sourced from a Buffer must keep their base instance below 256.
+#define AutoInstanced ((gl_BaseInstance & 0x100) != 0)
+
+// Glyph quads use instances for the glyphs, so their draw index is passed as the base vertex
+#ifdef LOVR_GLYPH_QUADS
+#define DrawID gl_BaseVertex
+#else
+#define DrawID (AutoInstanced ? (gl_InstanceIndex & 0xff) : gl_BaseInstance)
+#endif
 #define Projection Cameras[ViewIndex].projection
 #define View Cameras[ViewIndex].view
 #define ViewProjection Cameras[ViewIndex].viewProjection
@@ -131,6 +185,14 @@ layout(location = 14) in vec3 Tangent;
 #define NormalMatrix mat3(Draws[DrawID].normalMatrix)
 #define PassColor Draws[DrawID].color
 
+#ifdef LOVR_BINDLESS
+#ifdef GL_VERTEX_SHADER
+#define MaterialID floatBitsToUint(Draws[DrawID].normalMatrix[3][3])
+#else
+#define MaterialID FragmentMaterialID
+#endif
+#endif
+
 #define ClipFromLocal (ViewProjection * Transform)
 #define ClipFromWorld (ViewProjection)
 #define ClipFromView (Projection)
@@ -364,6 +426,9 @@ vec3 tonemap(vec3 x) {
 #ifdef GL_VERTEX_SHADER
 vec4 lovrmain();
 void main() {
+#ifdef LOVR_BINDLESS
+  FragmentMaterialID = MaterialID;
+#endif
   PositionWorld = vec3(WorldFromLocal * VertexPosition);
   Normal = NormalMatrix * VertexNormal;
   UV = VertexUV;
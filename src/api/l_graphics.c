@@ -5,6 +5,7 @@
 #include "data/modelData.h"
 #include "data/rasterizer.h"
 #include "util.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -627,12 +628,59 @@ static void luax_writeshadercache(void) {
   free(data);
 }
 
+static void luax_writespirvcache(void) {
+  size_t size;
+  lovrGraphicsGetSpirvCache(NULL, &size);
+
+  if (size == 0) {
+    return;
+  }
+
+  void* data = malloc(size);
+
+  if (!data) {
+    return;
+  }
+
+  lovrGraphicsGetSpirvCache(data, &size);
+
+  if (size > 0) {
+    luax_writefile(".lovrspirvcache", data, size);
+  }
+
+  free(data);
+}
+
+static void luax_writefontcache(void) {
+  size_t size;
+  lovrGraphicsGetFontCache(NULL, &size);
+
+  if (size == 0) {
+    return;
+  }
+
+  void* data = malloc(size);
+
+  if (!data) {
+    return;
+  }
+
+  lovrGraphicsGetFontCache(data, &size);
+
+  if (size > 0) {
+    luax_writefile(".lovrfontcache", data, size);
+  }
+
+  free(data);
+}
+
 static int l_lovrGraphicsInitialize(lua_State* L) {
   GraphicsConfig config = {
     .debug = false,
     .vsync = false,
     .stencil = false,
-    .antialias = true
+    .antialias = true,
+    .fontCache = true
   };
 
   bool shaderCache = true;
@@ -659,23 +707,51 @@ static int l_lovrGraphicsInitialize(lua_State* L) {
     lua_getfield(L, -1, "shadercache");
     shaderCache = lua_toboolean(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, -1, "fontcache");
+    config.fontCache = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "asyncpipelines");
+    config.asyncPipelines = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "asynccompute");
+    config.asyncCompute = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+
+    lua_getfield(L, -1, "bindless");
+    config.bindless = lua_toboolean(L, -1);
+    lua_pop(L, 1);
   }
   lua_pop(L, 2);
 
   if (shaderCache) {
     config.cacheData = luax_readfile(".lovrshadercache", &config.cacheSize);
+    config.spirvCacheData = luax_readfile(".lovrspirvcache", &config.spirvCacheSize);
+  }
+
+  if (config.fontCache) {
+    config.fontCacheData = luax_readfile(".lovrfontcache", &config.fontCacheSize);
   }
 
   if (lovrGraphicsInit(&config)) {
     luax_atexit(L, lovrGraphicsDestroy);
 
-    // Finalizers run in the opposite order they were added, so this has to go last
+    // Finalizers run in the opposite order they were added, so these have to go last
     if (shaderCache) {
       luax_atexit(L, luax_writeshadercache);
+      luax_atexit(L, luax_writespirvcache);
+    }
+
+    if (config.fontCache) {
+      luax_atexit(L, luax_writefontcache);
     }
   }
 
   free(config.cacheData);
+  free(config.spirvCacheData);
+  free(config.fontCacheData);
 
   return 0;
 }
@@ -753,6 +829,7 @@ static int l_lovrGraphicsGetFeatures(lua_State* L) {
   lua_pushboolean(L, features.float64), lua_setfield(L, -2, "float64");
   lua_pushboolean(L, features.int64), lua_setfield(L, -2, "int64");
   lua_pushboolean(L, features.int16), lua_setfield(L, -2, "int16");
+  lua_pushboolean(L, features.bindless), lua_setfield(L, -2, "bindless");
   return 1;
 }
 
@@ -826,6 +903,106 @@ static int l_lovrGraphicsIsFormatSupported(lua_State* L) {
   return 1;
 }
 
+static int l_lovrGraphicsGetPendingPipelineCount(lua_State* L) {
+  lua_pushinteger(L, lovrGraphicsGetPendingPipelineCount());
+  return 1;
+}
+
+static int l_lovrGraphicsGetMemoryStats(lua_State* L) {
+  GraphicsMemoryStats stats;
+  lovrGraphicsGetMemoryStats(&stats);
+
+  static const char* types[] = {
+    [MEMORY_BUFFER] = "buffer",
+    [MEMORY_STREAM] = "stream",
+    [MEMORY_STAGING] = "staging",
+    [MEMORY_READBACK] = "readback",
+    [MEMORY_TEXTURE] = "texture"
+  };
+
+  lua_newtable(L);
+
+  for (uint32_t i = 0; i < MEMORY_USAGE_COUNT; i++) {
+    float free = (float) stats.types[i].free;
+    float fragmentation = free > 0.f ? 1.f - stats.types[i].largestFree / free : 0.f;
+    lua_newtable(L);
+    lua_pushnumber(L, stats.types[i].allocated), lua_setfield(L, -2, "allocated");
+    lua_pushnumber(L, stats.types[i].used), lua_setfield(L, -2, "used");
+    lua_pushinteger(L, stats.types[i].blocks), lua_setfield(L, -2, "blocks");
+    lua_pushinteger(L, stats.types[i].allocations), lua_setfield(L, -2, "allocations");
+    lua_pushnumber(L, fragmentation), lua_setfield(L, -2, "fragmentation");
+    lua_setfield(L, -2, types[i]);
+  }
+
+  lua_createtable(L, stats.heapCount, 0);
+  for (uint32_t i = 0; i < stats.heapCount; i++) {
+    lua_newtable(L);
+    lua_pushnumber(L, stats.heaps[i].size), lua_setfield(L, -2, "size");
+    lua_pushnumber(L, stats.heaps[i].budget), lua_setfield(L, -2, "budget");
+    lua_pushnumber(L, stats.heaps[i].usage), lua_setfield(L, -2, "usage");
+    lua_pushboolean(L, stats.heaps[i].deviceLocal), lua_setfield(L, -2, "deviceLocal");
+    lua_rawseti(L, -2, i + 1);
+  }
+  lua_setfield(L, -2, "heaps");
+
+  lua_newtable(L);
+  lua_pushnumber(L, stats.scratchpad[0]), lua_setfield(L, -2, "stream");
+  lua_pushnumber(L, stats.scratchpad[1]), lua_setfield(L, -2, "staging");
+  lua_pushnumber(L, stats.scratchpad[2]), lua_setfield(L, -2, "readback");
+  lua_setfield(L, -2, "scratchpad");
+
+  lua_pushboolean(L, stats.budget), lua_setfield(L, -2, "budget");
+  lua_pushinteger(L, stats.condemned), lua_setfield(L, -2, "condemned");
+  return 1;
+}
+
+static int l_lovrGraphicsIsTimingEnabled(lua_State* L) {
+  lua_pushboolean(L, lovrGraphicsIsTimingEnabled());
+  return 1;
+}
+
+static int l_lovrGraphicsSetTimingEnabled(lua_State* L) {
+  lovrGraphicsSetTimingEnabled(lua_toboolean(L, 1));
+  return 0;
+}
+
+static int l_lovrGraphicsGetTimings(lua_State* L) {
+  uint32_t count;
+  TimingZone* zones = lovrGraphicsGetTimings(&count);
+  lua_createtable(L, count, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    lua_createtable(L, 0, 4);
+    lua_pushstring(L, zones[i].name), lua_setfield(L, -2, "name");
+    lua_pushinteger(L, zones[i].thread), lua_setfield(L, -2, "thread");
+    lua_pushnumber(L, zones[i].start), lua_setfield(L, -2, "start");
+    lua_pushnumber(L, zones[i].duration), lua_setfield(L, -2, "duration");
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+// Chrome trace format (chrome://tracing, Perfetto), times are in microseconds
+static int l_lovrGraphicsGetTrace(lua_State* L) {
+  uint32_t count;
+  TimingZone* zones = lovrGraphicsGetTimings(&count);
+  luaL_Buffer buffer;
+  luaL_buffinit(L, &buffer);
+  luaL_addstring(&buffer, "{\"traceEvents\":[{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+  for (uint32_t i = 0; i < count; i++) {
+    char event[160];
+    luaL_addstring(&buffer, ",{\"name\":\"");
+    for (const char* c = zones[i].name; *c; c++) {
+      if (*c == '"' || *c == '\\') luaL_addchar(&buffer, '\\');
+      if ((unsigned char) *c >= ' ') luaL_addchar(&buffer, *c);
+    }
+    snprintf(event, sizeof(event), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", zones[i].thread, zones[i].start * 1e6, zones[i].duration * 1e6);
+    luaL_addstring(&buffer, event);
+  }
+  luaL_addstring(&buffer, "]}");
+  luaL_pushresult(&buffer);
+  return 1;
+}
+
 static int l_lovrGraphicsGetBackgroundColor(lua_State* L) {
   float color[4];
   lovrGraphicsGetBackgroundColor(color);
@@ -1028,6 +1205,10 @@ static int l_lovrGraphicsNewTexture(lua_State* L) {
     lua_getfield(L, index, "label");
     info.label = lua_tostring(L, -1);
     lua_pop(L, 1);
+
+    lua_getfield(L, index, "stream");
+    info.stream = lua_toboolean(L, -1);
+    lua_pop(L, 1);
   }
 
   Texture* texture = lovrTextureCreate(&info);
@@ -1113,7 +1294,7 @@ static int l_lovrGraphicsNewSampler(lua_State* L) {
   return 1;
 }
 
-static ShaderSource luax_checkshadersource(lua_State* L, int index, ShaderStage stage, bool* allocated) {
+static ShaderSource luax_checkshadersource(lua_State* L, int index, ShaderStage stage, bool* allocated, bool compile) {
   ShaderSource source;
   if (lua_isstring(L, index)) {
     size_t length;
@@ -1160,6 +1341,10 @@ static ShaderSource luax_checkshadersource(lua_State* L, int index, ShaderStage
     return lovrGraphicsGetDefaultShaderSource(SHADER_UNLIT, stage);
   }
 
+  if (!compile) {
+    return source;
+  }
+
   ShaderSource bytecode = lovrGraphicsCompileShader(stage, &source);
 
   if (bytecode.code != source.code) {
@@ -1174,46 +1359,46 @@ static ShaderSource luax_checkshadersource(lua_State* L, int index, ShaderStage
 static int l_lovrGraphicsCompileShader(lua_State* L) {
   ShaderStage stage = luax_checkenum(L, 1, ShaderStage, NULL);
   bool allocated;
-  ShaderSource spirv = luax_checkshadersource(L, 2, stage, &allocated);
+  ShaderSource spirv = luax_checkshadersource(L, 2, stage, &allocated, true);
   Blob* blob = lovrBlobCreate((void*) spirv.code, spirv.size, "Compiled Shader Code");
   luax_pushtype(L, Blob, blob);
   lovrRelease(blob, lovrBlobDestroy);
   return 1;
 }
 
-static int l_lovrGraphicsNewShader(lua_State* L) {
-  ShaderInfo info = { 0 };
-  bool allocated[2];
-  int index;
+// Reads the shader sources and options starting at index.  The flags array in the ShaderInfo is
+// owned by the caller, along with any sources marked as allocated.
+static void luax_checkshaderinfo(lua_State* L, int index, int count, ShaderInfo* info, bool allocated[2], bool compile) {
+  memset(info, 0, sizeof(*info));
+  allocated[0] = false;
+  allocated[1] = false;
 
   // If there's only one source given, it could be a DefaultShader or a compute shader
-  if (lua_gettop(L) == 1 || (lua_istable(L, 2) && luax_len(L, 2) == 0)) {
-    if (lua_type(L, 1) == LUA_TSTRING) {
+  if (count == 1 || (lua_istable(L, index + 1) && luax_len(L, index + 1) == 0)) {
+    if (lua_type(L, index) == LUA_TSTRING) {
       size_t length;
-      const char* string = lua_tolstring(L, 1, &length);
+      const char* string = lua_tolstring(L, index, &length);
       for (int i = 0; i < DEFAULT_SHADER_COUNT; i++) {
         if (lovrDefaultShader[i].length == length && !memcmp(lovrDefaultShader[i].string, string, length)) {
-          info.source[0] = lovrGraphicsGetDefaultShaderSource(i, STAGE_VERTEX);
-          info.source[1] = lovrGraphicsGetDefaultShaderSource(i, STAGE_FRAGMENT);
-          info.type = SHADER_GRAPHICS;
-          allocated[0] = false;
-          allocated[1] = false;
+          info->source[0] = lovrGraphicsGetDefaultShaderSource(i, STAGE_VERTEX);
+          info->source[1] = lovrGraphicsGetDefaultShaderSource(i, STAGE_FRAGMENT);
+          info->type = SHADER_GRAPHICS;
           break;
         }
       }
     }
 
-    if (!info.source[0].code) {
-      info.type = SHADER_COMPUTE;
-      info.source[0] = luax_checkshadersource(L, 1, STAGE_COMPUTE, &allocated[0]);
+    if (!info->source[0].code) {
+      info->type = SHADER_COMPUTE;
+      info->source[0] = luax_checkshadersource(L, index, STAGE_COMPUTE, &allocated[0], compile);
     }
 
-    index = 2;
+    index += 1;
   } else {
-    info.type = SHADER_GRAPHICS;
-    info.source[0] = luax_checkshadersource(L, 1, STAGE_VERTEX, &allocated[0]);
-    info.source[1] = luax_checkshadersource(L, 2, STAGE_FRAGMENT, &allocated[1]);
-    index = 3;
+    info->type = SHADER_GRAPHICS;
+    info->source[0] = luax_checkshadersource(L, index, STAGE_VERTEX, &allocated[0], compile);
+    info->source[1] = luax_checkshadersource(L, index + 1, STAGE_FRAGMENT, &allocated[1], compile);
+    index += 2;
   }
 
   arr_t(ShaderFlag) flags;
@@ -1233,27 +1418,116 @@ static int l_lovrGraphicsNewShader(lua_State* L) {
           default: lovrThrow("Unexpected ShaderFlag key type (%s)", lua_typename(L, lua_type(L, -2)));
         }
         arr_push(&flags, flag);
+        info->flags = flags.data;
+        info->flagCount = (uint32_t) flags.length;
         lua_pop(L, 1);
       }
     }
     lua_pop(L, 1);
 
     lua_getfield(L, index, "label");
-    info.label = lua_tostring(L, -1);
+    info->label = lua_tostring(L, -1);
     lua_pop(L, 1);
   }
 
   lovrCheck(flags.length < 1000, "Too many Shader flags");
+}
 
-  info.flags = flags.data;
-  info.flagCount = (uint32_t) flags.length;
-
+static int l_lovrGraphicsNewShader(lua_State* L) {
+  ShaderInfo info;
+  bool allocated[2];
+  luax_checkshaderinfo(L, 1, lua_gettop(L), &info, allocated, true);
   Shader* shader = lovrShaderCreate(&info);
   luax_pushtype(L, Shader, shader);
   lovrRelease(shader, lovrShaderDestroy);
   if (allocated[0]) free((void*) info.source[0].code);
   if (allocated[1]) free((void*) info.source[1].code);
-  arr_free(&flags);
+  free(info.flags);
+  return 1;
+}
+
+typedef struct {
+  ShaderInfo* infos;
+  bool* allocated;
+  Shader** shaders;
+  uint32_t count;
+  uint32_t loaded;
+} ShaderList;
+
+// Runs in protected mode, so l_lovrGraphicsNewShaders can clean up after errors.  GLSL is left
+// uncompiled here so the compilation happens on the worker threads too.  The source strings stay
+// alive because they're referenced by the table.
+static int luax_loadshaders(lua_State* L) {
+  ShaderList* list = lua_touserdata(L, 1);
+
+  for (uint32_t i = 0; i < list->count; i++) {
+    lua_rawgeti(L, 2, i + 1);
+    lovrCheck(lua_istable(L, -1), "Expected a table for Shader #%d", i + 1);
+    int base = lua_gettop(L) + 1;
+    int length = luax_len(L, -1);
+    lua_rawgeti(L, base - 1, 1);
+    lua_rawgeti(L, base - 1, 2);
+    lua_rawgeti(L, base - 1, 3);
+    // Counted first, so whatever was allocated before an error gets freed
+    list->loaded++;
+    luax_checkshaderinfo(L, base, length, &list->infos[i], &list->allocated[2 * i], false);
+    lua_pop(L, 4);
+  }
+
+  lovrGraphicsCompileShaders(list->infos, list->shaders, list->count);
+  return 0;
+}
+
+static int l_lovrGraphicsNewShaders(lua_State* L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  uint32_t count = luax_len(L, 1);
+
+  if (count == 0) {
+    lua_newtable(L);
+    return 1;
+  }
+
+  ShaderList list = { .count = count };
+  list.infos = malloc(count * sizeof(ShaderInfo));
+  list.allocated = malloc(count * 2 * sizeof(bool));
+  list.shaders = malloc(count * sizeof(Shader*));
+
+  if (!list.infos || !list.allocated || !list.shaders) {
+    free(list.infos);
+    free(list.allocated);
+    free(list.shaders);
+    lovrThrow("Out of memory");
+  }
+
+  lua_pushcfunction(L, luax_loadshaders);
+  lua_pushlightuserdata(L, &list);
+  lua_pushvalue(L, 1);
+  int status = lua_pcall(L, 2, 0, 0);
+
+  if (status == 0) {
+    lua_createtable(L, count, 0);
+    for (uint32_t i = 0; i < count; i++) {
+      luax_pushtype(L, Shader, list.shaders[i]);
+      lovrRelease(list.shaders[i], lovrShaderDestroy);
+      lua_rawseti(L, -2, i + 1);
+    }
+  }
+
+  for (uint32_t i = 0; i < list.loaded; i++) {
+    if (list.allocated[2 * i + 0]) free((void*) list.infos[i].source[0].code);
+    if (list.allocated[2 * i + 1]) free((void*) list.infos[i].source[1].code);
+    free(list.infos[i].flags);
+  }
+
+  free(list.shaders);
+  free(list.allocated);
+  free(list.infos);
+
+  // Rethrow the error now that everything is cleaned up
+  if (status != 0) {
+    return lua_error(L);
+  }
+
   return 1;
 }
 
@@ -1475,6 +1749,13 @@ static int l_lovrGraphicsNewTally(lua_State* L) {
   return 1;
 }
 
+static int l_lovrGraphicsNewBatch(lua_State* L) {
+  Batch* batch = lovrBatchCreate();
+  luax_pushtype(L, Batch, batch);
+  lovrRelease(batch, lovrBatchDestroy);
+  return 1;
+}
+
 static int l_lovrGraphicsGetPass(lua_State* L) {
   PassInfo info = { 0 };
 
@@ -1488,6 +1769,12 @@ static int l_lovrGraphicsGetPass(lua_State* L) {
     lua_getfield(L, 2, "label");
     info.label = lua_tostring(L, -1);
     lua_pop(L, 1);
+
+    if (info.type == PASS_COMPUTE) {
+      lua_getfield(L, 2, "async");
+      info.async = lua_toboolean(L, -1);
+      lua_pop(L, 1);
+    }
   } else {
     info.label = NULL;
   }
@@ -1508,6 +1795,12 @@ static const luaL_Reg lovrGraphics[] = {
   { "getFeatures", l_lovrGraphicsGetFeatures },
   { "getLimits", l_lovrGraphicsGetLimits },
   { "isFormatSupported", l_lovrGraphicsIsFormatSupported },
+  { "getPendingPipelineCount", l_lovrGraphicsGetPendingPipelineCount },
+  { "getMemoryStats", l_lovrGraphicsGetMemoryStats },
+  { "isTimingEnabled", l_lovrGraphicsIsTimingEnabled },
+  { "setTimingEnabled", l_lovrGraphicsSetTimingEnabled },
+  { "getTimings", l_lovrGraphicsGetTimings },
+  { "getTrace", l_lovrGraphicsGetTrace },
   { "getBackgroundColor", l_lovrGraphicsGetBackgroundColor },
   { "setBackgroundColor", l_lovrGraphicsSetBackgroundColor },
   { "getWindowPass", l_lovrGraphicsGetWindowPass },
@@ -1518,10 +1811,12 @@ static const luaL_Reg lovrGraphics[] = {
   { "newSampler", l_lovrGraphicsNewSampler },
   { "compileShader", l_lovrGraphicsCompileShader },
   { "newShader", l_lovrGraphicsNewShader },
+  { "newShaders", l_lovrGraphicsNewShaders },
   { "newMaterial", l_lovrGraphicsNewMaterial },
   { "newFont", l_lovrGraphicsNewFont },
   { "newModel", l_lovrGraphicsNewModel },
   { "newTally", l_lovrGraphicsNewTally },
+  { "newBatch", l_lovrGraphicsNewBatch },
   { "getPass", l_lovrGraphicsGetPass },
   { NULL, NULL }
 };
@@ -1535,6 +1830,7 @@ extern const luaL_Reg lovrFont[];
 extern const luaL_Reg lovrModel[];
 extern const luaL_Reg lovrReadback[];
 extern const luaL_Reg lovrTally[];
+extern const luaL_Reg lovrBatch[];
 extern const luaL_Reg lovrPass[];
 
 int luaopen_lovr_graphics(lua_State* L) {
@@ -1549,6 +1845,7 @@ int luaopen_lovr_graphics(lua_State* L) {
   luax_registertype(L, Model);
   luax_registertype(L, Readback);
   luax_registertype(L, Tally);
+  luax_registertype(L, Batch);
   luax_registertype(L, Pass);
   return 1;
 }
@@ -0,0 +1,22 @@
+#include "api.h"
+#include "graphics/graphics.h"
+#include "util.h"
+
+static int l_lovrBatchGetCount(lua_State* L) {
+  Batch* batch = luax_checktype(L, 1, Batch);
+  uint32_t count = lovrBatchGetCount(batch);
+  lua_pushinteger(L, count);
+  return 1;
+}
+
+static int l_lovrBatchClear(lua_State* L) {
+  Batch* batch = luax_checktype(L, 1, Batch);
+  lovrBatchClear(batch);
+  return 0;
+}
+
+const luaL_Reg lovrBatch[] = {
+  { "getCount", l_lovrBatchGetCount },
+  { "clear", l_lovrBatchClear },
+  { NULL, NULL }
+};
@@ -164,6 +164,58 @@ static int l_lovrFontGetVertices(lua_State* L) {
   return 2;
 }
 
+// Each argument is a string, a codepoint, or a { first, last } table with a range of codepoints.
+// The codepoints go in a userdata so they're garbage collected if prewarming throws an error.
+static int l_lovrFontPrewarm(lua_State* L) {
+  Font* font = luax_checktype(L, 1, Font);
+  int top = lua_gettop(L);
+  size_t count = 0;
+  for (int i = 2; i <= top; i++) {
+    if (lua_type(L, i) == LUA_TSTRING) {
+      count += luax_len(L, i);
+    } else if (lua_istable(L, i)) {
+      lua_rawgeti(L, i, 1);
+      lua_rawgeti(L, i, 2);
+      uint32_t first = luaL_checkinteger(L, -2);
+      uint32_t last = luaL_checkinteger(L, -1);
+      lua_pop(L, 2);
+      lovrCheck(first <= last && last - first < (1 << 20), "Invalid codepoint range");
+      count += last - first + 1;
+    } else {
+      luax_checkcodepoint(L, i);
+      count++;
+    }
+  }
+  uint32_t* codepoints = lua_newuserdata(L, count * sizeof(uint32_t));
+  uint32_t n = 0;
+  for (int i = 2; i <= top; i++) {
+    if (lua_type(L, i) == LUA_TSTRING) {
+      size_t length;
+      const char* str = lua_tolstring(L, i, &length);
+      const char* end = str + length;
+      size_t bytes;
+      uint32_t codepoint;
+      while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
+        codepoints[n++] = codepoint;
+        str += bytes;
+      }
+    } else if (lua_istable(L, i)) {
+      lua_rawgeti(L, i, 1);
+      lua_rawgeti(L, i, 2);
+      uint32_t first = lua_tointeger(L, -2);
+      uint32_t last = lua_tointeger(L, -1);
+      lua_pop(L, 2);
+      for (uint32_t c = first; c <= last; c++) {
+        codepoints[n++] = c;
+      }
+    } else {
+      codepoints[n++] = luax_checkcodepoint(L, i);
+    }
+  }
+  lovrFontPrewarm(font, codepoints, n);
+  return 0;
+}
+
 const luaL_Reg lovrFont[] = {
   { "getRasterizer", l_lovrFontGetRasterizer },
   { "getPixelDensity", l_lovrFontGetPixelDensity },
@@ -177,5 +229,6 @@ const luaL_Reg lovrFont[] = {
   { "getWidth", l_lovrFontGetWidth },
   { "getLines", l_lovrFontGetLines },
   { "getVertices", l_lovrFontGetVertices },
+  { "prewarm", l_lovrFontPrewarm },
   { NULL, NULL }
 };
@@ -109,6 +109,28 @@ static int l_lovrPassGetClear(lua_State* L) {
   return 1;
 }
 
+static int l_lovrPassGetBindsSaved(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  lua_pushinteger(L, lovrPassGetBindsSaved(pass));
+  return 1;
+}
+
+static int l_lovrPassGetStats(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  const PassStats* stats = lovrPassGetStats(pass);
+  lua_newtable(L);
+  lua_pushinteger(L, stats->draws), lua_setfield(L, -2, "draws");
+  lua_pushinteger(L, stats->instances), lua_setfield(L, -2, "instances");
+  lua_pushinteger(L, stats->pipelineHits), lua_setfield(L, -2, "pipelineHits");
+  lua_pushinteger(L, stats->pipelineMisses), lua_setfield(L, -2, "pipelineMisses");
+  lua_pushinteger(L, stats->pipelinesCreated), lua_setfield(L, -2, "pipelinesCreated");
+  lua_pushinteger(L, stats->bundleWrites), lua_setfield(L, -2, "bundleWrites");
+  lua_pushnumber(L, stats->vertexBytes), lua_setfield(L, -2, "vertexBytes");
+  lua_pushnumber(L, stats->indexBytes), lua_setfield(L, -2, "indexBytes");
+  lua_pushinteger(L, stats->barriers), lua_setfield(L, -2, "barriers");
+  return 1;
+}
+
 static int l_lovrPassGetViewPose(lua_State* L) {
   Pass* pass = luax_checktype(L, 1, Pass);
   uint32_t view = luaL_checkinteger(L, 2) - 1;
@@ -386,6 +408,18 @@ static int l_lovrPassSetShader(lua_State* L) {
   }
 }
 
+static int l_lovrPassSetPrewarm(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  lovrPassSetPrewarm(pass, lua_toboolean(L, 2));
+  return 0;
+}
+
+static int l_lovrPassSetSorting(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  lovrPassSetSorting(pass, lua_toboolean(L, 2));
+  return 0;
+}
+
 static int l_lovrPassSetStencilTest(lua_State* L) {
   Pass* pass = luax_checktype(L, 1, Pass);
   CompareMode test = luax_checkcomparemode(L, 2);
@@ -420,6 +454,12 @@ static int l_lovrPassSetStencilWrite(lua_State* L) {
   return 0;
 }
 
+static int l_lovrPassSetViewCull(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  lovrPassSetViewCull(pass, lua_toboolean(L, 2));
+  return 0;
+}
+
 static int l_lovrPassSetViewport(lua_State* L) {
   Pass* pass = luax_checktype(L, 1, Pass);
   float viewport[4];
@@ -761,7 +801,15 @@ static int l_lovrPassDraw(lua_State* L) {
     return 0;
   }
 
-  return luax_typeerror(L, 2, "Model");
+  Batch* batch = luax_totype(L, 2, Batch);
+
+  if (batch) {
+    luax_readmat4(L, 3, transform, 1);
+    lovrPassDrawBatch(pass, batch, transform);
+    return 0;
+  }
+
+  return luax_typeerror(L, 2, "Model or Batch");
 }
 
 static int l_lovrPassMesh(lua_State* L) {
@@ -789,6 +837,19 @@ static int l_lovrPassMesh(lua_State* L) {
   return 0;
 }
 
+static int l_lovrPassBeginBatch(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  Batch* batch = luax_checktype(L, 2, Batch);
+  lovrPassBeginBatch(pass, batch);
+  return 0;
+}
+
+static int l_lovrPassEndBatch(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  lovrPassEndBatch(pass);
+  return 0;
+}
+
 static int l_lovrPassCompute(lua_State* L) {
   Pass* pass = luax_checktype(L, 1, Pass);
   Buffer* buffer = luax_totype(L, 2, Buffer);
@@ -804,6 +865,25 @@ static int l_lovrPassCompute(lua_State* L) {
   return 0;
 }
 
+static int l_lovrPassCull(lua_State* L) {
+  Pass* pass = luax_checktype(L, 1, Pass);
+  Buffer* bounds = luax_checktype(L, 2, Buffer);
+  Buffer* visible = luax_checktype(L, 3, Buffer);
+  Buffer* draws = luax_checktype(L, 4, Buffer);
+  uint32_t offset = luax_checku32(L, 5);
+  lovrCheck(!lua_isnoneornil(L, 6), "Expected at least one view-projection matrix to cull against");
+  float viewProjections[6][16];
+  uint32_t viewCount = 0;
+  int index = 6;
+  do {
+    lovrCheck(viewCount < COUNTOF(viewProjections), "Too many views (max is %d)", (int) COUNTOF(viewProjections));
+    index = luax_readmat4(L, index, viewProjections[viewCount++], 1);
+  } while (index <= lua_gettop(L));
+  uint32_t count = lovrBufferGetInfo(bounds)->length;
+  lovrPassCull(pass, bounds, visible, count, draws, offset, viewProjections[0], viewCount);
+  return 0;
+}
+
 static int l_lovrPassClear(lua_State* L) {
   Pass* pass = luax_checktype(L, 1, Pass);
 
@@ -1049,6 +1129,8 @@ const luaL_Reg lovrPass[] = {
   { "getSampleCount", l_lovrPassGetSampleCount },
   { "getTarget", l_lovrPassGetTarget },
   { "getClear", l_lovrPassGetClear },
+  { "getBindsSaved", l_lovrPassGetBindsSaved },
+  { "getStats", l_lovrPassGetStats },
 
   { "getViewPose", l_lovrPassGetViewPose },
   { "setViewPose", l_lovrPassSetViewPose },
@@ -1079,8 +1161,11 @@ const luaL_Reg lovrPass[] = {
   { "setSampler", l_lovrPassSetSampler },
   { "setScissor", l_lovrPassSetScissor },
   { "setShader", l_lovrPassSetShader },
+  { "setPrewarm", l_lovrPassSetPrewarm },
+  { "setSorting", l_lovrPassSetSorting },
   { "setStencilTest", l_lovrPassSetStencilTest },
   { "setStencilWrite", l_lovrPassSetStencilWrite },
+  { "setViewCull", l_lovrPassSetViewCull },
   { "setViewport", l_lovrPassSetViewport },
   { "setWinding", l_lovrPassSetWinding },
   { "setWireframe", l_lovrPassSetWireframe },
@@ -1104,8 +1189,11 @@ const luaL_Reg lovrPass[] = {
   { "monkey", l_lovrPassMonkey },
   { "draw", l_lovrPassDraw },
   { "mesh", l_lovrPassMesh },
+  { "beginBatch", l_lovrPassBeginBatch },
+  { "endBatch", l_lovrPassEndBatch },
 
   { "compute", l_lovrPassCompute },
+  { "cull", l_lovrPassCull },
 
   { "clear", l_lovrPassClear },
   { "copy", l_lovrPassCopy },
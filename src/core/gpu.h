@@ -44,6 +44,7 @@ typedef enum {
 } gpu_map_mode;
 
 void* gpu_map(gpu_buffer* buffer, uint32_t size, uint32_t align, gpu_map_mode mode);
+bool gpu_rebase(gpu_buffer* buffer, gpu_buffer* base, uint32_t* offset);
 
 // Texture
 
@@ -133,8 +134,10 @@ typedef struct {
   const char* label;
   struct {
     gpu_stream* stream;
+    gpu_stream* transfer;
     gpu_buffer* buffer;
     uint32_t* levelOffsets;
+    uint32_t levelIndex;
     uint32_t levelCount;
     bool generateMipmaps;
   } upload;
@@ -208,6 +211,7 @@ typedef struct {
   uint32_t number;
   gpu_slot_type type;
   uint32_t stages;
+  uint32_t count; // Array size, 0 means 1, >1 requires bindless feature
 } gpu_slot;
 
 typedef struct {
@@ -246,6 +250,7 @@ typedef struct {
 typedef struct {
   uint32_t number;
   gpu_slot_type type;
+  uint32_t element;
   union {
     gpu_buffer_binding buffer;
     gpu_texture* texture;
@@ -472,6 +477,7 @@ typedef struct {
 
 bool gpu_tally_init(gpu_tally* tally, gpu_tally_info* info);
 void gpu_tally_destroy(gpu_tally* tally);
+bool gpu_tally_get_data(gpu_tally* tally, uint32_t index, uint32_t count, uint32_t* data);
 
 // Stream
 
@@ -552,6 +558,9 @@ typedef struct {
 } gpu_barrier;
 
 gpu_stream* gpu_stream_begin(const char* label);
+gpu_stream* gpu_stream_begin_transfer(const char* label);
+gpu_stream* gpu_stream_begin_readback(const char* label);
+gpu_stream* gpu_stream_begin_compute(const char* label);
 void gpu_stream_end(gpu_stream* stream);
 void gpu_render_begin(gpu_stream* stream, gpu_canvas* canvas);
 void gpu_render_end(gpu_stream* stream);
@@ -571,6 +580,7 @@ void gpu_draw_indirect_indexed(gpu_stream* stream, gpu_buffer* buffer, uint32_t
 void gpu_compute(gpu_stream* stream, uint32_t x, uint32_t y, uint32_t z);
 void gpu_compute_indirect(gpu_stream* stream, gpu_buffer* buffer, uint32_t offset);
 void gpu_copy_buffers(gpu_stream* stream, gpu_buffer* src, gpu_buffer* dst, uint32_t srcOffset, uint32_t dstOffset, uint32_t size);
+void gpu_handoff_buffer(gpu_stream* transfer, gpu_stream* stream, gpu_buffer* buffer);
 void gpu_copy_textures(gpu_stream* stream, gpu_texture* src, gpu_texture* dst, uint32_t srcOffset[4], uint32_t dstOffset[4], uint32_t size[3]);
 void gpu_copy_buffer_texture(gpu_stream* stream, gpu_buffer* src, gpu_texture* dst, uint32_t srcOffset, uint32_t dstOffset[4], uint32_t extent[3]);
 void gpu_copy_texture_buffer(gpu_stream* stream, gpu_texture* src, gpu_buffer* dst, uint32_t srcOffset[4], uint32_t dstOffset, uint32_t extent[3]);
@@ -593,6 +603,8 @@ typedef struct {
   const char* renderer;
   uint32_t subgroupSize;
   bool discrete;
+  bool transferQueue;
+  bool transferImages;
 } gpu_device_info;
 
 enum {
@@ -617,6 +629,7 @@ typedef struct {
   bool float64;
   bool int64;
   bool int16;
+  bool bindless;
 } gpu_features;
 
 typedef struct {
@@ -655,6 +668,8 @@ typedef struct {
 
 typedef struct {
   bool debug;
+  bool asyncCompute;
+  bool bindless;
   void* userdata;
   void (*callback)(void* userdata, const char* message, bool error);
   const char* engineName;
@@ -675,11 +690,49 @@ typedef struct {
   } vk;
 } gpu_config;
 
+typedef enum {
+  GPU_MEMORY_USAGE_BUFFER,
+  GPU_MEMORY_USAGE_STREAM,
+  GPU_MEMORY_USAGE_STAGING,
+  GPU_MEMORY_USAGE_READBACK,
+  GPU_MEMORY_USAGE_TEXTURE,
+  GPU_MEMORY_USAGE_COUNT
+} gpu_memory_usage;
+
+typedef struct {
+  struct {
+    uint64_t allocated;
+    uint64_t used;
+    uint64_t free;
+    uint64_t largestFree;
+    uint32_t blocks;
+    uint32_t allocations;
+  } types[GPU_MEMORY_USAGE_COUNT];
+  struct {
+    uint64_t size;
+    uint64_t budget;
+    uint64_t usage;
+    bool deviceLocal;
+  } heaps[16];
+  uint32_t heapCount;
+  bool budget;
+  uint64_t scratchpad[3];
+  uint32_t condemned;
+} gpu_memory_stats;
+
+typedef struct {
+  gpu_stream** streams;
+  uint32_t count;
+  uint32_t wait;
+  bool compute;
+} gpu_batch;
+
 bool gpu_init(gpu_config* config);
 void gpu_destroy(void);
 uint32_t gpu_begin(void);
-void gpu_submit(gpu_stream** streams, uint32_t count);
+void gpu_submit(gpu_batch* batches, uint32_t count);
 void gpu_present(void);
 bool gpu_is_complete(uint32_t tick);
 bool gpu_wait_tick(uint32_t tick);
 void gpu_wait_idle(void);
+void gpu_get_memory_stats(gpu_memory_stats* stats);
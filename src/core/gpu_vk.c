@@ -1,5 +1,6 @@
 #include "gpu.h"
 #include <string.h>
+#include <stdatomic.h>
 #define VK_NO_PROTOTYPES
 #include <vulkan/vulkan.h>
 #ifdef _WIN32
@@ -7,6 +8,10 @@
 #include <windows.h>
 #else
 #include <dlfcn.h>
+#include <sched.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
 #endif
 
 // Objects
@@ -36,6 +41,7 @@ struct gpu_sampler {
 struct gpu_layout {
   VkDescriptorSetLayout handle;
   uint32_t descriptorCounts[7];
+  bool updateAfterBind;
 };
 
 struct gpu_shader {
@@ -60,6 +66,7 @@ struct gpu_tally {
 };
 
 struct gpu_stream {
+  VkCommandPool pool;
   VkCommandBuffer commands;
 };
 
@@ -78,7 +85,9 @@ size_t gpu_sizeof_tally() { return sizeof(gpu_tally); }
 typedef struct {
   VkDeviceMemory handle;
   void* pointer;
-  uint32_t refs;
+  uint32_t size;
+  uint8_t allocator;
+  bool dedicated;
 } gpu_memory;
 
 typedef enum {
@@ -99,9 +108,32 @@ typedef enum {
   GPU_MEMORY_COUNT
 } gpu_memory_type;
 
+// A span is a range of a memory block, either allocated or free.  Spans in a block form a linked
+// list sorted by offset, so neighbors can be coalesced when they're freed.  Free spans are also
+// linked into the TLSF free list of their allocator.  Index 0 is reserved as the null span.
 typedef struct {
-  gpu_memory* block;
-  uint32_t cursor;
+  uint32_t offset;
+  uint32_t size;
+  uint32_t prev;
+  uint32_t next;
+  uint32_t prevFree;
+  uint32_t nextFree;
+  uint32_t tick;
+  uint16_t block;
+  uint8_t allocator;
+  bool free;
+} gpu_span;
+
+#define TLSF_SL_LOG 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG)
+
+// Each allocator is a TLSF (two-level segregated fit) allocator over its memory blocks.  The first
+// level splits free spans by power of 2 and the second level splits each power of 2 linearly.
+typedef struct {
+  uint32_t flBitmap;
+  uint32_t slBitmap[32];
+  uint32_t heads[32][TLSF_SL_COUNT];
+  uint32_t blockCount;
   uint16_t memoryType;
   uint16_t memoryFlags;
 } gpu_allocator;
@@ -144,17 +176,29 @@ typedef struct {
 } gpu_cache_entry;
 
 typedef struct {
-  gpu_memory* memory;
+  uint32_t memory;
   VkBuffer buffer;
   uint32_t cursor;
   uint32_t size;
   char* pointer;
+  atomic_flag lock;
 } gpu_scratchpad;
 
+// Each stream has its own command pool, so streams can be recorded on different threads
+// The transfer stream records uploads for the dedicated transfer queue, if there is one
+// The readback stream also goes to the transfer queue, after everything else in the tick
+// Compute streams are submitted to the async compute queue, in batches that wait on each other
 typedef struct {
-  VkCommandPool pool;
   gpu_stream streams[64];
-  VkSemaphore semaphores[2];
+  uint32_t streamCount;
+  gpu_stream transfer;
+  bool transferActive;
+  gpu_stream readback;
+  bool readbackActive;
+  gpu_stream compute[16];
+  uint32_t computeCount;
+  VkSemaphore semaphores[5];
+  VkSemaphore batchSemaphores[33];
   VkFence fence;
 } gpu_tick;
 
@@ -168,12 +212,20 @@ static struct {
   VkDevice device;
   VkQueue queue;
   uint32_t queueFamilyIndex;
+  VkQueue transferQueue;
+  uint32_t transferFamilyIndex;
+  bool transferGranular;
+  VkQueue computeQueue;
+  uint32_t computeFamilyIndex;
+  uint32_t sharedFamilies[3];
+  uint32_t sharedFamilyCount;
   VkSurfaceKHR surface;
   VkSurfaceCapabilitiesKHR surfaceCapabilities;
   VkSurfaceFormatKHR surfaceFormat;
   bool swapchainValid;
   VkSwapchainKHR swapchain;
   VkSemaphore swapchainSemaphore;
+  VkSemaphore readbackSemaphore;
   uint32_t currentSwapchainTexture;
   gpu_texture swapchainTextures[8];
   VkPipelineCache pipelineCache;
@@ -184,14 +236,24 @@ static struct {
   uint8_t allocatorLookup[GPU_MEMORY_COUNT];
   gpu_scratchpad scratchpad[3];
   gpu_memory memory[256];
-  uint32_t streamCount;
+  gpu_span spans[16384];
+  uint32_t spanCount;
+  uint32_t spanFree;
+  uint32_t spansUsed;
+  uint32_t releasedHead;
+  uint32_t releasedTail;
   uint32_t tick[2];
   gpu_tick ticks[4];
   gpu_morgue morgue;
+  atomic_flag memoryLock;
+  atomic_flag morgueLock;
+  atomic_flag cacheLock;
   struct {
     bool validation;
     bool portability;
     bool debug;
+    bool memoryBudget;
+    bool descriptorIndexing;
   } supports;
 } state;
 
@@ -211,8 +273,11 @@ enum { LINEAR, SRGB };
 #define HASH_SEED 2166136261
 
 static uint32_t hash32(uint32_t initial, void* data, uint32_t size);
-static gpu_memory* gpu_allocate(gpu_memory_type type, VkMemoryRequirements info, VkDeviceSize* offset);
-static void gpu_release(gpu_memory* memory);
+static void lock(atomic_flag* flag);
+static void unlock(atomic_flag* flag);
+static uint32_t gpu_allocate(gpu_memory_type type, VkMemoryRequirements info, const char** error);
+static void gpu_release(uint32_t span);
+static void gpu_free_span(uint32_t index);
 static void condemn(void* handle, VkObjectType type);
 static void expunge(void);
 static bool hasLayer(VkLayerProperties* layers, uint32_t count, const char* layer);
@@ -247,6 +312,7 @@ static bool check(bool condition, const char* message);
   X(vkGetPhysicalDeviceProperties2)\
   X(vkGetPhysicalDeviceFeatures2)\
   X(vkGetPhysicalDeviceMemoryProperties)\
+  X(vkGetPhysicalDeviceMemoryProperties2)\
   X(vkGetPhysicalDeviceFormatProperties)\
   X(vkGetPhysicalDeviceQueueFamilyProperties)\
   X(vkGetPhysicalDeviceSurfaceSupportKHR)\
@@ -289,6 +355,7 @@ static bool check(bool condition, const char* message);
   X(vkCmdEndQuery)\
   X(vkCmdWriteTimestamp)\
   X(vkCmdCopyQueryPoolResults)\
+  X(vkGetQueryPoolResults)\
   X(vkCreateBuffer)\
   X(vkDestroyBuffer)\
   X(vkGetBufferMemoryRequirements)\
@@ -384,17 +451,33 @@ bool gpu_buffer_init(gpu_buffer* buffer, gpu_buffer_info* info) {
       VK_BUFFER_USAGE_TRANSFER_DST_BIT
   };
 
+  // Buffers are shared with the async compute and transfer queues so any of them can use them
+  if (state.sharedFamilyCount > 1) {
+    createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = state.sharedFamilyCount;
+    createInfo.pQueueFamilyIndices = state.sharedFamilies;
+  }
+
   VK(vkCreateBuffer(state.device, &createInfo, NULL, &buffer->handle), "Could not create buffer") return false;
   nickname(buffer->handle, VK_OBJECT_TYPE_BUFFER, info->label);
 
-  VkDeviceSize offset;
   VkMemoryRequirements requirements;
   vkGetBufferMemoryRequirements(state.device, buffer->handle, &requirements);
-  gpu_memory* memory = gpu_allocate(GPU_MEMORY_BUFFER_GPU, requirements, &offset);
+  const char* error;
+  uint32_t span = gpu_allocate(GPU_MEMORY_BUFFER_GPU, requirements, &error);
+
+  if (!span) {
+    vkDestroyBuffer(state.device, buffer->handle, NULL);
+    check(false, error);
+    return false;
+  }
+
+  uint32_t offset = state.spans[span].offset;
+  gpu_memory* memory = &state.memory[state.spans[span].block];
 
   VK(vkBindBufferMemory(state.device, buffer->handle, memory->handle, offset), "Could not bind buffer memory") {
     vkDestroyBuffer(state.device, buffer->handle, NULL);
-    gpu_release(memory);
+    gpu_release(span);
     return false;
   }
 
@@ -402,7 +485,7 @@ bool gpu_buffer_init(gpu_buffer* buffer, gpu_buffer_info* info) {
     *info->pointer = memory->pointer ? (char*) memory->pointer + offset : NULL;
   }
 
-  buffer->memory = memory - state.memory;
+  buffer->memory = span;
   buffer->offset = 0;
   return true;
 }
@@ -410,7 +493,7 @@ bool gpu_buffer_init(gpu_buffer* buffer, gpu_buffer_info* info) {
 void gpu_buffer_destroy(gpu_buffer* buffer) {
   if (buffer->memory == ~0u) return;
   condemn(buffer->handle, VK_OBJECT_TYPE_BUFFER);
-  gpu_release(&state.memory[buffer->memory]);
+  gpu_release(buffer->memory);
 }
 
 // There are 3 mapping modes, which use different strategies/memory types:
@@ -427,8 +510,12 @@ void gpu_buffer_destroy(gpu_buffer* buffer) {
 // - MAP_READBACK: Used for readbacks.  Uses cached memory when available since reading from
 //   uncached memory on the CPU is super duper slow.  Uses the same "zone" system as STREAM, since
 //   we want to be able to handle per-frame readbacks without thrashing.
+// Each scratchpad has a lock, since streams may be recorded (and mapping memory) on other threads.
 void* gpu_map(gpu_buffer* buffer, uint32_t size, uint32_t align, gpu_map_mode mode) {
   gpu_scratchpad* pool = &state.scratchpad[mode];
+  uint32_t oldMemory = 0;
+  VkBuffer oldBuffer = VK_NULL_HANDLE;
+  lock(&pool->lock);
   uint32_t cursor = ALIGN(pool->cursor, align);
   uint32_t zone = mode == GPU_MAP_STAGING ? 0 : (state.tick[CPU] & TICK_MASK);
 
@@ -456,6 +543,7 @@ void* gpu_map(gpu_buffer* buffer, uint32_t size, uint32_t align, gpu_map_mode mo
 
     if (mode == GPU_MAP_STAGING) {
       info.size = MAX(pool->size, size);
+
     } else {
       while (pool->size < size) {
         pool->size <<= 1;
@@ -463,36 +551,66 @@ void* gpu_map(gpu_buffer* buffer, uint32_t size, uint32_t align, gpu_map_mode mo
       info.size = pool->size * COUNTOF(state.ticks);
     }
 
+    // Staging and readback buffers are used by all queues, so they skip ownership transfers
+    if (mode != GPU_MAP_STREAM && state.sharedFamilyCount > 1) {
+      info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      info.queueFamilyIndexCount = state.sharedFamilyCount;
+      info.pQueueFamilyIndices = state.sharedFamilies;
+    }
+
+    // Errors are reported after unlocking, since the callback might not return
     VkBuffer handle;
-    VK(vkCreateBuffer(state.device, &info, NULL, &handle), "Could not create scratch buffer") return NULL;
+    VkResult result = vkCreateBuffer(state.device, &info, NULL, &handle);
+
+    if (result < 0) {
+      unlock(&pool->lock);
+      vcheck(result, "Could not create scratch buffer");
+      return NULL;
+    }
+
     nickname(handle, VK_OBJECT_TYPE_BUFFER, "Scratchpad");
 
-    VkDeviceSize offset;
     VkMemoryRequirements requirements;
     vkGetBufferMemoryRequirements(state.device, handle, &requirements);
-    gpu_memory* memory = gpu_allocate(GPU_MEMORY_BUFFER_MAP_STREAM + mode, requirements, &offset);
+    const char* error;
+    uint32_t span = gpu_allocate(GPU_MEMORY_BUFFER_MAP_STREAM + mode, requirements, &error);
+
+    if (!span) {
+      vkDestroyBuffer(state.device, handle, NULL);
+      unlock(&pool->lock);
+      check(false, error);
+      return NULL;
+    }
+
+    uint32_t offset = state.spans[span].offset;
+    gpu_memory* memory = &state.memory[state.spans[span].block];
 
-    VK(vkBindBufferMemory(state.device, handle, memory->handle, offset), "Could not bind scratchpad memory") {
+    result = vkBindBufferMemory(state.device, handle, memory->handle, offset);
+
+    if (result < 0) {
       vkDestroyBuffer(state.device, handle, NULL);
-      gpu_release(memory);
+      unlock(&pool->lock);
+      gpu_release(span);
+      vcheck(result, "Could not bind scratchpad memory");
       return NULL;
     }
 
     // If this was an oversized allocation, condemn it immediately, don't touch the pool
     if (size > pool->size) {
-      gpu_release(memory);
-      condemn(handle, VK_OBJECT_TYPE_BUFFER);
       buffer->handle = handle;
       buffer->memory = ~0u;
       buffer->offset = 0;
-      return memory->pointer;
+      unlock(&pool->lock);
+      gpu_release(span);
+      condemn(handle, VK_OBJECT_TYPE_BUFFER);
+      return (char*) memory->pointer + offset;
     } else {
-      gpu_release(pool->memory);
-      condemn(pool->buffer, VK_OBJECT_TYPE_BUFFER);
-      pool->memory = memory;
+      oldMemory = pool->memory;
+      oldBuffer = pool->buffer;
+      pool->memory = span;
       pool->buffer = handle;
       pool->cursor = cursor = 0;
-      pool->pointer = pool->memory->pointer;
+      pool->pointer = (char*) memory->pointer + offset;
     }
   }
 
@@ -500,8 +618,26 @@ void* gpu_map(gpu_buffer* buffer, uint32_t size, uint32_t align, gpu_map_mode mo
   buffer->handle = pool->buffer;
   buffer->memory = ~0u;
   buffer->offset = pool->size * zone + cursor;
+  char* pointer = pool->pointer + pool->size * zone + cursor;
+  unlock(&pool->lock);
 
-  return pool->pointer + pool->size * zone + cursor;
+  // The old buffer is condemned outside of the lock, since condemning can report an error
+  gpu_release(oldMemory);
+  condemn(oldBuffer, VK_OBJECT_TYPE_BUFFER);
+
+  return pointer;
+}
+
+// Mapped buffers that come from the same scratchpad buffer can share a bundle: the bundle is
+// written with the base buffer, and the others are reached using dynamic offsets relative to it.
+// Returns false if the scratchpad was replaced in between, in which case a new bundle is needed.
+bool gpu_rebase(gpu_buffer* buffer, gpu_buffer* base, uint32_t* offset) {
+  if (buffer->handle != base->handle || buffer->offset < base->offset) {
+    return false;
+  }
+
+  *offset = buffer->offset - base->offset;
+  return true;
 }
 
 // Texture
@@ -586,31 +722,55 @@ bool gpu_texture_init(gpu_texture* texture, gpu_texture_info* info) {
       (info->upload.generateMipmaps ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0)
   };
 
+  // Textures that shaders can access are shared with the async compute queue, and textures that can
+  // be read back are shared with the transfer queue
+  bool shared =
+    (state.computeQueue && (info->usage & (GPU_TEXTURE_SAMPLE | GPU_TEXTURE_STORAGE))) ||
+    (state.transferQueue && state.transferGranular && (info->usage & GPU_TEXTURE_COPY_SRC));
+
+  if (shared) {
+    imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    imageInfo.queueFamilyIndexCount = state.sharedFamilyCount;
+    imageInfo.pQueueFamilyIndices = state.sharedFamilies;
+  }
+
   VK(vkCreateImage(state.device, &imageInfo, NULL, &texture->handle), "Could not create texture") return false;
   nickname(texture->handle, VK_OBJECT_TYPE_IMAGE, info->label);
 
-  VkDeviceSize offset;
   VkMemoryRequirements requirements;
   vkGetImageMemoryRequirements(state.device, texture->handle, &requirements);
-  gpu_memory* memory = gpu_allocate(memoryType, requirements, &offset);
+  const char* error;
+  uint32_t span = gpu_allocate(memoryType, requirements, &error);
+
+  if (!span) {
+    vkDestroyImage(state.device, texture->handle, NULL);
+    check(false, error);
+    return false;
+  }
+
+  uint32_t offset = state.spans[span].offset;
+  gpu_memory* memory = &state.memory[state.spans[span].block];
 
   VK(vkBindImageMemory(state.device, texture->handle, memory->handle, offset), "Could not bind texture memory") {
     vkDestroyImage(state.device, texture->handle, NULL);
-    gpu_release(memory);
+    gpu_release(span);
     return false;
   }
 
   if (!gpu_texture_init_view(texture, &viewInfo)) {
     vkDestroyImage(state.device, texture->handle, NULL);
-    gpu_release(memory);
+    gpu_release(span);
     return false;
   }
 
   if (info->upload.stream) {
     VkImage image = texture->handle;
     VkCommandBuffer commands = info->upload.stream->commands;
+    uint32_t levelIndex = info->upload.levelIndex;
     uint32_t levelCount = info->upload.levelCount;
     gpu_buffer* buffer = info->upload.buffer;
+    bool transfer = info->upload.transfer && state.transferGranular;
+    VkCommandBuffer copyCommands = transfer ? info->upload.transfer->commands : commands;
 
     VkPipelineStageFlags prev, next;
     VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -627,15 +787,16 @@ bool gpu_texture_init(gpu_texture* texture, gpu_texture_info* info) {
     if (levelCount > 0) {
       VkBufferImageCopy regions[16];
       for (uint32_t i = 0; i < levelCount; i++) {
+        uint32_t level = levelIndex + i;
         regions[i] = (VkBufferImageCopy) {
           .bufferOffset = buffer->offset + info->upload.levelOffsets[i],
           .imageSubresource.aspectMask = texture->aspect,
-          .imageSubresource.mipLevel = i,
+          .imageSubresource.mipLevel = level,
           .imageSubresource.baseArrayLayer = 0,
           .imageSubresource.layerCount = texture->layers ? info->size[2] : 1,
-          .imageExtent.width = MAX(info->size[0] >> i, 1),
-          .imageExtent.height = MAX(info->size[1] >> i, 1),
-          .imageExtent.depth = texture->layers ? 1 : MAX(info->size[2] >> i, 1)
+          .imageExtent.width = MAX(info->size[0] >> level, 1),
+          .imageExtent.height = MAX(info->size[1] >> level, 1),
+          .imageExtent.depth = texture->layers ? 1 : MAX(info->size[2] >> level, 1)
         };
       }
 
@@ -646,8 +807,23 @@ bool gpu_texture_init(gpu_texture* texture, gpu_texture_info* info) {
       transition.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
       transition.oldLayout = layout;
       transition.newLayout = layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-      vkCmdPipelineBarrier(commands, prev, next, 0, 0, NULL, 0, NULL, 1, &transition);
-      vkCmdCopyBufferToImage(commands, buffer->handle, image, layout, levelCount, regions);
+      vkCmdPipelineBarrier(copyCommands, prev, next, 0, 0, NULL, 0, NULL, 1, &transition);
+      vkCmdCopyBufferToImage(copyCommands, buffer->handle, image, layout, levelCount, regions);
+
+      // Release the image from the transfer queue and acquire it on the main queue
+      if (transfer) {
+        VkImageMemoryBarrier handoff = transition;
+        handoff.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        handoff.dstAccessMask = 0;
+        handoff.oldLayout = layout;
+        handoff.newLayout = layout;
+        handoff.srcQueueFamilyIndex = shared ? VK_QUEUE_FAMILY_IGNORED : state.transferFamilyIndex;
+        handoff.dstQueueFamilyIndex = shared ? VK_QUEUE_FAMILY_IGNORED : state.queueFamilyIndex;
+        vkCmdPipelineBarrier(copyCommands, next, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &handoff);
+        handoff.srcAccessMask = 0;
+        handoff.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commands, next, next, 0, 0, NULL, 0, NULL, 1, &handoff);
+      }
 
       // Generate mipmaps
       if (info->upload.generateMipmaps) {
@@ -655,12 +831,12 @@ bool gpu_texture_init(gpu_texture* texture, gpu_texture_info* info) {
         next = VK_PIPELINE_STAGE_TRANSFER_BIT;
         transition.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         transition.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        transition.subresourceRange.baseMipLevel = 0;
+        transition.subresourceRange.baseMipLevel = levelIndex;
         transition.subresourceRange.levelCount = levelCount;
         transition.oldLayout = layout;
         transition.newLayout = layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
         vkCmdPipelineBarrier(commands, prev, next, 0, 0, NULL, 0, NULL, 1, &transition);
-        for (uint32_t i = levelCount; i < info->mipmaps; i++) {
+        for (uint32_t i = levelIndex + levelCount; i < info->mipmaps; i++) {
           VkImageBlit region = {
             .srcSubresource = {
               .aspectMask = texture->aspect,
@@ -697,7 +873,7 @@ bool gpu_texture_init(gpu_texture* texture, gpu_texture_info* info) {
     vkCmdPipelineBarrier(commands, prev, next, 0, 0, NULL, 0, NULL, 1, &transition);
   }
 
-  texture->memory = memory - state.memory;
+  texture->memory = span;
 
   return true;
 }
@@ -746,7 +922,7 @@ void gpu_texture_destroy(gpu_texture* texture) {
   condemn(texture->view, VK_OBJECT_TYPE_IMAGE_VIEW);
   if (texture->memory == ~0u) return;
   condemn(texture->handle, VK_OBJECT_TYPE_IMAGE);
-  gpu_release(state.memory + texture->memory);
+  gpu_release(texture->memory);
 }
 
 gpu_texture* gpu_surface_acquire() {
@@ -903,20 +1079,44 @@ bool gpu_layout_init(gpu_layout* layout, gpu_layout_info* info) {
   };
 
   VkDescriptorSetLayoutBinding bindings[32];
+  VkDescriptorBindingFlagsEXT bindingFlags[32];
+  layout->updateAfterBind = false;
+
   for (uint32_t i = 0; i < info->count; i++) {
+    uint32_t count = MAX(info->slots[i].count, 1);
+
     bindings[i] = (VkDescriptorSetLayoutBinding) {
       .binding = info->slots[i].number,
       .descriptorType = types[info->slots[i].type],
-      .descriptorCount = 1,
+      .descriptorCount = count,
       .stageFlags = info->slots[i].stages == GPU_STAGE_ALL ? VK_SHADER_STAGE_ALL :
         (((info->slots[i].stages & GPU_STAGE_VERTEX) ? VK_SHADER_STAGE_VERTEX_BIT : 0) |
         ((info->slots[i].stages & GPU_STAGE_FRAGMENT) ? VK_SHADER_STAGE_FRAGMENT_BIT : 0) |
         ((info->slots[i].stages & GPU_STAGE_COMPUTE) ? VK_SHADER_STAGE_COMPUTE_BIT : 0))
     };
+
+    // Descriptor arrays are sparsely populated and written while the bundle is in use
+    if (count > 1) {
+      bindingFlags[i] =
+        VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+      layout->updateAfterBind = true;
+    } else {
+      bindingFlags[i] = 0;
+    }
   }
 
+  VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+    .bindingCount = info->count,
+    .pBindingFlags = bindingFlags
+  };
+
   VkDescriptorSetLayoutCreateInfo layoutInfo = {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .pNext = layout->updateAfterBind ? &bindingFlagsInfo : NULL,
+    .flags = layout->updateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT : 0,
     .bindingCount = info->count,
     .pBindings = bindings
   };
@@ -928,7 +1128,7 @@ bool gpu_layout_init(gpu_layout* layout, gpu_layout_info* info) {
   memset(layout->descriptorCounts, 0, sizeof(layout->descriptorCounts));
 
   for (uint32_t i = 0; i < info->count; i++) {
-    layout->descriptorCounts[info->slots[i].type]++;
+    layout->descriptorCounts[info->slots[i].type] += MAX(info->slots[i].count, 1);
   }
 
   return true;
@@ -1024,8 +1224,15 @@ bool gpu_bundle_pool_init(gpu_bundle_pool* pool, gpu_bundle_pool_info* info) {
     }
   }
 
+  bool updateAfterBind = info->layout ? info->layout->updateAfterBind : false;
+
+  for (uint32_t i = 0; !info->layout && i < info->count; i++) {
+    updateAfterBind |= info->contents[i].layout->updateAfterBind;
+  }
+
   VkDescriptorPoolCreateInfo poolInfo = {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .flags = updateAfterBind ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT : 0,
     .maxSets = info->count,
     .poolSizeCount = poolSizeCount,
     .pPoolSizes = sizes
@@ -1094,7 +1301,7 @@ void gpu_bundle_write(gpu_bundle** bundles, gpu_bundle_info* infos, uint32_t cou
         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
         .dstSet = bundles[i]->handle,
         .dstBinding = binding->number,
-        .dstArrayElement = 0,
+        .dstArrayElement = binding->element,
         .descriptorCount = 1,
         .descriptorType = type,
         .pBufferInfo = &buffers[bufferCount],
@@ -1521,12 +1728,36 @@ void gpu_tally_destroy(gpu_tally* tally) {
   condemn(tally->handle, VK_OBJECT_TYPE_QUERY_POOL);
 }
 
+// Returns false if any of the queries haven't finished yet (the tick that wrote them should have
+// completed before calling this)
+bool gpu_tally_get_data(gpu_tally* tally, uint32_t index, uint32_t count, uint32_t* data) {
+  VkResult result = vkGetQueryPoolResults(state.device, tally->handle, index, count, count * sizeof(uint32_t), data, sizeof(uint32_t), 0);
+  return result == VK_SUCCESS;
+}
+
 // Stream
 
 gpu_stream* gpu_stream_begin(const char* label) {
   gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
-  CHECK(state.streamCount < COUNTOF(tick->streams), "Too many passes") return NULL;
-  gpu_stream* stream = &tick->streams[state.streamCount];
+  CHECK(tick->streamCount < COUNTOF(tick->streams), "Too many passes") return NULL;
+  gpu_stream* stream = &tick->streams[tick->streamCount];
+  nickname(stream->commands, VK_OBJECT_TYPE_COMMAND_BUFFER, label);
+
+  VkCommandBufferBeginInfo beginfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+  };
+
+  VK(vkBeginCommandBuffer(stream->commands, &beginfo), "Failed to begin stream") return NULL;
+  tick->streamCount++;
+  return stream;
+}
+
+gpu_stream* gpu_stream_begin_transfer(const char* label) {
+  if (!state.transferQueue) return NULL;
+  gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
+  CHECK(!tick->transferActive, "Transfer stream was already started this frame") return NULL;
+  gpu_stream* stream = &tick->transfer;
   nickname(stream->commands, VK_OBJECT_TYPE_COMMAND_BUFFER, label);
 
   VkCommandBufferBeginInfo beginfo = {
@@ -1535,7 +1766,40 @@ gpu_stream* gpu_stream_begin(const char* label) {
   };
 
   VK(vkBeginCommandBuffer(stream->commands, &beginfo), "Failed to begin stream") return NULL;
-  state.streamCount++;
+  tick->transferActive = true;
+  return stream;
+}
+
+gpu_stream* gpu_stream_begin_readback(const char* label) {
+  if (!state.transferQueue) return NULL;
+  gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
+  CHECK(!tick->readbackActive, "Readback stream was already started this frame") return NULL;
+  gpu_stream* stream = &tick->readback;
+  nickname(stream->commands, VK_OBJECT_TYPE_COMMAND_BUFFER, label);
+
+  VkCommandBufferBeginInfo beginfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+  };
+
+  VK(vkBeginCommandBuffer(stream->commands, &beginfo), "Failed to begin stream") return NULL;
+  tick->readbackActive = true;
+  return stream;
+}
+
+gpu_stream* gpu_stream_begin_compute(const char* label) {
+  gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
+  if (!state.computeQueue || tick->computeCount >= COUNTOF(tick->compute)) return NULL;
+  gpu_stream* stream = &tick->compute[tick->computeCount];
+  nickname(stream->commands, VK_OBJECT_TYPE_COMMAND_BUFFER, label);
+
+  VkCommandBufferBeginInfo beginfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+  };
+
+  VK(vkBeginCommandBuffer(stream->commands, &beginfo), "Failed to begin stream") return NULL;
+  tick->computeCount++;
   return stream;
 }
 
@@ -1686,6 +1950,24 @@ void gpu_copy_buffers(gpu_stream* stream, gpu_buffer* src, gpu_buffer* dst, uint
   });
 }
 
+void gpu_handoff_buffer(gpu_stream* transfer, gpu_stream* stream, gpu_buffer* buffer) {
+  VkBufferMemoryBarrier handoff = {
+    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .buffer = buffer->handle,
+    .offset = buffer->offset,
+    .size = VK_WHOLE_SIZE
+  };
+
+  VkPipelineStageFlags stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  vkCmdPipelineBarrier(transfer->commands, stage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 1, &handoff, 0, NULL);
+  handoff.srcAccessMask = 0;
+  handoff.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(stream->commands, stage, stage, 0, 0, NULL, 1, &handoff, 0, NULL);
+}
+
 void gpu_copy_textures(gpu_stream* stream, gpu_texture* src, gpu_texture* dst, uint32_t srcOffset[4], uint32_t dstOffset[4], uint32_t size[3]) {
   vkCmdCopyImage(stream->commands, src->handle, VK_IMAGE_LAYOUT_GENERAL, dst->handle, VK_IMAGE_LAYOUT_GENERAL, 1, &(VkImageCopy) {
     .srcSubresource = {
@@ -1717,7 +1999,36 @@ void gpu_copy_buffer_texture(gpu_stream* stream, gpu_buffer* src, gpu_texture* d
     .imageExtent = { extent[0], extent[1], dst->layers ? 1 : extent[2] }
   };
 
-  vkCmdCopyBufferToImage(stream->commands, src->handle, dst->handle, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+  if (dst->layout == VK_IMAGE_LAYOUT_GENERAL) {
+    vkCmdCopyBufferToImage(stream->commands, src->handle, dst->handle, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    return;
+  }
+
+  // Textures without copy usage (e.g. streaming uploads) switch the level to a transfer layout and back
+  VkPipelineStageFlags transfer = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  VkImageMemoryBarrier transition = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .srcAccessMask = 0,
+    .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .oldLayout = dst->layout,
+    .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .image = dst->handle,
+    .subresourceRange.aspectMask = dst->aspect,
+    .subresourceRange.baseMipLevel = dstOffset[3],
+    .subresourceRange.levelCount = 1,
+    .subresourceRange.baseArrayLayer = region.imageSubresource.baseArrayLayer,
+    .subresourceRange.layerCount = region.imageSubresource.layerCount
+  };
+
+  vkCmdPipelineBarrier(stream->commands, transfer, transfer, 0, 0, NULL, 0, NULL, 1, &transition);
+  vkCmdCopyBufferToImage(stream->commands, src->handle, dst->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+  transition.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  transition.dstAccessMask = 0;
+  transition.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  transition.newLayout = dst->layout;
+  vkCmdPipelineBarrier(stream->commands, transfer, transfer, 0, 0, NULL, 0, NULL, 1, &transition);
 }
 
 void gpu_copy_texture_buffer(gpu_stream* stream, gpu_texture* src, gpu_buffer* dst, uint32_t srcOffset[4], uint32_t dstOffset, uint32_t extent[3]) {
@@ -2103,9 +2414,50 @@ bool gpu_init(gpu_config* config) {
     }
     CHECK(state.queueFamilyIndex != ~0u, "Queue selection failed") return gpu_destroy(), false;
 
+    // A transfer-only family is usually backed by DMA engines that copy alongside graphics work
+    state.transferFamilyIndex = ~0u;
+    for (uint32_t i = 0; i < queueFamilyCount; i++) {
+      uint32_t flags = queueFamilies[i].queueFlags;
+      if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        VkExtent3D granularity = queueFamilies[i].minImageTransferGranularity;
+        state.transferGranular = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+        state.transferFamilyIndex = i;
+        break;
+      }
+    }
+
+    // Async compute needs a compute family without graphics, otherwise it would just be another
+    // graphics queue that the driver might serialize with the main one anyway
+    state.computeFamilyIndex = ~0u;
+    for (uint32_t i = 0; config->asyncCompute && i < queueFamilyCount; i++) {
+      uint32_t flags = queueFamilies[i].queueFlags;
+      if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+        state.computeFamilyIndex = i;
+        break;
+      }
+    }
+
+    uint32_t queueCount = 0;
+    VkDeviceQueueCreateInfo queueInfo[3];
+    uint32_t families[] = { state.queueFamilyIndex, state.transferFamilyIndex, state.computeFamilyIndex };
+    for (uint32_t i = 0; i < COUNTOF(families); i++) {
+      if (families[i] == ~0u) continue;
+
+      queueInfo[queueCount++] = (VkDeviceQueueCreateInfo) {
+        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+        .queueFamilyIndex = families[i],
+        .pQueuePriorities = &(float) { 1.f },
+        .queueCount = 1
+      };
+
+      state.sharedFamilies[state.sharedFamilyCount++] = families[i];
+    }
+
     struct { const char* name; bool shouldEnable; bool* flag; } extensions[] = {
       { "VK_KHR_swapchain", state.surface, NULL },
-      { "VK_KHR_portability_subset", true, &state.supports.portability }
+      { "VK_KHR_portability_subset", true, &state.supports.portability },
+      { "VK_EXT_memory_budget", true, &state.supports.memoryBudget },
+      { "VK_EXT_descriptor_indexing", config->bindless && config->features, &state.supports.descriptorIndexing }
     };
 
     VkExtensionProperties extensionInfo[256];
@@ -2125,16 +2477,49 @@ bool gpu_init(gpu_config* config) {
       }
     }
 
+    // Bindless needs descriptor arrays that can be indexed dynamically and written while in use
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT
+    };
+
+    if (state.supports.descriptorIndexing) {
+      VkPhysicalDeviceDescriptorIndexingFeaturesEXT supports = indexingFeatures;
+      VkPhysicalDeviceFeatures2 features2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &supports };
+      vkGetPhysicalDeviceFeatures2(state.adapter, &features2);
+
+      VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT };
+      VkPhysicalDeviceProperties2 properties2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &indexingProperties };
+      vkGetPhysicalDeviceProperties2(state.adapter, &properties2);
+
+      config->features->bindless =
+        supports.runtimeDescriptorArray &&
+        supports.shaderSampledImageArrayNonUniformIndexing &&
+        supports.shaderStorageBufferArrayNonUniformIndexing &&
+        supports.descriptorBindingPartiallyBound &&
+        supports.descriptorBindingSampledImageUpdateAfterBind &&
+        supports.descriptorBindingStorageBufferUpdateAfterBind &&
+        supports.descriptorBindingUpdateUnusedWhilePending &&
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages >= (1 << 16) &&
+        indexingProperties.maxPerStageDescriptorUpdateAfterBindStorageBuffers >= 32;
+
+      if (config->features->bindless) {
+        indexingFeatures.runtimeDescriptorArray = true;
+        indexingFeatures.shaderSampledImageArrayNonUniformIndexing = true;
+        indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = true;
+        indexingFeatures.descriptorBindingPartiallyBound = true;
+        indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = true;
+        indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = true;
+        indexingFeatures.descriptorBindingUpdateUnusedWhilePending = true;
+        indexingFeatures.pNext = enabledFeatures.pNext;
+        enabledFeatures.pNext = &indexingFeatures;
+      }
+    }
+
     VkDeviceCreateInfo deviceInfo = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
       .pNext = config->features ? &enabledFeatures : NULL,
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &(VkDeviceQueueCreateInfo) {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = state.queueFamilyIndex,
-        .pQueuePriorities = &(float) { 1.f },
-        .queueCount = 1
-      },
+      .queueCreateInfoCount = queueCount,
+      .pQueueCreateInfos = queueInfo,
       .enabledExtensionCount = enabledExtensionCount,
       .ppEnabledExtensionNames = enabledExtensions
     };
@@ -2146,6 +2531,19 @@ bool gpu_init(gpu_config* config) {
     }
 
     vkGetDeviceQueue(state.device, state.queueFamilyIndex, 0, &state.queue);
+
+    if (state.transferFamilyIndex != ~0u) {
+      vkGetDeviceQueue(state.device, state.transferFamilyIndex, 0, &state.transferQueue);
+    }
+
+    if (config->device) {
+      config->device->transferQueue = state.transferQueue;
+      config->device->transferImages = state.transferQueue && state.transferGranular;
+    }
+
+    if (state.computeFamilyIndex != ~0u) {
+      vkGetDeviceQueue(state.device, state.computeFamilyIndex, 0, &state.computeQueue);
+    }
     GPU_FOREACH_DEVICE(GPU_LOAD_DEVICE);
   }
 
@@ -2316,23 +2714,79 @@ bool gpu_init(gpu_config* config) {
 
   // Ticks
   for (uint32_t i = 0; i < COUNTOF(state.ticks); i++) {
-    VkCommandPoolCreateInfo poolInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-      .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-      .queueFamilyIndex = state.queueFamilyIndex
-    };
+    for (uint32_t j = 0; j < COUNTOF(state.ticks[i].streams); j++) {
+      gpu_stream* stream = &state.ticks[i].streams[j];
 
-    VK(vkCreateCommandPool(state.device, &poolInfo, NULL, &state.ticks[i].pool), "Command pool creation failed") return gpu_destroy(), false;
+      VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = state.queueFamilyIndex
+      };
 
-    VkCommandBufferAllocateInfo allocateInfo = {
-      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-      .commandPool = state.ticks[i].pool,
-      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-      .commandBufferCount = COUNTOF(state.ticks[i].streams)
-    };
+      VK(vkCreateCommandPool(state.device, &poolInfo, NULL, &stream->pool), "Command pool creation failed") return gpu_destroy(), false;
+
+      VkCommandBufferAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = stream->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+      };
+
+      VK(vkAllocateCommandBuffers(state.device, &allocateInfo, &stream->commands), "Commmand buffer allocation failed") return gpu_destroy(), false;
+    }
+
+    gpu_stream* transferStreams[] = { &state.ticks[i].transfer, &state.ticks[i].readback };
+
+    for (uint32_t j = 0; state.transferQueue && j < COUNTOF(transferStreams); j++) {
+      gpu_stream* stream = transferStreams[j];
+
+      VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = state.transferFamilyIndex
+      };
+
+      VK(vkCreateCommandPool(state.device, &poolInfo, NULL, &stream->pool), "Command pool creation failed") return gpu_destroy(), false;
+
+      VkCommandBufferAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = stream->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+      };
 
-    VkCommandBuffer* commandBuffers = &state.ticks[i].streams[0].commands;
-    VK(vkAllocateCommandBuffers(state.device, &allocateInfo, commandBuffers), "Commmand buffer allocation failed") return gpu_destroy(), false;
+      VK(vkAllocateCommandBuffers(state.device, &allocateInfo, &stream->commands), "Commmand buffer allocation failed") return gpu_destroy(), false;
+      VK(vkCreateSemaphore(state.device, &(VkSemaphoreCreateInfo) { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO }, NULL, &state.ticks[i].semaphores[2 + j]), "Semaphore creation failed") return gpu_destroy(), false;
+    }
+
+    if (state.transferQueue) {
+      VK(vkCreateSemaphore(state.device, &(VkSemaphoreCreateInfo) { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO }, NULL, &state.ticks[i].semaphores[4]), "Semaphore creation failed") return gpu_destroy(), false;
+    }
+
+    for (uint32_t j = 0; state.computeQueue && j < COUNTOF(state.ticks[i].compute); j++) {
+      gpu_stream* stream = &state.ticks[i].compute[j];
+
+      VkCommandPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = state.computeFamilyIndex
+      };
+
+      VK(vkCreateCommandPool(state.device, &poolInfo, NULL, &stream->pool), "Command pool creation failed") return gpu_destroy(), false;
+
+      VkCommandBufferAllocateInfo allocateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = stream->pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+      };
+
+      VK(vkAllocateCommandBuffers(state.device, &allocateInfo, &stream->commands), "Commmand buffer allocation failed") return gpu_destroy(), false;
+    }
+
+    for (uint32_t j = 0; state.computeQueue && j < COUNTOF(state.ticks[i].batchSemaphores); j++) {
+      VK(vkCreateSemaphore(state.device, &(VkSemaphoreCreateInfo) { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO }, NULL, &state.ticks[i].batchSemaphores[j]), "Semaphore creation failed") return gpu_destroy(), false;
+    }
 
     VkSemaphoreCreateInfo semaphoreInfo = {
       .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
@@ -2355,12 +2809,28 @@ bool gpu_init(gpu_config* config) {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO
   };
 
-  // Not using VkPipelineCacheHeaderVersionOne since it's missing from Android headers
+  // Not using VkPipelineCacheHeaderVersionOne since it's missing from Android headers.  Caches are
+  // only used if they came from the same vendor, device, and driver (pipelineCacheUUID), since some
+  // drivers don't validate the data very well.
   if (config->vk.cacheSize >= 16 + VK_UUID_SIZE) {
-    uint32_t headerSize, headerVersion;
-    memcpy(&headerSize, config->vk.cacheData, 4);
-    memcpy(&headerVersion, (char*) config->vk.cacheData + 4, 4);
-    if (headerSize == 16 + VK_UUID_SIZE && headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+    VkPhysicalDeviceProperties2 properties2 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+    vkGetPhysicalDeviceProperties2(state.adapter, &properties2);
+    VkPhysicalDeviceProperties* properties = &properties2.properties;
+
+    uint32_t headerSize, headerVersion, vendorId, deviceId;
+    char* data = config->vk.cacheData;
+    memcpy(&headerSize, data + 0, 4);
+    memcpy(&headerVersion, data + 4, 4);
+    memcpy(&vendorId, data + 8, 4);
+    memcpy(&deviceId, data + 12, 4);
+
+    if (
+      headerSize == 16 + VK_UUID_SIZE &&
+      headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+      vendorId == properties->vendorID &&
+      deviceId == properties->deviceID &&
+      !memcmp(data + 16, properties->pipelineCacheUUID, VK_UUID_SIZE)
+    ) {
       cacheInfo.initialDataSize = config->vk.cacheSize;
       cacheInfo.pInitialData = config->vk.cacheData;
     }
@@ -2383,9 +2853,22 @@ void gpu_destroy(void) {
   }
   for (uint32_t i = 0; i < COUNTOF(state.ticks); i++) {
     gpu_tick* tick = &state.ticks[i];
-    if (tick->pool) vkDestroyCommandPool(state.device, tick->pool, NULL);
+    for (uint32_t j = 0; j < COUNTOF(tick->streams); j++) {
+      if (tick->streams[j].pool) vkDestroyCommandPool(state.device, tick->streams[j].pool, NULL);
+    }
+    if (tick->transfer.pool) vkDestroyCommandPool(state.device, tick->transfer.pool, NULL);
+    if (tick->readback.pool) vkDestroyCommandPool(state.device, tick->readback.pool, NULL);
+    for (uint32_t j = 0; j < COUNTOF(tick->compute); j++) {
+      if (tick->compute[j].pool) vkDestroyCommandPool(state.device, tick->compute[j].pool, NULL);
+    }
+    for (uint32_t j = 0; j < COUNTOF(tick->batchSemaphores); j++) {
+      if (tick->batchSemaphores[j]) vkDestroySemaphore(state.device, tick->batchSemaphores[j], NULL);
+    }
     if (tick->semaphores[0]) vkDestroySemaphore(state.device, tick->semaphores[0], NULL);
     if (tick->semaphores[1]) vkDestroySemaphore(state.device, tick->semaphores[1], NULL);
+    if (tick->semaphores[2]) vkDestroySemaphore(state.device, tick->semaphores[2], NULL);
+    if (tick->semaphores[3]) vkDestroySemaphore(state.device, tick->semaphores[3], NULL);
+    if (tick->semaphores[4]) vkDestroySemaphore(state.device, tick->semaphores[4], NULL);
     if (tick->fence) vkDestroyFence(state.device, tick->fence, NULL);
   }
   for (uint32_t i = 0; i < COUNTOF(state.framebuffers); i++) {
@@ -2423,34 +2906,176 @@ uint32_t gpu_begin() {
   gpu_wait_tick(++state.tick[CPU] - COUNTOF(state.ticks));
   gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
   VK(vkResetFences(state.device, 1, &tick->fence), "Fence reset failed") return 0;
-  VK(vkResetCommandPool(state.device, tick->pool, 0), "Command pool reset failed") return 0;
+  for (uint32_t i = 0; i < tick->streamCount; i++) {
+    VK(vkResetCommandPool(state.device, tick->streams[i].pool, 0), "Command pool reset failed") return 0;
+  }
+  if (tick->transfer.pool) {
+    VK(vkResetCommandPool(state.device, tick->transfer.pool, 0), "Command pool reset failed") return 0;
+    VK(vkResetCommandPool(state.device, tick->readback.pool, 0), "Command pool reset failed") return 0;
+  }
+  for (uint32_t i = 0; i < tick->computeCount; i++) {
+    VK(vkResetCommandPool(state.device, tick->compute[i].pool, 0), "Command pool reset failed") return 0;
+  }
+  tick->computeCount = 0;
   state.scratchpad[GPU_MAP_STREAM].cursor = 0;
   state.scratchpad[GPU_MAP_READBACK].cursor = 0;
-  state.streamCount = 0;
+  tick->streamCount = 0;
   expunge();
   return state.tick[CPU];
 }
 
-void gpu_submit(gpu_stream** streams, uint32_t count) {
+void gpu_submit(gpu_batch* batches, uint32_t count) {
   gpu_tick* tick = &state.ticks[state.tick[CPU] & TICK_MASK];
+  CHECK(count <= COUNTOF(tick->batchSemaphores), "Too many batches") return;
+
+  // A batch signals its semaphore if a later batch on the other queue waits for it.  Waits that
+  // are already covered by an earlier wait on the same queue are skipped, since binary semaphores
+  // can only be waited on once.
+  bool signal[COUNTOF(tick->batchSemaphores)] = { 0 };
+  uint32_t waitFor[COUNTOF(tick->batchSemaphores)];
+  uint32_t waited[2] = { 0, 0 };
+  uint32_t lastCompute = 0;
+  uint32_t lastGraphics = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t queue = batches[i].compute;
+    uint32_t wait = batches[i].wait;
+    waitFor[i] = wait > waited[queue] ? wait : 0;
+
+    if (waitFor[i]) {
+      signal[wait - 1] = true;
+      waited[queue] = wait;
+    }
+
+    if (batches[i].compute) {
+      lastCompute = i + 1;
+    } else {
+      lastGraphics = i + 1;
+    }
+  }
+
+  // The tick's fence is signaled on the main queue, so it has to wait for leftover compute work
+  bool drain = lastCompute > waited[0];
+
+  if (drain) {
+    signal[lastCompute - 1] = true;
+  }
+
+  // Uploads go first on the transfer queue, the graphics queue waits for them before copying
+  bool waitForTransfer = tick->transferActive;
+
+  if (tick->transferActive) {
+    VkSubmitInfo transfer = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &tick->transfer.commands,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &tick->semaphores[2]
+    };
+
+    VK(vkQueueSubmit(state.transferQueue, 1, &transfer, VK_NULL_HANDLE), "Queue submit failed") {}
+    tick->transferActive = false;
+  }
 
-  VkCommandBuffer commands[COUNTOF(tick->streams)];
   for (uint32_t i = 0; i < count; i++) {
-    commands[i] = streams[i]->commands;
+    gpu_batch* batch = &batches[i];
+
+    VkCommandBuffer commands[COUNTOF(tick->streams)];
+    for (uint32_t j = 0; j < batch->count; j++) {
+      commands[j] = batch->streams[j]->commands;
+    }
+
+    VkSemaphore waits[4];
+    VkPipelineStageFlags waitStages[4];
+    uint32_t waitCount = 0;
+
+    // Readbacks from the previous submit may still be reading resources this one writes to.  Async
+    // compute batches always wait for the first main queue batch, so they're covered too.
+    if (!batch->compute && state.readbackSemaphore) {
+      waits[waitCount] = state.readbackSemaphore;
+      waitStages[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+      state.readbackSemaphore = VK_NULL_HANDLE;
+    }
+
+    if (!batch->compute && state.swapchainSemaphore) {
+      waits[waitCount] = state.swapchainSemaphore;
+      waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+      state.swapchainSemaphore = VK_NULL_HANDLE;
+    }
+
+    if (!batch->compute && waitForTransfer) {
+      waits[waitCount] = tick->semaphores[2];
+      waitStages[waitCount++] = VK_PIPELINE_STAGE_TRANSFER_BIT;
+      waitForTransfer = false;
+    }
+
+    if (waitFor[i]) {
+      waits[waitCount] = tick->batchSemaphores[waitFor[i] - 1];
+      waitStages[waitCount++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+
+    // The last submit on the main queue signals the fence, or the semaphore readbacks wait on
+    bool last = !drain && i + 1 == lastGraphics;
+    VkSemaphore signals[2];
+    uint32_t signalCount = 0;
+
+    if (signal[i]) {
+      signals[signalCount++] = tick->batchSemaphores[i];
+    }
+
+    if (last && tick->readbackActive) {
+      signals[signalCount++] = tick->semaphores[3];
+    }
+
+    VkSubmitInfo submit = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = waitCount,
+      .pWaitSemaphores = waits,
+      .pWaitDstStageMask = waitStages,
+      .commandBufferCount = batch->count,
+      .pCommandBuffers = commands,
+      .signalSemaphoreCount = signalCount,
+      .pSignalSemaphores = signals
+    };
+
+    VkQueue queue = batch->compute ? state.computeQueue : state.queue;
+    VkFence fence = last && !tick->readbackActive ? tick->fence : VK_NULL_HANDLE;
+    VK(vkQueueSubmit(queue, 1, &submit, fence), "Queue submit failed") {}
   }
 
-  VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  if (drain) {
+    VkSubmitInfo submit = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &tick->batchSemaphores[lastCompute - 1],
+      .pWaitDstStageMask = &(VkPipelineStageFlags) { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT },
+      .signalSemaphoreCount = tick->readbackActive,
+      .pSignalSemaphores = &tick->semaphores[3]
+    };
 
-  VkSubmitInfo submit = {
-    .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-    .waitSemaphoreCount = !!state.swapchainSemaphore,
-    .pWaitSemaphores = &state.swapchainSemaphore,
-    .pWaitDstStageMask = &waitStage,
-    .commandBufferCount = count,
-    .pCommandBuffers = commands
-  };
+    VkFence fence = tick->readbackActive ? VK_NULL_HANDLE : tick->fence;
+    VK(vkQueueSubmit(state.queue, 1, &submit, fence), "Queue submit failed") {}
+  }
+
+  // Readbacks copy on the transfer queue once all of the tick's work is done, so they signal the
+  // tick's fence instead
+  if (tick->readbackActive) {
+    VkSubmitInfo readback = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .waitSemaphoreCount = 1,
+      .pWaitSemaphores = &tick->semaphores[3],
+      .pWaitDstStageMask = &(VkPipelineStageFlags) { VK_PIPELINE_STAGE_TRANSFER_BIT },
+      .commandBufferCount = 1,
+      .pCommandBuffers = &tick->readback.commands,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &tick->semaphores[4]
+    };
+
+    VK(vkQueueSubmit(state.transferQueue, 1, &readback, tick->fence), "Queue submit failed") {}
+    state.readbackSemaphore = tick->semaphores[4];
+    tick->readbackActive = false;
+  }
 
-  VK(vkQueueSubmit(state.queue, 1, &submit, tick->fence), "Queue submit failed") {}
   state.swapchainSemaphore = VK_NULL_HANDLE;
 }
 
@@ -2504,6 +3129,77 @@ void gpu_wait_idle() {
   vkDeviceWaitIdle(state.device);
 }
 
+void gpu_get_memory_stats(gpu_memory_stats* stats) {
+  memset(stats, 0, sizeof(*stats));
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+  };
+
+  VkPhysicalDeviceMemoryProperties2 properties = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+    .pNext = state.supports.memoryBudget ? &budget : NULL
+  };
+
+  vkGetPhysicalDeviceMemoryProperties2(state.adapter, &properties);
+  VkPhysicalDeviceMemoryProperties* memoryProperties = &properties.memoryProperties;
+
+  stats->heapCount = MIN(memoryProperties->memoryHeapCount, COUNTOF(stats->heaps));
+  stats->budget = state.supports.memoryBudget;
+
+  // Without the budget extension, the best we can do is report the heap size and our own usage
+  for (uint32_t i = 0; i < stats->heapCount; i++) {
+    stats->heaps[i].size = memoryProperties->memoryHeaps[i].size;
+    stats->heaps[i].deviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    stats->heaps[i].budget = stats->budget ? budget.heapBudget[i] : stats->heaps[i].size;
+    stats->heaps[i].usage = stats->budget ? budget.heapUsage[i] : 0;
+  }
+
+  lock(&state.memoryLock);
+
+  for (uint32_t i = 0; i < COUNTOF(state.memory); i++) {
+    gpu_memory* memory = &state.memory[i];
+    if (!memory->handle) continue;
+    gpu_allocator* allocator = &state.allocators[memory->allocator];
+    uint32_t usage = MIN(memory->allocator, GPU_MEMORY_USAGE_TEXTURE);
+    stats->types[usage].allocated += memory->size;
+    stats->types[usage].blocks++;
+
+    uint32_t heap = memoryProperties->memoryTypes[allocator->memoryType].heapIndex;
+    if (!stats->budget && heap < stats->heapCount) {
+      stats->heaps[heap].usage += memory->size;
+    }
+  }
+
+  for (uint32_t i = 1; i <= state.spanCount; i++) {
+    gpu_span* span = &state.spans[i];
+    if (!span->size) continue;
+    uint32_t usage = MIN(span->allocator, GPU_MEMORY_USAGE_TEXTURE);
+    if (span->free) {
+      stats->types[usage].free += span->size;
+      stats->types[usage].largestFree = MAX(stats->types[usage].largestFree, span->size);
+    } else {
+      stats->types[usage].used += span->size;
+      stats->types[usage].allocations++;
+    }
+  }
+
+  unlock(&state.memoryLock);
+
+  for (uint32_t i = 0; i < COUNTOF(state.scratchpad); i++) {
+    gpu_scratchpad* pool = &state.scratchpad[i];
+    lock(&pool->lock);
+    if (pool->buffer) {
+      stats->scratchpad[i] = (uint64_t) pool->size * (i == GPU_MAP_STAGING ? 1 : COUNTOF(state.ticks));
+    }
+    unlock(&pool->lock);
+  }
+
+  lock(&state.morgueLock);
+  stats->condemned = state.morgue.head - state.morgue.tail;
+  unlock(&state.morgueLock);
+}
+
 uintptr_t gpu_vk_get_instance() {
   return (uintptr_t) state.instance;
 }
@@ -2531,96 +3227,370 @@ static uint32_t hash32(uint32_t initial, void* data, uint32_t size) {
   return hash;
 }
 
-static gpu_memory* gpu_allocate(gpu_memory_type type, VkMemoryRequirements info, VkDeviceSize* offset) {
-  gpu_allocator* allocator = &state.allocators[state.allocatorLookup[type]];
+// The locks are usually uncontended, but some are held across slow driver calls (allocating
+// memory, creating render passes), so waiters spin briefly and then yield their core
+static void lock(atomic_flag* flag) {
+  for (uint32_t spins = 0; atomic_flag_test_and_set(flag); spins++) {
+    if (spins < 64) {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+      _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    } else {
+#ifdef _WIN32
+      SwitchToThread();
+#else
+      sched_yield();
+#endif
+    }
+  }
+}
 
-  static const uint32_t blockSizes[] = {
-    [GPU_MEMORY_BUFFER_GPU] = 1 << 26,
-    [GPU_MEMORY_BUFFER_MAP_STREAM] = 0,
-    [GPU_MEMORY_BUFFER_MAP_STAGING] = 0,
-    [GPU_MEMORY_BUFFER_MAP_READBACK] = 0,
-    [GPU_MEMORY_TEXTURE_COLOR] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_D16] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_D32F] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_D24S8] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_D32FS8] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_LAZY_COLOR] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_LAZY_D16] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_LAZY_D32F] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_LAZY_D24S8] = 1 << 28,
-    [GPU_MEMORY_TEXTURE_LAZY_D32FS8] = 1 << 28
-  };
+static void unlock(atomic_flag* flag) {
+  atomic_flag_clear(flag);
+}
 
-  uint32_t blockSize = blockSizes[type];
-  uint32_t cursor = ALIGN(allocator->cursor, info.alignment);
+static uint32_t findMSB(uint32_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanReverse(&index, x);
+  return index;
+#else
+  return 31 - __builtin_clz(x);
+#endif
+}
+
+static uint32_t findLSB(uint32_t x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, x);
+  return index;
+#else
+  return __builtin_ctz(x);
+#endif
+}
+
+static void tlsf_mapping(uint32_t size, uint32_t* fl, uint32_t* sl) {
+  if (size < TLSF_SL_COUNT) {
+    *fl = 0;
+    *sl = size;
+  } else {
+    uint32_t msb = findMSB(size);
+    *fl = msb - TLSF_SL_LOG + 1;
+    *sl = (size >> (msb - TLSF_SL_LOG)) ^ TLSF_SL_COUNT;
+  }
+}
+
+static void tlsf_insert(gpu_allocator* allocator, uint32_t index) {
+  gpu_span* span = &state.spans[index];
+  uint32_t fl, sl;
+  tlsf_mapping(span->size, &fl, &sl);
+  uint32_t head = allocator->heads[fl][sl];
+  span->free = true;
+  span->prevFree = 0;
+  span->nextFree = head;
+  if (head) state.spans[head].prevFree = index;
+  allocator->heads[fl][sl] = index;
+  allocator->slBitmap[fl] |= 1u << sl;
+  allocator->flBitmap |= 1u << fl;
+}
+
+static void tlsf_remove(gpu_allocator* allocator, uint32_t index) {
+  gpu_span* span = &state.spans[index];
+  uint32_t fl, sl;
+  tlsf_mapping(span->size, &fl, &sl);
+  if (span->prevFree) state.spans[span->prevFree].nextFree = span->nextFree;
+  if (span->nextFree) state.spans[span->nextFree].prevFree = span->prevFree;
+  if (allocator->heads[fl][sl] == index) {
+    allocator->heads[fl][sl] = span->nextFree;
+    if (!span->nextFree) {
+      allocator->slBitmap[fl] &= ~(1u << sl);
+      if (!allocator->slBitmap[fl]) {
+        allocator->flBitmap &= ~(1u << fl);
+      }
+    }
+  }
+  span->free = false;
+}
+
+// Returns a free span that is at least size bytes, rounding the size up to the next list so any
+// span in that list is big enough
+static uint32_t tlsf_find(gpu_allocator* allocator, uint32_t size) {
+  if (size >= TLSF_SL_COUNT) {
+    uint32_t round = (1u << (findMSB(size) - TLSF_SL_LOG)) - 1;
+    if (size > ~0u - round) return 0;
+    size += round;
+  }
+
+  uint32_t fl, sl;
+  tlsf_mapping(size, &fl, &sl);
+  uint32_t slMap = allocator->slBitmap[fl] & (~0u << sl);
+
+  if (!slMap) {
+    uint32_t flMap = fl < 31 ? allocator->flBitmap & (~0u << (fl + 1)) : 0;
+    if (!flMap) return 0;
+    fl = findLSB(flMap);
+    slMap = allocator->slBitmap[fl];
+  }
 
-  if (allocator->block && cursor + info.size <= blockSize) {
-    allocator->cursor = cursor + info.size;
-    allocator->block->refs++;
-    *offset = cursor;
-    return allocator->block;
+  sl = findLSB(slMap);
+  return allocator->heads[fl][sl];
+}
+
+static uint32_t gpu_span_create(uint32_t block, uint32_t allocator, uint32_t offset, uint32_t size) {
+  uint32_t index;
+
+  if (state.spanFree) {
+    index = state.spanFree;
+    state.spanFree = state.spans[index].nextFree;
+  } else if (state.spanCount + 1 < COUNTOF(state.spans)) {
+    index = ++state.spanCount;
+  } else {
+    return 0;
   }
 
-  // If there wasn't an active block or it overflowed, find an empty block to allocate
+  state.spansUsed++;
+
+  state.spans[index] = (gpu_span) {
+    .offset = offset,
+    .size = size,
+    .block = block,
+    .allocator = allocator
+  };
+
+  return index;
+}
+
+static void gpu_span_destroy(uint32_t index) {
+  state.spans[index].size = 0;
+  state.spans[index].nextFree = state.spanFree;
+  state.spanFree = index;
+  state.spansUsed--;
+}
+
+// Called with the memory lock held, so errors are returned instead of reported
+static gpu_memory* gpu_allocate_block(uint32_t allocatorIndex, uint32_t size, const char** error) {
+  gpu_allocator* allocator = &state.allocators[allocatorIndex];
+
   for (uint32_t i = 0; i < COUNTOF(state.memory); i++) {
     if (!state.memory[i].handle) {
       gpu_memory* memory = &state.memory[i];
 
       VkMemoryAllocateInfo memoryInfo = {
         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = MAX(blockSize, info.size),
+        .allocationSize = size,
         .memoryTypeIndex = allocator->memoryType
       };
 
-      VK(vkAllocateMemory(state.device, &memoryInfo, NULL, &memory->handle), "Failed to allocate GPU memory") {
-        allocator->block = NULL;
+      if (vkAllocateMemory(state.device, &memoryInfo, NULL, &memory->handle) < 0) {
+        memory->handle = NULL;
+        *error = "Failed to allocate GPU memory";
         return NULL;
       }
 
       if (allocator->memoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
-        VK(vkMapMemory(state.device, memory->handle, 0, VK_WHOLE_SIZE, 0, &memory->pointer), "Failed to map memory") {
+        if (vkMapMemory(state.device, memory->handle, 0, VK_WHOLE_SIZE, 0, &memory->pointer) < 0) {
           vkFreeMemory(state.device, memory->handle, NULL);
           memory->handle = NULL;
+          *error = "Failed to map memory";
           return NULL;
         }
       } else {
         memory->pointer = NULL;
       }
 
-      allocator->block = memory;
-      allocator->cursor = info.size;
-      allocator->block->refs = 1;
-      *offset = 0;
+      memory->size = size;
+      memory->allocator = allocatorIndex;
       return memory;
     }
   }
 
-  check(false, "Out of GPU memory");
+  *error = "Out of GPU memory";
   return NULL;
 }
 
-static void gpu_release(gpu_memory* memory) {
-  if (memory && --memory->refs == 0) {
-    condemn(memory->handle, VK_OBJECT_TYPE_DEVICE_MEMORY);
-    memory->handle = NULL;
+// Allocations are sub-allocated from big blocks using a TLSF allocator, except for allocations that
+// are too big to share a block, have a very large alignment, or use memory types without blocks,
+// which get their own dedicated memory.  Returns a span index, or 0 if the allocation failed.
+// Failures aren't reported here, since callers can be holding locks of their own.  They clean up
+// and then report the error.
+static uint32_t gpu_allocate(gpu_memory_type type, VkMemoryRequirements info, const char** error) {
+  lock(&state.memoryLock);
+  uint32_t allocatorIndex = state.allocatorLookup[type];
+  gpu_allocator* allocator = &state.allocators[allocatorIndex];
 
-    for (uint32_t i = 0; i < COUNTOF(state.allocators); i++) {
-      if (state.allocators[i].block == memory) {
-        state.allocators[i].block = NULL;
-        state.allocators[i].cursor = 0;
-      }
+  static const uint32_t blockSizes[] = {
+    [GPU_MEMORY_BUFFER_GPU] = 1 << 26,
+    [GPU_MEMORY_BUFFER_MAP_STREAM] = 0,
+    [GPU_MEMORY_BUFFER_MAP_STAGING] = 0,
+    [GPU_MEMORY_BUFFER_MAP_READBACK] = 0,
+    [GPU_MEMORY_TEXTURE_COLOR] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_D16] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_D32F] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_D24S8] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_D32FS8] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_LAZY_COLOR] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_LAZY_D16] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_LAZY_D32F] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_LAZY_D24S8] = 1 << 28,
+    [GPU_MEMORY_TEXTURE_LAZY_D32FS8] = 1 << 28
+  };
+
+  uint32_t blockSize = blockSizes[type];
+
+  if (info.size > UINT32_MAX) {
+    unlock(&state.memoryLock);
+    *error = "GPU allocation is too big";
+    return 0;
+  }
+
+  // Splitting a span can use up to 2 extra spans, so make sure there's room for them up front
+  if (state.spansUsed + 3 >= COUNTOF(state.spans)) {
+    unlock(&state.memoryLock);
+    *error = "Too many GPU memory allocations";
+    return 0;
+  }
+
+  uint32_t size = (uint32_t) info.size;
+  uint32_t alignment = (uint32_t) info.alignment;
+
+  // Memory objects are aligned for any resource, so large alignments don't waste a block on padding
+  if (size > blockSize / 2 || info.alignment > (1u << 16)) {
+    gpu_memory* memory = gpu_allocate_block(allocatorIndex, size, error);
+    uint32_t span = memory ? gpu_span_create(memory - state.memory, allocatorIndex, 0, size) : 0;
+    if (memory) memory->dedicated = true;
+    unlock(&state.memoryLock);
+    return span;
+  }
+
+  uint32_t request = size + alignment - 1;
+  uint32_t index = tlsf_find(allocator, request);
+
+  if (!index) {
+    gpu_memory* memory = gpu_allocate_block(allocatorIndex, blockSize, error);
+
+    if (!memory) {
+      unlock(&state.memoryLock);
+      return 0;
     }
+
+    memory->dedicated = false;
+    allocator->blockCount++;
+    index = gpu_span_create(memory - state.memory, allocatorIndex, 0, blockSize);
+    tlsf_insert(allocator, index);
+    index = tlsf_find(allocator, request);
+  }
+
+  tlsf_remove(allocator, index);
+  gpu_span* span = &state.spans[index];
+
+  // Give any padding needed for alignment back to the free list as its own span
+  uint32_t padding = ALIGN(span->offset, alignment) - span->offset;
+  if (padding > 0) {
+    uint32_t front = gpu_span_create(span->block, allocatorIndex, span->offset, padding);
+    state.spans[front].prev = span->prev;
+    state.spans[front].next = index;
+    if (span->prev) state.spans[span->prev].next = front;
+    span->prev = front;
+    span->offset += padding;
+    span->size -= padding;
+    tlsf_insert(allocator, front);
+  }
+
+  // Split off the unused tail, unless it's too small to be worth tracking
+  if (span->size - size >= 256) {
+    uint32_t back = gpu_span_create(span->block, allocatorIndex, span->offset + size, span->size - size);
+    state.spans[back].prev = index;
+    state.spans[back].next = span->next;
+    if (span->next) state.spans[span->next].prev = back;
+    span->next = back;
+    span->size = size;
+    tlsf_insert(allocator, back);
+  }
+
+  unlock(&state.memoryLock);
+  return index;
+}
+
+// Spans aren't freed until the GPU is done with them.  Instead of using the morgue, released spans
+// are queued up in their own list, linked through nextFree (allocated spans aren't in a free list).
+// Every span can be in the list at most once, so unlike the morgue it can't overflow.
+static void gpu_release(uint32_t index) {
+  if (!index) return;
+  lock(&state.memoryLock);
+  gpu_span* span = &state.spans[index];
+  span->tick = state.tick[CPU];
+  span->nextFree = 0;
+  if (state.releasedTail) {
+    state.spans[state.releasedTail].nextFree = index;
+  } else {
+    state.releasedHead = index;
+  }
+  state.releasedTail = index;
+  unlock(&state.memoryLock);
+}
+
+// Coalesces a freed span with its free neighbors.  Blocks that become completely empty are freed,
+// except for the last block of each allocator, which is kept around to avoid thrashing.  Called with
+// the memory lock held.
+static void gpu_free_span(uint32_t index) {
+  gpu_span* span = &state.spans[index];
+  gpu_memory* memory = &state.memory[span->block];
+  gpu_allocator* allocator = &state.allocators[span->allocator];
+
+  if (memory->dedicated) {
+    vkFreeMemory(state.device, memory->handle, NULL);
+    memory->handle = NULL;
+    gpu_span_destroy(index);
+    return;
+  }
+
+  if (span->prev && state.spans[span->prev].free) {
+    uint32_t prev = span->prev;
+    tlsf_remove(allocator, prev);
+    state.spans[prev].size += span->size;
+    state.spans[prev].next = span->next;
+    if (span->next) state.spans[span->next].prev = prev;
+    gpu_span_destroy(index);
+    index = prev;
+    span = &state.spans[index];
+  }
+
+  if (span->next && state.spans[span->next].free) {
+    uint32_t next = span->next;
+    tlsf_remove(allocator, next);
+    span->size += state.spans[next].size;
+    span->next = state.spans[next].next;
+    if (span->next) state.spans[span->next].prev = index;
+    gpu_span_destroy(next);
+  }
+
+  if (!span->prev && !span->next && allocator->blockCount > 1) {
+    vkFreeMemory(state.device, memory->handle, NULL);
+    memory->handle = NULL;
+    allocator->blockCount--;
+    gpu_span_destroy(index);
+  } else {
+    tlsf_insert(allocator, index);
   }
 }
 
 static void condemn(void* handle, VkObjectType type) {
   if (!handle) return;
+  lock(&state.morgueLock);
   gpu_morgue* morgue = &state.morgue;
-  check(morgue->head - morgue->tail < COUNTOF(morgue->data), "Morgue overflow (too many objects waiting to be deleted)");
+  if (morgue->head - morgue->tail >= COUNTOF(morgue->data)) {
+    unlock(&state.morgueLock);
+    check(false, "Morgue overflow (too many objects waiting to be deleted)");
+    return;
+  }
   morgue->data[morgue->head++ & MORGUE_MASK] = (gpu_victim) { handle, type, state.tick[CPU] };
+  unlock(&state.morgueLock);
 }
 
 static void expunge() {
+  lock(&state.morgueLock);
   gpu_morgue* morgue = &state.morgue;
   while (morgue->tail != morgue->head && state.tick[GPU] >= morgue->data[morgue->tail & MORGUE_MASK].tick) {
     gpu_victim* victim = &morgue->data[morgue->tail++ & MORGUE_MASK];
@@ -2640,6 +3610,17 @@ static void expunge() {
       default: check(false, "Unreachable"); break;
     }
   }
+  unlock(&state.morgueLock);
+
+  // Spans are freed after the objects using them are destroyed
+  lock(&state.memoryLock);
+  while (state.releasedHead && state.tick[GPU] >= state.spans[state.releasedHead].tick) {
+    uint32_t index = state.releasedHead;
+    state.releasedHead = state.spans[index].nextFree;
+    if (!state.releasedHead) state.releasedTail = 0;
+    gpu_free_span(index);
+  }
+  unlock(&state.memoryLock);
 }
 
 static bool hasLayer(VkLayerProperties* layers, uint32_t count, const char* layer) {
@@ -2778,6 +3759,8 @@ static VkRenderPass getCachedRenderPass(gpu_pass_info* pass, bool exact) {
 
   // Search for a pass, they are always stored in MRU order, which requires moving it to the first
   // column if you end up using it, and shifting down the rest (dunno if that's actually worth it)
+  // Pipelines can be created on other threads, so the render pass cache needs to be locked
+  lock(&state.cacheLock);
   uint32_t rows = COUNTOF(state.renderpasses);
   uint32_t cols = COUNTOF(state.renderpasses[0]);
   gpu_cache_entry* row = state.renderpasses[hash & (rows - 1)];
@@ -2790,6 +3773,7 @@ static VkRenderPass getCachedRenderPass(gpu_pass_info* pass, bool exact) {
         }
         row[0] = entry;
       }
+      unlock(&state.cacheLock);
       return entry.object;
     }
   }
@@ -2882,6 +3866,7 @@ static VkRenderPass getCachedRenderPass(gpu_pass_info* pass, bool exact) {
 
   VkRenderPass handle;
   VK(vkCreateRenderPass(state.device, &info, NULL, &handle), "Could not create render pass") {
+    unlock(&state.cacheLock);
     return VK_NULL_HANDLE;
   }
 
@@ -2890,6 +3875,7 @@ static VkRenderPass getCachedRenderPass(gpu_pass_info* pass, bool exact) {
 
   row[0].object = handle;
   row[0].hash = hash;
+  unlock(&state.cacheLock);
 
   return handle;
 }
@@ -373,6 +373,14 @@ static spv_result spv_parse_variable(spv_context* spv, const uint32_t* op, spv_i
     }
 
     resource->arraySize = length[3];
+  } else if (OP_CODE(type) == 29) { // OpTypeRuntimeArray
+    typeId = type[2];
+
+    if (!spv_load_type(spv, typeId, &type)) {
+      return SPV_INVALID;
+    }
+
+    resource->arraySize = ~0u;
   } else {
     resource->arraySize = 0;
   }
@@ -52,7 +52,7 @@ typedef struct {
   uint32_t binding;
   const char* name;
   spv_resource_type type;
-  uint32_t arraySize;
+  uint32_t arraySize; // 0 for non-arrays, ~0u for runtime arrays
 } spv_resource;
 
 typedef struct {
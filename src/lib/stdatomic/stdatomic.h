@@ -144,10 +144,15 @@ _Bool atomic_flag_clear_explicit(volatile atomic_flag*, memory_order);
 #include <intrin.h>
 
 typedef volatile long atomic_uint;
+typedef volatile long atomic_flag;
 
 #define atomic_fetch_add(p, x) _InterlockedExchangeAdd(p, x)
 #define atomic_fetch_sub(p, x) _InterlockedExchangeAdd(p, -(x))
 
+#define ATOMIC_FLAG_INIT 0
+#define atomic_flag_test_and_set(f) _InterlockedExchange(f, 1)
+#define atomic_flag_clear(f) _InterlockedExchange(f, 0)
+
 #define ATOMIC_INT_LOCK_FREE 2
 
 #endif
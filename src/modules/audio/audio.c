@@ -79,6 +79,7 @@ static void onPlayback(ma_device* device, void* out, const void* in, uint32_t co
   float* dst = out;
   float* buf = NULL; // The "current" buffer (used for fast paths)
 
+  lovrProfileBegin("audio");
   ma_mutex_lock(&state.lock);
 
   Source* source;
@@ -171,6 +172,8 @@ static void onPlayback(ma_device* device, void* out, const void* in, uint32_t co
       count -= framesConsumed;
     }
   }
+
+  lovrProfileEnd("audio");
 }
 
 static void onCapture(ma_device* device, void* output, const void* input, uint32_t count) {
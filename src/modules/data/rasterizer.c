@@ -14,6 +14,7 @@ struct Rasterizer {
   float ascent;
   float descent;
   float leading;
+  uint64_t hash;
   struct Blob* blob;
   stbtt_fontinfo font;
 };
@@ -41,6 +42,9 @@ Rasterizer* lovrRasterizerCreate(Blob* blob, float size) {
   rasterizer->descent = descent * rasterizer->scale;
   rasterizer->leading = (ascent - descent + lineGap) * rasterizer->scale;
 
+  // Hashed up front, since rasterizers are shared with worker threads
+  rasterizer->hash = blob ? hash64(blob->data, blob->size) : hash64(etc_VarelaRound_ttf, etc_VarelaRound_ttf_len);
+
   return rasterizer;
 }
 
@@ -54,6 +58,11 @@ float lovrRasterizerGetFontSize(Rasterizer* rasterizer) {
   return rasterizer->size;
 }
 
+// Hash of the font file
+uint64_t lovrRasterizerGetHash(Rasterizer* rasterizer) {
+  return rasterizer->hash;
+}
+
 uint32_t lovrRasterizerGetGlyphCount(Rasterizer* rasterizer) {
   return rasterizer->font.numGlyphs;
 }
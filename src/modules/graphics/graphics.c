@@ -14,13 +14,20 @@
 #include "monkey.h"
 #include "shaders.h"
 #include <math.h>
+#include <float.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #ifdef LOVR_USE_GLSLANG
 #include "glslang_c_interface.h"
 #include "resource_limits_c.h"
 #endif
+#ifndef LOVR_DISABLE_THREAD
+#include "lib/tinycthread/tinycthread.h"
+#include <setjmp.h>
+#include <stdio.h>
+#endif
 
 uint32_t os_vk_create_surface(void* instance, void** surface);
 const char** os_vk_get_instance_extensions(uint32_t* count);
@@ -29,6 +36,21 @@ const char** os_vk_get_instance_extensions(uint32_t* count);
 #define MAX_PIPELINES 4
 #define MAX_SHADER_RESOURCES 32
 #define FLOAT_BITS(f) ((union { float f; uint32_t u; }) { f }).u
+#define AUTO_INSTANCE_BIT 0x100
+#define TEXTURE_STREAM_BUDGET (1 << 23)
+#define TRANSFER_QUEUE_THRESHOLD (1 << 16)
+#define MATERIALS_PER_BLOCK 256
+#define BINDLESS_MATERIAL_BLOCKS 32
+#define MAX_PASSES 63
+#define MAX_TIMING_EVENTS 4096
+#define MAX_TIMING_ZONES 65536
+#define MAX_TIMING_DEPTH 16
+#define MAX_TEXT_LAYOUTS 64
+#define MAX_TEXT_LAYOUT_BYTES (1 << 20)
+
+// Failed checks release the lock before throwing (see unlockAll)
+#undef lovrAssert
+#define lovrAssert(c, ...) if (!(c)) { unlockAll(); lovrThrow(__VA_ARGS__); }
 
 typedef struct {
   gpu_phase readPhase;
@@ -36,6 +58,7 @@ typedef struct {
   gpu_cache pendingReads;
   gpu_cache pendingWrite;
   uint32_t lastWriteIndex;
+  uint32_t lastReadIndex[2];
 } Sync;
 
 struct Buffer {
@@ -52,13 +75,22 @@ struct Buffer {
 struct Texture {
   uint32_t ref;
   uint32_t xrTick;
+  uint32_t baseLevel;
+  uint32_t levelViewCount;
   gpu_texture* gpu;
   gpu_texture* renderView;
+  gpu_texture* levelViews;
   Material* material;
   TextureInfo info;
   Sync sync;
 };
 
+typedef struct {
+  Texture* texture;
+  Image** images;
+  uint32_t imageCount;
+} TextureStream;
+
 struct Sampler {
   uint32_t ref;
   gpu_sampler* gpu;
@@ -128,6 +160,20 @@ typedef struct {
   float box[4];
 } Glyph;
 
+// Text is drawn with one instance per glyph, the vertex shader expands these into quads
+typedef struct {
+  float rect[4];
+  uint16_t uv[4];
+  uint8_t color[4];
+} GlyphQuad;
+
+// A segment of the top edge of the packed area in a font atlas
+typedef struct {
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+} SkylineNode;
+
 struct Font {
   uint32_t ref;
   FontInfo info;
@@ -141,9 +187,10 @@ struct Font {
   Texture* atlas;
   uint32_t atlasWidth;
   uint32_t atlasHeight;
-  uint32_t rowHeight;
-  uint32_t atlasX;
-  uint32_t atlasY;
+  arr_t(SkylineNode) skyline;
+  uint32_t pendingGlyphs;
+  uint64_t cacheKey;
+  uint8_t* pixels;
 };
 
 typedef struct {
@@ -156,6 +203,7 @@ typedef enum {
   VERTEX_SHAPE,
   VERTEX_POINT,
   VERTEX_GLYPH,
+  VERTEX_GLYPH_QUAD,
   VERTEX_MODEL,
   VERTEX_EMPTY,
   VERTEX_FORMAX
@@ -165,6 +213,7 @@ typedef struct {
   uint64_t hash;
   MeshMode mode;
   DefaultShader shader;
+  Shader* internalShader;
   Material* material;
   float* transform;
   struct {
@@ -172,6 +221,7 @@ typedef struct {
     VertexFormat format;
     uint32_t count;
     void** pointer;
+    bool instanced;
   } vertex;
   struct {
     Buffer* buffer;
@@ -200,6 +250,8 @@ struct Model {
   Material** materials;
   NodeTransform* localTransforms;
   float* globalTransforms;
+  float* boundingBoxes;
+  float* nodeBoundingBoxes;
   bool transformsDirty;
   uint32_t lastReskin;
 };
@@ -215,6 +267,7 @@ struct Readback {
   Image* image;
   Blob* blob;
   void* data;
+  bool pending;
 };
 
 struct Tally {
@@ -225,6 +278,34 @@ struct Tally {
   gpu_buffer* buffer;
 };
 
+typedef struct {
+  gpu_pipeline* pipeline;
+  Shader* shader;
+  Material* material;
+  struct {
+    Buffer* buffer;
+    void* data;
+    uint32_t offset;
+    uint32_t size;
+  } vertex, index;
+  gpu_index_type indexType;
+  bool indexed;
+  bool instanced;
+  uint32_t start;
+  uint32_t count;
+  uint32_t instances;
+  uint32_t base;
+  DrawData data;
+} BatchDraw;
+
+struct Batch {
+  uint32_t ref;
+  Pass* pass;
+  uint64_t target;
+  Buffer* buffer;
+  arr_t(BatchDraw) draws;
+};
+
 typedef struct {
   float resolution[2];
   float time;
@@ -239,6 +320,7 @@ typedef struct {
 
 typedef struct {
   bool dirty;
+  bool viewCull;
   MeshMode mode;
   float color[4];
   float viewport[4];
@@ -292,6 +374,37 @@ typedef struct {
   gpu_cache cache;
 } Access;
 
+typedef struct {
+  uint64_t hash;
+  uint32_t start;
+  uint32_t count;
+  uint32_t base;
+  uint32_t id;
+  uint32_t instances;
+  bool indexed;
+} ShapeRun;
+
+typedef struct {
+  uint32_t index;
+  gpu_pipeline* pipeline;
+  Shader* shader;
+  Material* material;
+  gpu_sampler* sampler;
+  gpu_bundle* bundle;
+  void* constants;
+  gpu_buffer* vertexBuffer;
+  gpu_buffer* indexBuffer;
+  gpu_index_type indexType;
+  bool indexed;
+  bool instanced;
+  uint64_t hash;
+  uint32_t start;
+  uint32_t count;
+  uint32_t instances;
+  uint32_t base;
+  DrawData data;
+} DeferredDraw;
+
 struct Pass {
   uint32_t ref;
   uint32_t tick;
@@ -316,11 +429,26 @@ struct Pass {
   DrawData* drawData;
   uint32_t drawCount;
   gpu_binding builtins[4];
+  gpu_bundle* builtinBundle;
+  gpu_buffer* builtinBuffers[2];
+  uint32_t builtinOffsets[2];
+  gpu_pipeline* boundPipeline;
   gpu_buffer* vertexBuffer;
   gpu_buffer* indexBuffer;
   Shape shapeCache[16];
+  ShapeRun run;
+  Batch* batch;
+  bool sorting;
+  bool prewarm;
+  uint32_t bindsSaved;
+  PassStats stats;
+  Shader* deferredShader;
+  gpu_bundle* deferredBundle;
+  void* deferredConstants;
+  arr_t(DeferredDraw) deferred;
   arr_t(Readback*) readbacks;
   arr_t(Access) access;
+  uint32_t timingIndex;
 };
 
 typedef struct {
@@ -359,8 +487,59 @@ typedef struct {
   size_t cursor;
   size_t length;
   size_t limit;
+  uint32_t tick;
 } Allocator;
 
+typedef struct {
+  gpu_pipeline* gpu;
+  gpu_pipeline_info info;
+  Shader* shader;
+} PipelineJob;
+
+typedef struct {
+  uint64_t hash;
+  uint64_t size;
+  void* code;
+} CachedSpirv;
+
+typedef struct {
+  uint64_t key;
+  size_t size;
+  void* data;
+} CachedFont;
+
+typedef struct {
+  uint64_t hash;
+  Font* font;
+  Buffer* quads;
+  uint32_t glyphCount;
+  uint32_t lineCount;
+  uint32_t tick;
+} TextLayout;
+
+typedef struct {
+  Font* font;
+  uint32_t codepoint;
+  uint32_t offset[2];
+  uint32_t extent[2];
+  uint8_t* pixels;
+} GlyphJob;
+
+typedef struct {
+  const char* name;
+  double start;
+  double duration;
+  uint32_t thread;
+  atomic_uint ready;
+} TimingEvent;
+
+typedef struct {
+  uint32_t tick;
+  uint32_t count;
+  double time;
+  char names[MAX_PASSES][32];
+} TimingFrame;
+
 static struct {
   bool initialized;
   bool active;
@@ -370,6 +549,8 @@ static struct {
   gpu_features features;
   gpu_limits limits;
   gpu_stream* stream;
+  gpu_stream* transfer;
+  gpu_stream* readback;
   uint32_t tick;
   bool hasTextureUpload;
   bool hasMaterialUpload;
@@ -385,6 +566,8 @@ static struct {
   Sampler* defaultSamplers[2];
   Shader* animator;
   Shader* timeWizard;
+  Shader* culler;
+  Shader* glyphShader;
   Shader* defaultShaders[DEFAULT_SHADER_COUNT];
   gpu_vertex_format vertexFormats[VERTEX_FORMAX];
   Readback* oldestReadback;
@@ -392,40 +575,127 @@ static struct {
   Material* defaultMaterial;
   size_t materialBlock;
   arr_t(MaterialBlock) materialBlocks;
-  Pass passes[63];
+  Pass passes[MAX_PASSES];
   uint32_t passCount;
   size_t scratchBufferIndex;
   arr_t(Buffer*) scratchBuffers;
   arr_t(gpu_buffer*) scratchBufferHandles;
   arr_t(ScratchTexture) scratchTextures;
+  arr_t(TextureStream) textureStreams;
   map_t pipelineLookup;
   arr_t(gpu_pipeline*) pipelines;
+  map_t spirvLookup;
+  arr_t(CachedSpirv) spirv;
+  map_t fontCacheLookup;
+  arr_t(CachedFont) fontCache;
+  arr_t(Font*) fonts;
+  TextLayout textLayouts[MAX_TEXT_LAYOUTS];
+  size_t textLayoutBytes;
   arr_t(Layout) layouts;
   size_t builtinLayout;
   size_t materialLayout;
+  gpu_bundle_pool* bindlessPool;
+  gpu_bundle* bindlessBundle;
   Allocator allocator;
+  arr_t(Allocator*) allocators;
+  atomic_uint allocatorTick;
+  bool timing;
+  gpu_tally* timingTally;
+  TimingFrame timingFrames[4];
+  TimingEvent timingEvents[MAX_TIMING_EVENTS];
+  atomic_uint timingHead;
+  uint32_t timingTail;
+  atomic_uint timingThreads;
+  atomic_uint timingGeneration;
+  arr_t(TimingZone) timings;
+  arr_t(TimingZone) timingResults;
+#ifndef LOVR_DISABLE_THREAD
+  tss_t allocatorKey;
+  mtx_t lock;
+  mtx_t compileLock;
+  cnd_t compileSignal;
+  cnd_t compileDone;
+  thrd_t compilers[4];
+  uint32_t compilerCount;
+  bool compilerQuit;
+  arr_t(PipelineJob) compileQueue;
+  map_t pendingPipelines;
+  mtx_t glyphLock;
+  cnd_t glyphSignal;
+  cnd_t glyphDone;
+  thrd_t rasterizers[4];
+  uint32_t rasterizerCount;
+  bool rasterizerQuit;
+  arr_t(GlyphJob) glyphQueue;
+  arr_t(GlyphJob) glyphResults;
+#endif
 } state;
 
+static LOVR_THREAD_LOCAL uint32_t lockDepth;
+
+// GPU objects of the Shader being created on this thread, so shader workers can clean them up when
+// creating the Shader throws an error
+static LOVR_THREAD_LOCAL struct {
+  gpu_shader* shader;
+  gpu_pipeline* pipeline;
+  bool profiling;
+} pendingShader;
+
 // Helpers
 
+static Allocator* getAllocator(void);
 static void* tempAlloc(size_t size);
+#ifndef LOVR_DISABLE_THREAD
+static void releaseAllocator(void* arg);
+#endif
 static size_t tempPush(void);
 static void tempPop(size_t stack);
+static void lock(void);
+static void unlock(void);
+static void unlockAll(void);
 static int u64cmp(const void* a, const void* b);
 static void beginFrame(void);
+static gpu_stream* getTransferStream(void);
+static gpu_stream* getReadbackStream(void);
 static void releasePassResources(void);
 static void processReadbacks(void);
+static void uploadGlyphs(void);
+static void recordTiming(void* userdata, const char* name, bool begin);
+static void resolveTimings(void);
 static size_t getLayout(gpu_slot* slots, uint32_t count);
-static gpu_bundle* getBundle(size_t layout);
+static gpu_bundle* getBundle(size_t layout, gpu_binding* bindings, uint32_t count);
+static gpu_bundle* allocateBundle(size_t layout);
 static gpu_texture* getScratchTexture(gpu_texture_info* info);
+static Shader* getBuiltinShader(Shader** slot, ShaderInfo* info);
 static bool isDepthFormat(TextureFormat format);
 static uint32_t measureTexture(TextureFormat format, uint32_t w, uint32_t h, uint32_t d);
 static void checkTextureBounds(const TextureInfo* info, uint32_t offset[4], uint32_t extent[3]);
 static void mipmapTexture(gpu_stream* stream, Texture* texture, uint32_t base, uint32_t count);
+static gpu_texture* getSampleView(Texture* texture);
+static void uploadTextureLevel(Texture* texture, Image** images, uint32_t imageCount, uint32_t level);
+static void setTextureBaseLevel(Texture* texture, uint32_t level);
+static void finishTextureStream(Texture* texture);
+static void streamTextures(void);
+static Material* createMaterial(const MaterialInfo* info);
 static ShaderResource* findShaderResource(Shader* shader, const char* name, size_t length, uint32_t slot);
 static void trackBuffer(Pass* pass, Buffer* buffer, gpu_phase phase, gpu_cache cache);
 static void trackTexture(Pass* pass, Texture* texture, gpu_phase phase, gpu_cache cache);
 static void trackMaterial(Pass* pass, Material* material, gpu_phase phase, gpu_cache cache);
+static void recordReadback(gpu_stream* stream, Readback* readback);
+static void flushReadbacks(Pass* pass);
+static bool isWrittenLater(Pass** passes, uint32_t count, uint32_t index, Readback* readback);
+static uint64_t getTargetHash(Pass* pass);
+static void flushShapeRun(Pass* pass);
+static void flushDeferredDraws(Pass* pass);
+static void loadSpirvCache(void* data, size_t size);
+static void loadFontCache(void* data, size_t size);
+static void loadFont(Font* font, CachedFont* entry);
+static void saveFont(Font* font);
+static void evictTextLayouts(Font* font);
+static bool startPipelineCompilers(void);
+static void queuePipeline(gpu_pipeline* gpu, gpu_pipeline_info* info, Shader* shader);
+static bool isPipelinePending(gpu_pipeline* gpu);
+static void waitForPipeline(gpu_pipeline* gpu);
 static void updateModelTransforms(Model* model, uint32_t nodeIndex, float* parent);
 static void checkShaderFeatures(uint32_t* features, uint32_t count);
 static void onResize(uint32_t width, uint32_t height);
@@ -440,6 +710,8 @@ bool lovrGraphicsInit(GraphicsConfig* config) {
 
   gpu_config gpu = {
     .debug = config->debug,
+    .asyncCompute = config->asyncCompute,
+    .bindless = config->bindless,
     .callback = onMessage,
     .engineName = "LOVR",
     .engineVersion = { LOVR_VERSION_MAJOR, LOVR_VERSION_MINOR, LOVR_VERSION_PATCH },
@@ -483,41 +755,90 @@ bool lovrGraphicsInit(GraphicsConfig* config) {
   state.allocator.limit = 1 << 30;
   state.allocator.memory = os_vm_init(state.allocator.limit);
   os_vm_commit(state.allocator.memory, state.allocator.length);
+  arr_init(&state.allocators, realloc);
+
+#ifndef LOVR_DISABLE_THREAD
+  tss_create(&state.allocatorKey, releaseAllocator);
+  tss_set(state.allocatorKey, &state.allocator);
+  mtx_init(&state.lock, mtx_plain | mtx_recursive);
+  mtx_init(&state.compileLock, mtx_plain);
+  cnd_init(&state.compileSignal);
+  cnd_init(&state.compileDone);
+  arr_init(&state.compileQueue, realloc);
+  map_init(&state.pendingPipelines, 16);
+  mtx_init(&state.glyphLock, mtx_plain);
+  cnd_init(&state.glyphSignal);
+  cnd_init(&state.glyphDone);
+  arr_init(&state.glyphQueue, realloc);
+  arr_init(&state.glyphResults, realloc);
+#endif
 
   map_init(&state.pipelineLookup, 64);
   arr_init(&state.pipelines, realloc);
+  map_init(&state.spirvLookup, 64);
+  arr_init(&state.spirv, realloc);
+  loadSpirvCache(config->spirvCacheData, config->spirvCacheSize);
+  map_init(&state.fontCacheLookup, 4);
+  arr_init(&state.fontCache, realloc);
+  arr_init(&state.fonts, realloc);
+  loadFontCache(config->fontCacheData, config->fontCacheSize);
   arr_init(&state.layouts, realloc);
   arr_init(&state.materialBlocks, realloc);
   arr_init(&state.scratchBuffers, realloc);
   arr_init(&state.scratchBufferHandles, realloc);
   arr_init(&state.scratchTextures, realloc);
+  arr_init(&state.textureStreams, realloc);
+  arr_init(&state.timings, realloc);
+  arr_init(&state.timingResults, realloc);
 
   for (uint32_t i = 0; i < COUNTOF(state.passes); i++) {
     arr_init(&state.passes[i].readbacks, realloc);
     arr_init(&state.passes[i].access, realloc);
+    arr_init(&state.passes[i].deferred, realloc);
   }
 
   gpu_slot builtinSlots[] = {
-    { 0, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_ALL }, // Globals
-    { 1, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_ALL }, // Cameras
-    { 2, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_ALL }, // Draw data
-    { 3, GPU_SLOT_SAMPLER, GPU_STAGE_ALL }, // Default sampler
+    { 0, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_ALL, 0 }, // Globals
+    { 1, GPU_SLOT_UNIFORM_BUFFER_DYNAMIC, GPU_STAGE_ALL, 0 }, // Cameras
+    { 2, GPU_SLOT_UNIFORM_BUFFER_DYNAMIC, GPU_STAGE_ALL, 0 }, // Draw data
+    { 3, GPU_SLOT_SAMPLER, GPU_STAGE_ALL, 0 }, // Default sampler
   };
 
   state.builtinLayout = getLayout(builtinSlots, COUNTOF(builtinSlots));
 
   gpu_slot materialSlots[] = {
-    { 0, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Data
-    { 1, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Color
-    { 2, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Glow
-    { 3, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Occlusion
-    { 4, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Metalness
-    { 5, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Roughness
-    { 6, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT }, // Clearcoat
-    { 7, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT } // Normal
+    { 0, GPU_SLOT_UNIFORM_BUFFER, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Data
+    { 1, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Color
+    { 2, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Glow
+    { 3, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Occlusion
+    { 4, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Metalness
+    { 5, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Roughness
+    { 6, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 }, // Clearcoat
+    { 7, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, 0 } // Normal
   };
 
-  state.materialLayout = getLayout(materialSlots, COUNTOF(materialSlots));
+  // In bindless mode, every Material is in a single bundle that is indexed using the draw data
+  gpu_slot bindlessSlots[] = {
+    { 0, GPU_SLOT_STORAGE_BUFFER, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, BINDLESS_MATERIAL_BLOCKS }, // Data
+    { 1, GPU_SLOT_SAMPLED_TEXTURE, GPU_STAGE_VERTEX | GPU_STAGE_FRAGMENT, BINDLESS_MATERIAL_BLOCKS * MATERIALS_PER_BLOCK * 8 } // Textures
+  };
+
+  if (state.features.bindless) {
+    state.materialLayout = getLayout(bindlessSlots, COUNTOF(bindlessSlots));
+    state.bindlessPool = malloc(gpu_sizeof_bundle_pool());
+    state.bindlessBundle = malloc(gpu_sizeof_bundle());
+    lovrAssert(state.bindlessPool && state.bindlessBundle, "Out of memory");
+
+    gpu_bundle_pool_info poolInfo = {
+      .bundles = state.bindlessBundle,
+      .layout = state.layouts.data[state.materialLayout].gpu,
+      .count = 1
+    };
+
+    gpu_bundle_pool_init(state.bindlessPool, &poolInfo);
+  } else {
+    state.materialLayout = getLayout(materialSlots, COUNTOF(materialSlots));
+  }
 
   float data[] = { 0.f, 0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f };
 
@@ -602,6 +923,21 @@ bool lovrGraphicsInit(GraphicsConfig* config) {
     .attributes[4] = { 1, 14, 0, GPU_TYPE_F32x4 }
   };
 
+  state.vertexFormats[VERTEX_GLYPH_QUAD] = (gpu_vertex_format) {
+    .bufferCount = 2,
+    .attributeCount = 8,
+    .instancedBuffers = 0x1,
+    .bufferStrides[0] = sizeof(GlyphQuad),
+    .attributes[0] = { 0, 0, offsetof(GlyphQuad, rect), GPU_TYPE_F32x4 },
+    .attributes[1] = { 0, 1, offsetof(GlyphQuad, uv), GPU_TYPE_UN16x4 },
+    .attributes[2] = { 0, 2, offsetof(GlyphQuad, color), GPU_TYPE_UN8x4 },
+    .attributes[3] = { 1, 10, 0, GPU_TYPE_F32x4 },
+    .attributes[4] = { 1, 11, 0, GPU_TYPE_F32x4 },
+    .attributes[5] = { 1, 12, 0, GPU_TYPE_F32x4 },
+    .attributes[6] = { 1, 13, 16, GPU_TYPE_F32x4 },
+    .attributes[7] = { 1, 14, 0, GPU_TYPE_F32x4 }
+  };
+
   state.vertexFormats[VERTEX_MODEL] = (gpu_vertex_format) {
     .bufferCount = 2,
     .attributeCount = 5,
@@ -673,24 +1009,75 @@ void lovrGraphicsDestroy() {
   if (lovrHeadsetInterface && lovrHeadsetInterface->stop) {
     lovrHeadsetInterface->stop();
   }
+#endif
+#ifndef LOVR_DISABLE_THREAD
+  // Pipelines that haven't started compiling yet are skipped, they're zeroed so it's okay to destroy them
+  mtx_lock(&state.compileLock);
+  state.compilerQuit = true;
+  cnd_broadcast(&state.compileSignal);
+  mtx_unlock(&state.compileLock);
+  for (uint32_t i = 0; i < state.compilerCount; i++) {
+    thrd_join(state.compilers[i], NULL);
+  }
+  for (size_t i = 0; i < state.compileQueue.length; i++) {
+    lovrRelease(state.compileQueue.data[i].shader, lovrShaderDestroy);
+  }
+  arr_free(&state.compileQueue);
+  map_free(&state.pendingPipelines);
+  mtx_lock(&state.glyphLock);
+  state.rasterizerQuit = true;
+  cnd_broadcast(&state.glyphSignal);
+  mtx_unlock(&state.glyphLock);
+  for (uint32_t i = 0; i < state.rasterizerCount; i++) {
+    thrd_join(state.rasterizers[i], NULL);
+  }
+  for (size_t i = 0; i < state.glyphQueue.length; i++) {
+    lovrRelease(state.glyphQueue.data[i].font, lovrFontDestroy);
+  }
+  for (size_t i = 0; i < state.glyphResults.length; i++) {
+    lovrRelease(state.glyphResults.data[i].font, lovrFontDestroy);
+    free(state.glyphResults.data[i].pixels);
+  }
+  arr_free(&state.glyphQueue);
+  arr_free(&state.glyphResults);
 #endif
   for (Readback* readback = state.oldestReadback; readback; readback = readback->next) {
     lovrRelease(readback, lovrReadbackDestroy);
   }
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    for (uint32_t j = 0; j < stream->imageCount; j++) {
+      lovrRelease(stream->images[j], lovrImageDestroy);
+    }
+    lovrRelease(stream->texture, lovrTextureDestroy);
+    free(stream->images);
+  }
+  arr_free(&state.textureStreams);
+  if (lovrProfileCallback == recordTiming) lovrSetProfileCallback(NULL, NULL);
+  if (state.timingTally) gpu_tally_destroy(state.timingTally);
+  free(state.timingTally);
+  arr_free(&state.timings);
+  arr_free(&state.timingResults);
   releasePassResources();
   for (uint32_t i = 0; i < COUNTOF(state.passes); i++) {
     arr_free(&state.passes[i].readbacks);
     arr_free(&state.passes[i].access);
+    arr_free(&state.passes[i].deferred);
   }
   lovrRelease(state.window, lovrTextureDestroy);
   lovrRelease(state.windowPass, lovrPassDestroy);
   lovrRelease(state.defaultFont, lovrFontDestroy);
   lovrRelease(state.defaultBuffer, lovrBufferDestroy);
+  for (uint32_t i = 0; i < COUNTOF(state.textLayouts); i++) {
+    lovrRelease(state.textLayouts[i].quads, lovrBufferDestroy);
+  }
   lovrRelease(state.defaultTexture, lovrTextureDestroy);
   lovrRelease(state.defaultSamplers[0], lovrSamplerDestroy);
   lovrRelease(state.defaultSamplers[1], lovrSamplerDestroy);
   lovrRelease(state.animator, lovrShaderDestroy);
   lovrRelease(state.timeWizard, lovrShaderDestroy);
+  lovrRelease(state.culler, lovrShaderDestroy);
+  lovrRelease(state.glyphShader, lovrShaderDestroy);
   for (size_t i = 0; i < COUNTOF(state.defaultShaders); i++) {
     lovrRelease(state.defaultShaders[i], lovrShaderDestroy);
   }
@@ -698,13 +1085,16 @@ void lovrGraphicsDestroy() {
   for (size_t i = 0; i < state.materialBlocks.length; i++) {
     MaterialBlock* block = &state.materialBlocks.data[i];
     gpu_buffer_destroy(block->buffer);
-    gpu_bundle_pool_destroy(block->bundlePool);
+    if (block->bundlePool) gpu_bundle_pool_destroy(block->bundlePool);
     free(block->list);
     free(block->buffer);
     free(block->bundlePool);
     free(block->bundles);
   }
   arr_free(&state.materialBlocks);
+  if (state.bindlessPool) gpu_bundle_pool_destroy(state.bindlessPool);
+  free(state.bindlessPool);
+  free(state.bindlessBundle);
   for (size_t i = 0; i < state.scratchBuffers.length; i++) {
     free(state.scratchBuffers.data[i]);
     free(state.scratchBufferHandles.data[i]);
@@ -722,6 +1112,17 @@ void lovrGraphicsDestroy() {
   }
   map_free(&state.pipelineLookup);
   arr_free(&state.pipelines);
+  for (size_t i = 0; i < state.spirv.length; i++) {
+    free(state.spirv.data[i].code);
+  }
+  map_free(&state.spirvLookup);
+  arr_free(&state.spirv);
+  for (size_t i = 0; i < state.fontCache.length; i++) {
+    free(state.fontCache.data[i].data);
+  }
+  map_free(&state.fontCacheLookup);
+  arr_free(&state.fontCache);
+  arr_free(&state.fonts);
   for (size_t i = 0; i < state.layouts.length; i++) {
     BundlePool* pool = state.layouts.data[i].head;
     while (pool) {
@@ -738,7 +1139,24 @@ void lovrGraphicsDestroy() {
   arr_free(&state.layouts);
   gpu_destroy();
   glslang_finalize_process();
+#ifndef LOVR_DISABLE_THREAD
+  tss_delete(state.allocatorKey);
+#endif
   os_vm_free(state.allocator.memory, state.allocator.limit);
+  for (size_t i = 0; i < state.allocators.length; i++) {
+    os_vm_free(state.allocators.data[i]->memory, state.allocators.data[i]->limit);
+    free(state.allocators.data[i]);
+  }
+  arr_free(&state.allocators);
+#ifndef LOVR_DISABLE_THREAD
+  mtx_destroy(&state.lock);
+  mtx_destroy(&state.compileLock);
+  cnd_destroy(&state.compileSignal);
+  cnd_destroy(&state.compileDone);
+  mtx_destroy(&state.glyphLock);
+  cnd_destroy(&state.glyphSignal);
+  cnd_destroy(&state.glyphDone);
+#endif
   memset(&state, 0, sizeof(state));
 }
 
@@ -764,6 +1182,7 @@ void lovrGraphicsGetFeatures(GraphicsFeatures* features) {
   features->float64 = state.features.float64;
   features->int64 = state.features.int64;
   features->int16 = state.features.int16;
+  features->bindless = state.features.bindless;
 }
 
 void lovrGraphicsGetLimits(GraphicsLimits* limits) {
@@ -819,6 +1238,167 @@ void lovrGraphicsGetShaderCache(void* data, size_t* size) {
   gpu_pipeline_get_cache(data, size);
 }
 
+// The SPIR-V cache is a header (magic, LOVR version, entry count, key revision) followed by the
+// entries, each of which is a 16 byte header (hash and size) followed by the SPIR-V words.  The key
+// revision changes whenever the way entries are hashed changes, so old keys never match.
+#define SPIRV_CACHE_MAGIC 0x5650534c
+#define SPIRV_CACHE_VERSION ((LOVR_VERSION_MAJOR << 16) | (LOVR_VERSION_MINOR << 8) | LOVR_VERSION_PATCH)
+#define SPIRV_CACHE_REVISION 1
+
+void lovrGraphicsGetSpirvCache(void* data, size_t* size) {
+  lock();
+
+  size_t total = 16;
+  for (size_t i = 0; i < state.spirv.length; i++) {
+    total += 16 + state.spirv.data[i].size;
+  }
+
+  if (!data) {
+    *size = state.spirv.length > 0 ? total : 0;
+    unlock();
+    return;
+  }
+
+  if (*size < total) {
+    *size = 0;
+    unlock();
+    return;
+  }
+
+  char* p = data;
+  uint32_t header[4] = { SPIRV_CACHE_MAGIC, SPIRV_CACHE_VERSION, (uint32_t) state.spirv.length, SPIRV_CACHE_REVISION };
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+
+  for (size_t i = 0; i < state.spirv.length; i++) {
+    CachedSpirv* entry = &state.spirv.data[i];
+    memcpy(p, &entry->hash, 8);
+    memcpy(p + 8, &entry->size, 8);
+    memcpy(p + 16, entry->code, entry->size);
+    p += 16 + entry->size;
+  }
+
+  *size = total;
+  unlock();
+}
+
+// Invalid or outdated caches are ignored, shaders just get compiled again
+static void loadSpirvCache(void* data, size_t size) {
+  uint32_t header[4];
+
+  if (!data || size < sizeof(header)) {
+    return;
+  }
+
+  memcpy(header, data, sizeof(header));
+
+  if (header[0] != SPIRV_CACHE_MAGIC || header[1] != SPIRV_CACHE_VERSION || header[3] != SPIRV_CACHE_REVISION) {
+    return;
+  }
+
+  char* p = (char*) data + sizeof(header);
+  size_t remaining = size - sizeof(header);
+
+  for (uint32_t i = 0; i < header[2] && remaining >= 16; i++) {
+    CachedSpirv entry;
+    memcpy(&entry.hash, p, 8);
+    memcpy(&entry.size, p + 8, 8);
+
+    if (entry.size > remaining - 16 || entry.size % 4 != 0) {
+      break;
+    }
+
+    entry.code = malloc(entry.size);
+    lovrAssert(entry.code, "Out of memory");
+    memcpy(entry.code, p + 16, entry.size);
+    map_set(&state.spirvLookup, entry.hash, state.spirv.length);
+    arr_push(&state.spirv, entry);
+    p += 16 + entry.size;
+    remaining -= 16 + entry.size;
+  }
+}
+
+uint32_t lovrGraphicsGetPendingPipelineCount(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.compileLock);
+  uint32_t count = state.pendingPipelines.used;
+  mtx_unlock(&state.compileLock);
+  return count;
+#else
+  return 0;
+#endif
+}
+
+void lovrGraphicsGetMemoryStats(GraphicsMemoryStats* stats) {
+  gpu_memory_stats memory;
+  gpu_get_memory_stats(&memory);
+
+  for (uint32_t i = 0; i < MEMORY_USAGE_COUNT; i++) {
+    stats->types[i].allocated = memory.types[i].allocated;
+    stats->types[i].used = memory.types[i].used;
+    stats->types[i].free = memory.types[i].free;
+    stats->types[i].largestFree = memory.types[i].largestFree;
+    stats->types[i].blocks = memory.types[i].blocks;
+    stats->types[i].allocations = memory.types[i].allocations;
+  }
+
+  for (uint32_t i = 0; i < memory.heapCount; i++) {
+    stats->heaps[i].size = memory.heaps[i].size;
+    stats->heaps[i].budget = memory.heaps[i].budget;
+    stats->heaps[i].usage = memory.heaps[i].usage;
+    stats->heaps[i].deviceLocal = memory.heaps[i].deviceLocal;
+  }
+
+  stats->heapCount = memory.heapCount;
+  stats->budget = memory.budget;
+
+  for (uint32_t i = 0; i < COUNTOF(stats->scratchpad); i++) {
+    stats->scratchpad[i] = memory.scratchpad[i];
+  }
+
+  stats->condemned = memory.condemned;
+}
+
+bool lovrGraphicsIsTimingEnabled() {
+  return state.timing;
+}
+
+// While timing is enabled, every pass gets a pair of GPU timestamps and the CPU zones marked with
+// lovrProfileBegin/lovrProfileEnd are recorded.  Results are resolved a few frames later, once the
+// GPU is done with the frame, and are buffered until lovrGraphicsGetTimings is called.
+void lovrGraphicsSetTimingEnabled(bool enable) {
+  if (enable && !state.timingTally) {
+    state.timingTally = calloc(1, gpu_sizeof_tally());
+    lovrAssert(state.timingTally, "Out of memory");
+    gpu_tally_init(state.timingTally, &(gpu_tally_info) {
+      .type = GPU_TALLY_TIME,
+      .count = COUNTOF(state.timingFrames) * MAX_PASSES * 2
+    });
+  }
+
+  if (enable) {
+    state.timingTail = atomic_fetch_add(&state.timingHead, 0);
+    atomic_fetch_add(&state.timingGeneration, 1);
+  }
+
+  state.timing = enable;
+  lovrSetProfileCallback(enable ? recordTiming : NULL, NULL);
+}
+
+// The returned zones are valid until the next call.  CPU zones use the timer from os_get_time.  GPU
+// zones (thread 0) are placed relative to the CPU time when the frame started, since the two clocks
+// aren't synchronized, so only their durations and relative order are exact.
+TimingZone* lovrGraphicsGetTimings(uint32_t* count) {
+  lock();
+  resolveTimings();
+  arr_clear(&state.timingResults);
+  arr_append(&state.timingResults, state.timings.data, state.timings.length);
+  arr_clear(&state.timings);
+  *count = (uint32_t) state.timingResults.length;
+  unlock();
+  return state.timingResults.data;
+}
+
 void lovrGraphicsGetBackgroundColor(float background[4]) {
   background[0] = lovrMathLinearToGamma(state.background[0]);
   background[1] = lovrMathLinearToGamma(state.background[1]);
@@ -834,7 +1414,10 @@ void lovrGraphicsSetBackgroundColor(float background[4]) {
 }
 
 void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
+  lovrProfileBegin("submit");
   beginFrame();
+  streamTextures();
+  uploadGlyphs();
 
   uint32_t total = count + 1;
   gpu_stream** streams = tempAlloc(total * sizeof(gpu_stream*));
@@ -882,6 +1465,7 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
   for (uint32_t i = 0; i < count; i++) {
     Pass* pass = passes[i];
     lovrAssert(passes[i]->tick == state.tick, "Trying to submit a Pass that wasn't recorded this frame");
+    lovrCheck(!pass->batch, "Trying to submit a Pass that is still recording a Batch (missing Pass:endBatch?)");
 
     for (uint32_t j = 0; j < i; j++) {
       lovrCheck(passes[j] != passes[i], "Using a Pass twice in the same submit is not allowed");
@@ -893,6 +1477,8 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
 
     switch (pass->info.type) {
       case PASS_RENDER:
+        flushDeferredDraws(pass);
+        flushShapeRun(pass);
         gpu_render_end(pass->stream);
 
         Canvas* canvas = &pass->info.canvas;
@@ -909,6 +1495,7 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
           };
 
           gpu_sync(pass->stream, &barrier, 1);
+          pass->stats.barriers++;
 
           for (uint32_t t = 0; t < canvas->count; t++) {
             if (canvas->textures[t]->info.mipmaps > 1) {
@@ -928,6 +1515,14 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
         for (uint32_t j = 0; j < pass->readbacks.length; j++) {
           Readback* readback = pass->readbacks.data[j];
 
+          // Readbacks are copied on the transfer queue after all of the passes, unless a later pass
+          // changes the data, then they happen at the end of their pass
+          if (readback->pending) {
+            bool later = isWrittenLater(passes, count, i, readback);
+            gpu_stream* stream = later ? pass->stream : getReadbackStream();
+            recordReadback(stream ? stream : pass->stream, readback);
+          }
+
           if (!state.oldestReadback) {
             state.oldestReadback = readback;
           }
@@ -941,11 +1536,27 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
         }
         break;
     }
+
+    if (pass->timingIndex != ~0u) {
+      uint32_t frameIndex = state.tick % COUNTOF(state.timingFrames);
+      gpu_tally_mark(pass->stream, state.timingTally, (frameIndex * MAX_PASSES + pass->timingIndex) * 2 + 1);
+    }
   }
 
   // Synchronization
+  // waits[i] is 1 + the index of the stream on the other queue that stream i has to wait for
+  uint32_t* waits = tempAlloc(total * sizeof(uint32_t));
+  memset(waits, 0, total * sizeof(uint32_t));
+
   for (uint32_t i = 0; i < count; i++) {
     Pass* pass = passes[i];
+    bool async = pass->info.async;
+
+    // Async passes always wait for the internal stream, which also orders them after uploads and
+    // everything from previous frames
+    if (async) {
+      waits[i + 1] = 1;
+    }
 
     for (size_t j = 0; j < pass->access.length; j++) {
       // access is the incoming resource access performed by the pass
@@ -986,6 +1597,46 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
 
       uint32_t read = access->cache & GPU_CACHE_READ_MASK;
       uint32_t write = access->cache & GPU_CACHE_WRITE_MASK;
+
+      // Hazards with passes on the other queue are resolved by making the queue submission wait on
+      // a semaphore.  Hazards with earlier passes on the same queue still use barriers.
+      uint32_t writer = sync->lastWriteIndex;
+      bool crossWrite = async != (writer > 0 && passes[writer - 1]->info.async);
+      uint32_t crossRead = write ? sync->lastReadIndex[!async] : 0;
+
+      if (crossWrite || crossRead) {
+        waits[i + 1] = MAX(waits[i + 1], crossWrite ? writer + 1 : 0);
+        waits[i + 1] = MAX(waits[i + 1], crossRead ? crossRead + 1 : 0);
+
+        if (write) {
+          uint32_t reader = sync->lastReadIndex[async];
+
+          if (reader > 0 && reader < i + 1) {
+            barriers[reader].prev |= sync->readPhase;
+            barriers[reader].next |= access->phase;
+          }
+
+          if (!crossWrite && sync->pendingWrite) {
+            barrier->prev |= sync->writePhase;
+            barrier->next |= access->phase;
+            barrier->flush |= sync->pendingWrite;
+            barrier->clear |= write;
+          }
+
+          sync->readPhase = 0;
+          sync->pendingReads = 0;
+          sync->writePhase = access->phase;
+          sync->pendingWrite = write;
+          sync->lastWriteIndex = i + 1;
+          sync->lastReadIndex[0] = 0;
+          sync->lastReadIndex[1] = 0;
+        } else {
+          sync->lastReadIndex[async] = i + 1;
+        }
+
+        continue;
+      }
+
       uint32_t newReads = read & ~sync->pendingReads;
       bool hasNewReads = newReads || (access->phase & ~sync->readPhase);
       bool readAfterWrite = read && sync->pendingWrite && hasNewReads;
@@ -1015,10 +1666,16 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
         sync->pendingReads = 0;
       }
 
+      if (read) {
+        sync->lastReadIndex[async] = i + 1;
+      }
+
       if (write) {
         sync->writePhase = access->phase;
         sync->pendingWrite = write;
         sync->lastWriteIndex = i + 1;
+        sync->lastReadIndex[0] = 0;
+        sync->lastReadIndex[1] = 0;
       }
     }
 
@@ -1041,12 +1698,51 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
   }
 
   for (uint32_t i = 0; i < count; i++) {
+    // Streams on the async compute queue can only synchronize compute-friendly stages and caches
+    if (i > 0 && passes[i - 1]->info.async) {
+      barriers[i].prev &= GPU_PHASE_INDIRECT | GPU_PHASE_SHADER_COMPUTE | GPU_PHASE_TRANSFER | GPU_PHASE_ALL;
+      barriers[i].next &= GPU_PHASE_INDIRECT | GPU_PHASE_SHADER_COMPUTE | GPU_PHASE_TRANSFER | GPU_PHASE_ALL;
+      barriers[i].flush &= GPU_CACHE_STORAGE_WRITE | GPU_CACHE_TRANSFER_WRITE;
+      barriers[i].clear &= GPU_CACHE_INDIRECT | GPU_CACHE_UNIFORM | GPU_CACHE_TEXTURE | GPU_CACHE_STORAGE_READ | GPU_CACHE_STORAGE_WRITE | GPU_CACHE_TRANSFER_READ | GPU_CACHE_TRANSFER_WRITE;
+    }
+
     gpu_sync(streams[i], &barriers[i], 1);
+
+    if (i > 0 && barriers[i].prev && barriers[i].next) {
+      passes[i - 1]->stats.barriers++;
+    }
+  }
+
+  // Split the streams into a batch for each run of streams on the same queue.  A run is also split
+  // when one of its streams needs to wait for more work on the other queue than the batch does.
+  gpu_batch* batches = tempAlloc(total * sizeof(gpu_batch));
+  uint32_t* batchIndex = tempAlloc(total * sizeof(uint32_t));
+  uint32_t batchCount = 0;
+  uint32_t lastMainStream = 0;
+
+  for (uint32_t i = 0; i < total; i++) {
+    bool async = i > 0 && passes[i - 1]->info.async;
+    uint32_t wait = waits[i] ? batchIndex[waits[i] - 1] + 1 : 0;
+    gpu_batch* batch = batchCount > 0 ? &batches[batchCount - 1] : NULL;
+
+    if (!batch || batch->compute != async || wait > batch->wait) {
+      batch = &batches[batchCount++];
+      batch->streams = &streams[i];
+      batch->count = 0;
+      batch->wait = wait;
+      batch->compute = async;
+    }
+
+    batch->count++;
+    batchIndex[i] = batchCount - 1;
+    lastMainStream = async ? lastMainStream : i;
   }
 
   for (uint32_t i = 0; i < count; i++) {
     for (uint32_t j = 0; j < passes[i]->access.length; j++) {
       passes[i]->access.data[j].sync->lastWriteIndex = 0;
+      passes[i]->access.data[j].sync->lastReadIndex[0] = 0;
+      passes[i]->access.data[j].sync->lastReadIndex[1] = 0;
 
       // OpenXR swapchain texture layout transitions >__>
 
@@ -1054,7 +1750,7 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
 
       if (texture && texture->info.xr && texture->xrTick != state.tick) {
         gpu_xr_acquire(streams[0], texture->gpu);
-        gpu_xr_release(streams[total - 1], texture->gpu);
+        gpu_xr_release(streams[lastMainStream], texture->gpu);
         texture->xrTick = state.tick;
       }
     }
@@ -1064,11 +1760,22 @@ void lovrGraphicsSubmit(Pass** passes, uint32_t count) {
     gpu_stream_end(streams[i]);
   }
 
-  gpu_submit(streams, total);
+  if (state.transfer) {
+    gpu_stream_end(state.transfer);
+  }
+
+  if (state.readback) {
+    gpu_stream_end(state.readback);
+  }
+
+  gpu_submit(batches, batchCount);
 
   state.stream = NULL;
+  state.transfer = NULL;
+  state.readback = NULL;
   state.active = false;
   releasePassResources();
+  lovrProfileEnd("submit");
 }
 
 void lovrGraphicsPresent() {
@@ -1092,6 +1799,7 @@ Buffer* lovrGraphicsGetBuffer(BufferInfo* info, void** data) {
   lovrCheck(size <= 1 << 30, "Max buffer size is 1GB");
   const uint32_t BUFFERS_PER_CHUNK = 64;
 
+  lock();
   if (state.scratchBufferIndex >= state.scratchBuffers.length * BUFFERS_PER_CHUNK) {
     Buffer* buffers = malloc(BUFFERS_PER_CHUNK * sizeof(Buffer));
     gpu_buffer* handles = malloc(BUFFERS_PER_CHUNK * gpu_sizeof_buffer());
@@ -1107,6 +1815,7 @@ Buffer* lovrGraphicsGetBuffer(BufferInfo* info, void** data) {
 
   size_t index = state.scratchBufferIndex++;
   Buffer* buffer = &state.scratchBuffers.data[index / BUFFERS_PER_CHUNK][index % BUFFERS_PER_CHUNK];
+  unlock();
 
   buffer->ref = 1;
   buffer->size = size;
@@ -1147,7 +1856,13 @@ Buffer* lovrBufferCreate(const BufferInfo* info, void** data) {
     beginFrame();
     gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
     *data = gpu_map(scratchpad, size, 4, GPU_MAP_STAGING);
-    gpu_copy_buffers(state.stream, scratchpad, buffer->gpu, 0, 0, size);
+    gpu_stream* transfer = size >= TRANSFER_QUEUE_THRESHOLD ? getTransferStream() : NULL;
+    if (transfer) {
+      gpu_copy_buffers(transfer, scratchpad, buffer->gpu, 0, 0, size);
+      gpu_handoff_buffer(transfer, state.stream, buffer->gpu);
+    } else {
+      gpu_copy_buffers(state.stream, scratchpad, buffer->gpu, 0, 0, size);
+    }
     buffer->sync.writePhase = GPU_PHASE_TRANSFER;
     buffer->sync.pendingWrite = GPU_CACHE_TRANSFER_WRITE;
   }
@@ -1218,6 +1933,16 @@ Texture* lovrTextureCreate(const TextureInfo* info) {
   uint32_t mipmaps = CLAMP(info->mipmaps, 1, mipmapCap);
   uint8_t supports = state.features.formats[info->format];
 
+  // Streaming only kicks in when the Image has a full mipmap chain to upload progressively.
+  // Otherwise, the upload happens right away.  Only sample-only textures can stream, since they're
+  // the only ones that passes never write to, copy, or read back while levels are missing.
+  bool streaming = info->stream &&
+    info->usage == TEXTURE_SAMPLE &&
+    info->imageCount > 0 &&
+    info->type != TEXTURE_3D &&
+    mipmaps > 1 &&
+    lovrImageGetLevelCount(info->images[0]) == mipmaps;
+
   lovrCheck(info->width > 0, "Texture width must be greater than zero");
   lovrCheck(info->height > 0, "Texture height must be greater than zero");
   lovrCheck(info->layers > 0, "Texture layer count must be greater than zero");
@@ -1243,6 +1968,38 @@ Texture* lovrTextureCreate(const TextureInfo* info) {
   lovrCheck((info->format < FORMAT_BC1 || info->format > FORMAT_BC7) || state.features.textureBC, "%s textures are not supported on this GPU", "BC");
   lovrCheck(info->format < FORMAT_ASTC_4x4 || state.features.textureASTC, "%s textures are not supported on this GPU", "ASTC");
 
+  uint32_t levelCount = 0;
+  uint32_t levelSizes[16];
+
+  // All levels are validated here, since streamed levels get uploaded later when errors can't be thrown
+  if (info->imageCount > 0) {
+    levelCount = lovrImageGetLevelCount(info->images[0]);
+    lovrCheck(info->type != TEXTURE_3D || levelCount == 1, "Images used to initialize 3D textures can not have mipmaps");
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+      uint32_t width = MAX(info->width >> level, 1);
+      uint32_t height = MAX(info->height >> level, 1);
+      levelSizes[level] = measureTexture(info->format, width, height, info->layers);
+
+      for (uint32_t layer = 0; layer < info->layers; layer++) {
+        Image* image = info->imageCount == 1 ? info->images[0] : info->images[layer];
+        size_t size = lovrImageGetLayerSize(image, level);
+        lovrCheck(size == levelSizes[level] / info->layers, "Texture/Image size mismatch!");
+      }
+    }
+  }
+
+  // Streaming textures only upload their small mipmaps up front, so the texture is usable right
+  // away.  The rest of the levels are uploaded over the next few frames by streamTextures.
+  uint32_t levelIndex = 0;
+
+  if (streaming) {
+    levelIndex = mipmaps - 1;
+    while (levelIndex > 0 && MAX(info->width >> (levelIndex - 1), info->height >> (levelIndex - 1)) <= 256) {
+      levelIndex--;
+    }
+  }
+
   Texture* texture = calloc(1, sizeof(Texture) + gpu_sizeof_texture());
   lovrAssert(texture, "Out of memory");
   texture->ref = 1;
@@ -1250,35 +2007,28 @@ Texture* lovrTextureCreate(const TextureInfo* info) {
   texture->info = *info;
   texture->info.mipmaps = mipmaps;
 
-  uint32_t levelCount = 0;
   uint32_t levelOffsets[16];
-  uint32_t levelSizes[16];
   gpu_buffer* scratchpad = NULL;
+  gpu_stream* transfer = NULL;
 
   beginFrame();
 
-  if (info->imageCount > 0) {
-    levelCount = lovrImageGetLevelCount(info->images[0]);
-    lovrCheck(info->type != TEXTURE_3D || levelCount == 1, "Images used to initialize 3D textures can not have mipmaps");
-
+  if (levelCount > 0) {
     uint32_t total = 0;
-    for (uint32_t level = 0; level < levelCount; level++) {
-      levelOffsets[level] = total;
-      uint32_t width = MAX(info->width >> level, 1);
-      uint32_t height = MAX(info->height >> level, 1);
-      levelSizes[level] = measureTexture(info->format, width, height, info->layers);
+    for (uint32_t level = levelIndex; level < levelCount; level++) {
+      levelOffsets[level - levelIndex] = total;
       total += levelSizes[level];
     }
 
     scratchpad = tempAlloc(gpu_sizeof_buffer());
     char* data = gpu_map(scratchpad, total, 64, GPU_MAP_STAGING);
+    transfer = total >= TRANSFER_QUEUE_THRESHOLD && state.device.transferImages ? getTransferStream() : NULL;
 
-    for (uint32_t level = 0; level < levelCount; level++) {
+    for (uint32_t level = levelIndex; level < levelCount; level++) {
       for (uint32_t layer = 0; layer < info->layers; layer++) {
         Image* image = info->imageCount == 1 ? info->images[0] : info->images[layer];
         uint32_t slice = info->imageCount == 1 ? layer : 0;
         size_t size = lovrImageGetLayerSize(image, level);
-        lovrCheck(size == levelSizes[level] / info->layers, "Texture/Image size mismatch!");
         void* pixels = lovrImageGetLayerData(image, level, slice);
         memcpy(data, pixels, size);
         data += size;
@@ -1303,8 +2053,10 @@ Texture* lovrTextureCreate(const TextureInfo* info) {
     .label = info->label,
     .upload = {
       .stream = state.stream,
+      .transfer = transfer,
       .buffer = scratchpad,
-      .levelCount = levelCount,
+      .levelIndex = levelIndex,
+      .levelCount = levelCount - levelIndex,
       .levelOffsets = levelOffsets,
       .generateMipmaps = levelCount > 0 && levelCount < mipmaps
     }
@@ -1328,6 +2080,44 @@ Texture* lovrTextureCreate(const TextureInfo* info) {
     }
   }
 
+  // Until the big mipmaps arrive, the texture is sampled through a view that starts at the lowest
+  // uploaded level.  Old views stay alive with the texture, since earlier frames may still use them.
+  if (levelIndex > 0) {
+    texture->levelViews = malloc(levelIndex * gpu_sizeof_texture());
+    lovrAssert(texture->levelViews, "Out of memory");
+
+    for (uint32_t i = 0; i < levelIndex; i++) {
+      gpu_texture* view = (gpu_texture*) ((char*) texture->levelViews + i * gpu_sizeof_texture());
+      lovrAssert(gpu_texture_init_view(view, &(gpu_texture_view_info) {
+        .source = texture->gpu,
+        .type = (gpu_texture_type) info->type,
+        .layerCount = info->layers,
+        .levelIndex = i + 1
+      }), "Failed to create texture view");
+      texture->levelViewCount++;
+    }
+
+    texture->baseLevel = levelIndex;
+
+    TextureStream stream = {
+      .texture = texture,
+      .images = malloc(info->imageCount * sizeof(Image*)),
+      .imageCount = info->imageCount
+    };
+
+    lovrAssert(stream.images, "Out of memory");
+
+    for (uint32_t i = 0; i < info->imageCount; i++) {
+      stream.images[i] = info->images[i];
+      lovrRetain(info->images[i]);
+    }
+
+    lovrRetain(texture);
+    lock();
+    arr_push(&state.textureStreams, stream);
+    unlock();
+  }
+
   // Sample-only textures are exempt from sync tracking to reduce overhead.  Instead, they are
   // manually synchronized with a single barrier after the upload stream.
   if (info->usage == TEXTURE_SAMPLE) {
@@ -1352,6 +2142,9 @@ Texture* lovrTextureCreateView(const TextureViewInfo* view) {
   lovrCheck(view->levelCount == 1 || info->type != TEXTURE_3D, "Views of volume textures may only have a single mipmap level");
   lovrCheck(view->layerCount == 6 || view->type != TEXTURE_CUBE, "Cubemaps can only have a six layers");
 
+  // Views see all of the levels, so they need them uploaded
+  finishTextureStream(view->parent);
+
   Texture* texture = calloc(1, sizeof(Texture) + gpu_sizeof_texture());
   lovrAssert(texture, "Out of memory");
   texture->ref = 1;
@@ -1387,8 +2180,12 @@ void lovrTextureDestroy(void* ref) {
     lovrRelease(texture->material, lovrMaterialDestroy);
     lovrRelease(texture->info.parent, lovrTextureDestroy);
     if (texture->renderView && texture->renderView != texture->gpu) gpu_texture_destroy(texture->renderView);
+    for (uint32_t i = 0; i < texture->levelViewCount; i++) {
+      gpu_texture_destroy((gpu_texture*) ((char*) texture->levelViews + i * gpu_sizeof_texture()));
+    }
     if (texture->gpu) gpu_texture_destroy(texture->gpu);
   }
+  free(texture->levelViews);
   free(texture);
 }
 
@@ -1398,12 +2195,23 @@ const TextureInfo* lovrTextureGetInfo(Texture* texture) {
 
 static Material* lovrTextureGetMaterial(Texture* texture) {
   if (!texture->material) {
-    texture->material = lovrMaterialCreate(&(MaterialInfo) {
+    Material* material = createMaterial(&(MaterialInfo) {
       .data.color = { 1.f, 1.f, 1.f, 1.f },
       .data.uvScale = { 1.f, 1.f },
       .texture = texture
     });
 
+    // Another thread may have created the automaterial in the meantime
+    lock();
+    if (texture->material) {
+      unlock();
+      lovrRelease(material, lovrMaterialDestroy);
+      return texture->material;
+    }
+
+    texture->material = material;
+    unlock();
+
     // Since the Material refcounts the Texture, this creates a cycle.  Release the texture to make
     // sure this is a weak relationship (the automaterial does not keep the texture refcounted).
     lovrRelease(texture, lovrTextureDestroy);
@@ -1482,8 +2290,11 @@ ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source)
     "#extension GL_EXT_multiview : require\n"
     "#extension GL_GOOGLE_include_directive : require\n";
 
+  const char* defines = state.features.bindless ? "#define LOVR_BINDLESS\n" : "";
+
   const char* strings[] = {
     prefix,
+    defines,
     (const char*) etc_shaders_lovr_glsl,
     "#line 1\n",
     source->code
@@ -1491,7 +2302,31 @@ ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source)
 
   lovrCheck(source->size <= INT_MAX, "Shader is way too big");
 
+  // Compiled shaders are cached by their stage, prelude, and source
+  uint64_t keys[] = {
+    stage,
+    state.features.bindless,
+    hash64(etc_shaders_lovr_glsl, etc_shaders_lovr_glsl_len),
+    hash64(source->code, source->size)
+  };
+
+  uint64_t hash = hash64(keys, sizeof(keys));
+
+  lock();
+  uint64_t index = map_get(&state.spirvLookup, hash);
+  if (index != MAP_NIL) {
+    CachedSpirv* entry = &state.spirv.data[index];
+    void* data = malloc(entry->size);
+    lovrAssert(data, "Out of memory");
+    memcpy(data, entry->code, entry->size);
+    size_t size = entry->size;
+    unlock();
+    return (ShaderSource) { data, size };
+  }
+  unlock();
+
   int lengths[] = {
+    -1,
     -1,
     etc_shaders_lovr_glsl_len,
     -1,
@@ -1522,22 +2357,34 @@ ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source)
 
   glslang_shader_set_options(shader, options);
 
+  glslang_program_t* program = NULL;
+  const char* failure = NULL;
+  const char* log = NULL;
+
   if (!glslang_shader_preprocess(shader, &input)) {
-    lovrThrow("Could not preprocess %s shader:\n%s", stageNames[stage], glslang_shader_get_info_log(shader));
-    return (ShaderSource) { NULL, 0 };
+    failure = "preprocess";
+    log = glslang_shader_get_info_log(shader);
+  } else if (!glslang_shader_parse(shader, &input)) {
+    failure = "parse";
+    log = glslang_shader_get_info_log(shader);
+  } else {
+    program = glslang_program_create();
+    glslang_program_add_shader(program, shader);
+
+    if (!glslang_program_link(program, 0)) {
+      failure = "link";
+      log = glslang_program_get_info_log(program);
+    }
   }
 
-  if (!glslang_shader_parse(shader, &input)) {
-    lovrThrow("Could not parse %s shader:\n%s", stageNames[stage], glslang_shader_get_info_log(shader));
-    return (ShaderSource) { NULL, 0 };
-  }
-
-  glslang_program_t* program = glslang_program_create();
-  glslang_program_add_shader(program, shader);
-
-  if (!glslang_program_link(program, 0)) {
-    lovrThrow("Could not link shader:\n%s", glslang_program_get_info_log(program));
-    return (ShaderSource) { NULL, 0 };
+  // The log is copied so the glslang objects can be deleted before throwing
+  if (failure) {
+    size_t length = strlen(log);
+    char* message = tempAlloc(length + 1);
+    memcpy(message, log, length + 1);
+    if (program) glslang_program_delete(program);
+    glslang_shader_delete(shader);
+    lovrThrow("Could not %s %s shader:\n%s", failure, stageNames[stage], message);
   }
 
   glslang_program_SPIRV_generate(program, stages[stage]);
@@ -1546,11 +2393,29 @@ ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source)
   size_t size = glslang_program_SPIRV_get_size(program) * 4;
 
   void* data = malloc(size);
-  lovrAssert(data, "Out of memory");
-  memcpy(data, words, size);
+  if (data) memcpy(data, words, size);
 
   glslang_program_delete(program);
   glslang_shader_delete(shader);
+  lovrAssert(data, "Out of memory");
+
+  CachedSpirv entry = { hash, size, malloc(size) };
+
+  if (!entry.code) {
+    free(data);
+    lovrThrow("Out of memory");
+  }
+
+  memcpy(entry.code, data, size);
+
+  lock();
+  if (map_get(&state.spirvLookup, hash) == MAP_NIL) {
+    map_set(&state.spirvLookup, hash, state.spirv.length);
+    arr_push(&state.spirv, entry);
+  } else {
+    free(entry.code);
+  }
+  unlock();
 
   return (ShaderSource) { data, size };
 #else
@@ -1559,6 +2424,155 @@ ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source)
 #endif
 }
 
+static void freeShaderSources(const ShaderInfo* info, ShaderSource sources[2]) {
+  for (uint32_t i = 0; i < 2; i++) {
+    if (sources[i].code && sources[i].code != info->source[i].code) {
+      free((void*) sources[i].code);
+    }
+
+    sources[i] = (ShaderSource) { NULL, 0 };
+  }
+}
+
+// The compiled code is kept in sources until the Shader is created, so it can be freed if it fails
+static Shader* compileShader(const ShaderInfo* info, ShaderSource sources[2]) {
+  ShaderInfo compiled = *info;
+  uint32_t stageCount = info->type == SHADER_GRAPHICS ? 2 : 1;
+  ShaderStage stages[2] = { info->type == SHADER_GRAPHICS ? STAGE_VERTEX : STAGE_COMPUTE, STAGE_FRAGMENT };
+
+  for (uint32_t i = 0; i < stageCount; i++) {
+    sources[i] = lovrGraphicsCompileShader(stages[i], (ShaderSource*) &info->source[i]);
+    compiled.source[i] = sources[i];
+  }
+
+  Shader* shader = lovrShaderCreate(&compiled);
+  freeShaderSources(info, sources);
+  return shader;
+}
+
+#ifndef LOVR_DISABLE_THREAD
+typedef struct {
+  const ShaderInfo* infos;
+  Shader** shaders;
+  uint32_t count;
+  atomic_uint next;
+  mtx_t lock;
+  uint32_t failed;
+  char error[1024];
+} ShaderBatch;
+
+typedef struct {
+  ShaderBatch* batch;
+  jmp_buf env;
+  ShaderSource sources[2];
+  char error[1024];
+} ShaderWorker;
+
+// Destroys the GPU objects of a Shader that failed partway through being created
+static void abortShader(void) {
+  if (pendingShader.profiling) {
+    lovrProfileEnd("pipeline");
+  }
+
+  if (pendingShader.shader) {
+    gpu_shader_destroy(pendingShader.shader);
+  }
+
+  free(pendingShader.pipeline);
+  memset(&pendingShader, 0, sizeof(pendingShader));
+}
+
+// Errors jump back to the worker loop.  The lock is released first, so a worker never exits holding it.
+static void onShaderError(void* userdata, const char* format, va_list args) {
+  ShaderWorker* worker = userdata;
+  vsnprintf(worker->error, sizeof(worker->error), format, args);
+  unlockAll();
+  longjmp(worker->env, 1);
+}
+
+// Compiles Shaders until the batch runs out.  Errors are returned through the batch instead of being
+// thrown, only the first one is kept since it gets rethrown on the main thread.
+static int shaderCompiler(void* arg) {
+  ShaderWorker worker = { .batch = arg };
+  ShaderBatch* batch = worker.batch;
+  lovrSetErrorCallback(onShaderError, &worker);
+
+  for (;;) {
+    uint32_t index = atomic_fetch_add(&batch->next, 1);
+
+    if (index >= batch->count) {
+      break;
+    }
+
+    if (setjmp(worker.env)) {
+      abortShader();
+      freeShaderSources(&batch->infos[index], worker.sources);
+      mtx_lock(&batch->lock);
+      if (index < batch->failed) {
+        batch->failed = index;
+        memcpy(batch->error, worker.error, sizeof(batch->error));
+      }
+      mtx_unlock(&batch->lock);
+      continue;
+    }
+
+    batch->shaders[index] = compileShader(&batch->infos[index], worker.sources);
+  }
+
+  lovrSetErrorCallback(NULL, NULL);
+  releaseAllocator(tss_get(state.allocatorKey));
+  tss_set(state.allocatorKey, NULL);
+  return 0;
+}
+#endif
+
+// Compiles GLSL and creates Shaders on a set of worker threads.  If any of the Shaders fail, the
+// others are released and the first error is thrown.
+void lovrGraphicsCompileShaders(const ShaderInfo* infos, Shader** shaders, uint32_t count) {
+  memset(shaders, 0, count * sizeof(Shader*));
+
+#ifndef LOVR_DISABLE_THREAD
+  ShaderBatch batch = { .infos = infos, .shaders = shaders, .count = count, .failed = ~0u };
+  mtx_init(&batch.lock, mtx_plain);
+
+  thrd_t threads[16];
+  uint32_t threadCount = MIN(os_get_core_count(), COUNTOF(threads));
+  threadCount = MIN(threadCount, count);
+  uint32_t started = 0;
+
+  for (uint32_t i = 0; i < threadCount; i++) {
+    if (thrd_create(&threads[started], shaderCompiler, &batch) == thrd_success) {
+      started++;
+    }
+  }
+
+  for (uint32_t i = 0; i < started; i++) {
+    thrd_join(threads[i], NULL);
+  }
+
+  mtx_destroy(&batch.lock);
+
+  if (batch.failed != ~0u) {
+    for (uint32_t i = 0; i < count; i++) {
+      lovrRelease(shaders[i], lovrShaderDestroy);
+      shaders[i] = NULL;
+    }
+
+    lovrThrow("Could not create Shader #%d: %s", batch.failed + 1, batch.error);
+  }
+
+  // If no threads could be started, fall through and compile everything on this thread
+  if (started > 0) {
+    return;
+  }
+#endif
+
+  for (uint32_t i = 0; i < count; i++) {
+    ShaderSource sources[2] = { 0 };
+    shaders[i] = compileShader(&infos[i], sources);
+  }
+}
+
 static void lovrShaderInit(Shader* shader) {
 
   // Shaders store the full list of their flags so clones can override them, but they are reordered
@@ -1595,9 +2609,17 @@ static void lovrShaderInit(Shader* shader) {
 
     gpu_pipeline* pipeline = malloc(gpu_sizeof_pipeline());
     lovrAssert(pipeline, "Out of memory");
+    pendingShader.pipeline = pipeline;
+    pendingShader.profiling = true;
+    lovrProfileBegin("pipeline");
     gpu_pipeline_init_compute(pipeline, &pipelineInfo);
+    lovrProfileEnd("pipeline");
+    pendingShader.profiling = false;
+    lock();
     shader->computePipelineIndex = state.pipelines.length;
     arr_push(&state.pipelines, pipeline);
+    unlock();
+    pendingShader.pipeline = NULL;
   }
 }
 
@@ -1645,6 +2667,49 @@ ShaderSource lovrGraphicsGetDefaultShaderSource(DefaultShader type, ShaderStage
     }
   };
 
+  const ShaderSource bindlessSources[][2] = {
+    [SHADER_UNLIT] = {
+      { lovr_shader_unlit_vert_bindless, sizeof(lovr_shader_unlit_vert_bindless) },
+      { lovr_shader_unlit_frag_bindless, sizeof(lovr_shader_unlit_frag_bindless) }
+    },
+    [SHADER_NORMAL] = {
+      { lovr_shader_unlit_vert_bindless, sizeof(lovr_shader_unlit_vert_bindless) },
+      { lovr_shader_normal_frag_bindless, sizeof(lovr_shader_normal_frag_bindless) }
+    },
+    [SHADER_FONT] = {
+      { lovr_shader_unlit_vert_bindless, sizeof(lovr_shader_unlit_vert_bindless) },
+      { lovr_shader_font_frag_bindless, sizeof(lovr_shader_font_frag_bindless) }
+    },
+    [SHADER_CUBEMAP] = {
+      { lovr_shader_cubemap_vert_bindless, sizeof(lovr_shader_cubemap_vert_bindless) },
+      { lovr_shader_cubemap_frag_bindless, sizeof(lovr_shader_cubemap_frag_bindless) }
+    },
+    [SHADER_EQUIRECT] = {
+      { lovr_shader_cubemap_vert_bindless, sizeof(lovr_shader_cubemap_vert_bindless) },
+      { lovr_shader_equirect_frag_bindless, sizeof(lovr_shader_equirect_frag_bindless) }
+    },
+    [SHADER_FILL] = {
+      { lovr_shader_fill_vert_bindless, sizeof(lovr_shader_fill_vert_bindless) },
+      { lovr_shader_unlit_frag_bindless, sizeof(lovr_shader_unlit_frag_bindless) }
+    },
+    [SHADER_FILL_ARRAY] = {
+      { lovr_shader_fill_vert_bindless, sizeof(lovr_shader_fill_vert_bindless) },
+      { lovr_shader_fill_array_frag_bindless, sizeof(lovr_shader_fill_array_frag_bindless) }
+    },
+    [SHADER_FILL_LAYER] = {
+      { lovr_shader_fill_vert_bindless, sizeof(lovr_shader_fill_vert_bindless) },
+      { lovr_shader_fill_layer_frag_bindless, sizeof(lovr_shader_fill_layer_frag_bindless) }
+    },
+    [SHADER_LOGO] = {
+      { lovr_shader_unlit_vert_bindless, sizeof(lovr_shader_unlit_vert_bindless) },
+      { lovr_shader_logo_frag_bindless, sizeof(lovr_shader_logo_frag_bindless) }
+    }
+  };
+
+  if (state.features.bindless) {
+    return bindlessSources[type][stage];
+  }
+
   return sources[type][stage];
 }
 
@@ -1659,12 +2724,14 @@ Shader* lovrGraphicsGetDefaultShader(DefaultShader type) {
     .source[1] = lovrGraphicsGetDefaultShaderSource(type, STAGE_FRAGMENT)
   };
 
-  return state.defaultShaders[type] = lovrShaderCreate(&info);
+  return getBuiltinShader(&state.defaultShaders[type], &info);
 }
 
 Shader* lovrShaderCreate(const ShaderInfo* info) {
-  Shader* shader = calloc(1, sizeof(Shader) + gpu_sizeof_shader());
-  lovrAssert(shader, "Out of memory");
+  // The Shader is put together in temporary memory and only copied to the heap once it's complete,
+  // so a Shader that fails to load doesn't leak anything
+  Shader* shader = tempAlloc(sizeof(Shader));
+  memset(shader, 0, sizeof(Shader));
 
   uint32_t stageCount = info->type == SHADER_GRAPHICS ? 2 : 1;
   uint32_t firstStage = info->type == SHADER_GRAPHICS ? GPU_STAGE_VERTEX : GPU_STAGE_COMPUTE;
@@ -1704,14 +2771,12 @@ Shader* lovrShaderCreate(const ShaderInfo* info) {
   shader->attributeCount = spv[0].attributeCount;
 
   shader->constantSize = MAX(spv[0].pushConstantSize, spv[1].pushConstantSize);
-  shader->constants = malloc(spv[constantStage].pushConstantCount * sizeof(ShaderConstant));
-  shader->resources = malloc((spv[0].resourceCount + spv[1].resourceCount) * sizeof(ShaderResource));
-  shader->attributes = malloc(spv[0].attributeCount * sizeof(ShaderAttribute));
+  shader->constants = tempAlloc(spv[constantStage].pushConstantCount * sizeof(ShaderConstant));
+  shader->resources = tempAlloc((spv[0].resourceCount + spv[1].resourceCount) * sizeof(ShaderResource));
+  shader->attributes = tempAlloc(spv[0].attributeCount * sizeof(ShaderAttribute));
   gpu_slot* slots = tempAlloc((spv[0].resourceCount + spv[1].resourceCount) * sizeof(gpu_slot));
-  shader->flags = malloc(maxFlags * sizeof(gpu_shader_flag));
-  shader->flagLookup = malloc(maxFlags * sizeof(uint32_t));
-  lovrAssert(shader->constants && shader->resources && shader->attributes, "Out of memory");
-  lovrAssert(shader->flags && shader->flagLookup, "Out of memory");
+  shader->flags = tempAlloc(maxFlags * sizeof(gpu_shader_flag));
+  shader->flagLookup = tempAlloc(maxFlags * sizeof(uint32_t));
 
   lovrCheck(shader->constantSize <= state.limits.pushConstantSize, "Shader push constants block is too big");
 
@@ -1750,6 +2815,13 @@ Shader* lovrShaderCreate(const ShaderInfo* info) {
     for (uint32_t i = 0; i < spv[s].resourceCount; i++) {
       spv_resource* resource = &spv[s].resources[i];
 
+      // The Material interface differs between bindless and regular mode, so the shader has to
+      // have been compiled for the mode the renderer is running in
+      if (info->type == SHADER_GRAPHICS && resource->set == 1 && resource->binding == 0) {
+        bool bindless = resource->type == SPV_STORAGE_BUFFER;
+        lovrCheck(bindless == state.features.bindless, "Shader was compiled %s bindless Materials, but bindless Materials are %s", bindless ? "with" : "without", state.features.bindless ? "enabled" : "disabled");
+      }
+
       if (resource->set != userSet) {
         continue;
       }
@@ -1870,7 +2942,7 @@ Shader* lovrShaderCreate(const ShaderInfo* info) {
   }
 
   shader->ref = 1;
-  shader->gpu = (gpu_shader*) (shader + 1);
+  shader->gpu = tempAlloc(gpu_sizeof_shader());
   shader->info = *info;
   shader->layout = getLayout(slots, shader->resourceCount);
 
@@ -1891,9 +2963,44 @@ Shader* lovrShaderCreate(const ShaderInfo* info) {
 
   gpu.layouts[userSet] = shader->resourceCount > 0 ? state.layouts.data[shader->layout].gpu : NULL;
 
+  // Everything that can fail without the GPU is done before creating GPU objects
+  Shader* copy = malloc(sizeof(Shader) + gpu_sizeof_shader());
+  void* constants = malloc(spv[constantStage].pushConstantCount * sizeof(ShaderConstant));
+  void* resources = malloc((spv[0].resourceCount + spv[1].resourceCount) * sizeof(ShaderResource));
+  void* attributes = malloc(spv[0].attributeCount * sizeof(ShaderAttribute));
+  void* flags = malloc(maxFlags * sizeof(gpu_shader_flag));
+  void* flagLookup = malloc(maxFlags * sizeof(uint32_t));
+
+  if (!copy || !constants || !resources || !attributes || !flags || !flagLookup) {
+    free(copy);
+    free(constants);
+    free(resources);
+    free(attributes);
+    free(flags);
+    free(flagLookup);
+    lovrThrow("Out of memory");
+  }
+
+  memset(shader->gpu, 0, gpu_sizeof_shader());
+  pendingShader.shader = shader->gpu;
   gpu_shader_init(shader->gpu, &gpu);
   lovrShaderInit(shader);
-  return shader;
+  pendingShader.shader = NULL;
+
+  *copy = *shader;
+  copy->gpu = (gpu_shader*) (copy + 1);
+  memcpy(copy->gpu, shader->gpu, gpu_sizeof_shader());
+  copy->constants = constants;
+  copy->resources = resources;
+  copy->attributes = attributes;
+  copy->flags = flags;
+  copy->flagLookup = flagLookup;
+  memcpy(copy->constants, shader->constants, shader->constantCount * sizeof(ShaderConstant));
+  memcpy(copy->resources, shader->resources, shader->resourceCount * sizeof(ShaderResource));
+  memcpy(copy->attributes, shader->attributes, shader->attributeCount * sizeof(ShaderAttribute));
+  memcpy(copy->flags, shader->flags, shader->flagCount * sizeof(gpu_shader_flag));
+  memcpy(copy->flagLookup, shader->flagLookup, shader->flagCount * sizeof(uint32_t));
+  return copy;
 }
 
 Shader* lovrShaderClone(Shader* parent, ShaderFlag* flags, uint32_t count) {
@@ -1969,8 +3076,34 @@ void lovrShaderGetWorkgroupSize(Shader* shader, uint32_t size[3]) {
 // Material
 
 Material* lovrMaterialCreate(const MaterialInfo* info) {
+  Texture* textures[] = {
+    info->texture,
+    info->glowTexture,
+    info->metalnessTexture,
+    info->roughnessTexture,
+    info->clearcoatTexture,
+    info->occlusionTexture,
+    info->normalTexture
+  };
+
+  // Material bundles can't change, so streaming textures finish uploading first.  Texture materials
+  // are the exception, streamTextures replaces them as the texture's mipmaps arrive.
+  for (uint32_t i = 0; i < COUNTOF(textures); i++) {
+    if (textures[i]) {
+      finishTextureStream(textures[i]);
+    }
+  }
+
+  return createMaterial(info);
+}
+
+static Material* createMaterial(const MaterialInfo* info) {
+  lock();
   MaterialBlock* block = &state.materialBlocks.data[state.materialBlock];
-  const uint32_t MATERIALS_PER_BLOCK = 256;
+  bool bindless = state.features.bindless;
+  uint32_t stride = bindless ?
+    ALIGN(sizeof(MaterialData), 16) :
+    ALIGN(sizeof(MaterialData), state.limits.uniformBufferAlign);
 
   if (!block || block->head == ~0u || !gpu_is_complete(block->list[block->head].tick)) {
     bool found = false;
@@ -1985,40 +3118,62 @@ Material* lovrMaterialCreate(const MaterialInfo* info) {
     }
 
     if (!found) {
+      if (bindless && state.materialBlocks.length >= BINDLESS_MATERIAL_BLOCKS) {
+        unlockAll();
+        lovrThrow("Too many Materials (bindless mode supports up to %d)", BINDLESS_MATERIAL_BLOCKS * MATERIALS_PER_BLOCK);
+      }
+
       arr_expand(&state.materialBlocks, 1);
       lovrAssert(state.materialBlocks.length < UINT16_MAX, "Out of memory");
       state.materialBlock = state.materialBlocks.length++;
       block = &state.materialBlocks.data[state.materialBlock];
       block->list = malloc(MATERIALS_PER_BLOCK * sizeof(Material));
       block->buffer = malloc(gpu_sizeof_buffer());
-      block->bundlePool = malloc(gpu_sizeof_bundle_pool());
-      block->bundles = malloc(MATERIALS_PER_BLOCK * gpu_sizeof_bundle());
-      lovrAssert(block->list && block->buffer && block->bundlePool && block->bundles, "Out of memory");
+      block->bundlePool = bindless ? NULL : malloc(gpu_sizeof_bundle_pool());
+      block->bundles = bindless ? NULL : malloc(MATERIALS_PER_BLOCK * gpu_sizeof_bundle());
+      lovrAssert(block->list && block->buffer && (bindless || (block->bundlePool && block->bundles)), "Out of memory");
 
       for (uint32_t i = 0; i < MATERIALS_PER_BLOCK; i++) {
         block->list[i].next = i + 1;
         block->list[i].tick = state.tick - 4;
         block->list[i].block = (uint16_t) state.materialBlock;
         block->list[i].index = i;
-        block->list[i].bundle = (gpu_bundle*) ((char*) block->bundles + i * gpu_sizeof_bundle());
+        block->list[i].bundle = bindless ? state.bindlessBundle : (gpu_bundle*) ((char*) block->bundles + i * gpu_sizeof_bundle());
       }
       block->list[MATERIALS_PER_BLOCK - 1].next = ~0u;
       block->tail = MATERIALS_PER_BLOCK - 1;
       block->head = 0;
 
       gpu_buffer_init(block->buffer, &(gpu_buffer_info) {
-        .size = MATERIALS_PER_BLOCK * ALIGN(sizeof(MaterialData), state.limits.uniformBufferAlign),
+        .size = MATERIALS_PER_BLOCK * stride,
         .pointer = &block->pointer,
         .label = "Material Block"
       });
 
-      gpu_bundle_pool_info poolInfo = {
-        .bundles = block->bundles,
-        .layout = state.layouts.data[state.materialLayout].gpu,
-        .count = MATERIALS_PER_BLOCK
-      };
+      if (bindless) {
+        gpu_binding binding = {
+          .number = 0,
+          .type = GPU_SLOT_STORAGE_BUFFER,
+          .element = (uint32_t) state.materialBlock,
+          .buffer = { block->buffer, 0, MATERIALS_PER_BLOCK * stride }
+        };
+
+        gpu_bundle_info bundleInfo = {
+          .layout = state.layouts.data[state.materialLayout].gpu,
+          .bindings = &binding,
+          .count = 1
+        };
+
+        gpu_bundle_write(&state.bindlessBundle, &bundleInfo, 1);
+      } else {
+        gpu_bundle_pool_info poolInfo = {
+          .bundles = block->bundles,
+          .layout = state.layouts.data[state.materialLayout].gpu,
+          .count = MATERIALS_PER_BLOCK
+        };
 
-      gpu_bundle_pool_init(block->bundlePool, &poolInfo);
+        gpu_bundle_pool_init(block->bundlePool, &poolInfo);
+      }
     }
   }
 
@@ -2029,7 +3184,6 @@ Material* lovrMaterialCreate(const MaterialInfo* info) {
   material->info = *info;
 
   MaterialData* data;
-  uint32_t stride = ALIGN(sizeof(MaterialData), state.limits.uniformBufferAlign);
 
   if (block->pointer) {
     data = (MaterialData*) ((char*) block->pointer + material->index * stride);
@@ -2043,6 +3197,8 @@ Material* lovrMaterialCreate(const MaterialInfo* info) {
   }
 
   memcpy(data, info, sizeof(MaterialData));
+  gpu_layout* layout = state.layouts.data[state.materialLayout].gpu;
+  unlock();
 
   gpu_buffer_binding buffer = {
     .object = block->buffer,
@@ -2069,27 +3225,47 @@ Material* lovrMaterialCreate(const MaterialInfo* info) {
     Texture* texture = textures[i] ? textures[i] : state.defaultTexture;
     lovrCheck(i == 0 || texture->info.type == TEXTURE_2D, "Material textures must be 2D");
     lovrCheck(texture->info.usage & TEXTURE_SAMPLE, "Textures must be created with the 'sample' usage to use them in Materials");
-    bindings[i + 1] = (gpu_binding) { i + 1, GPU_SLOT_SAMPLED_TEXTURE, .texture = texture->gpu };
+    bindings[i + 1] = (gpu_binding) { i + 1, GPU_SLOT_SAMPLED_TEXTURE, .texture = getSampleView(texture) };
     material->hasWritableTexture |= texture->info.usage != TEXTURE_SAMPLE;
   }
 
   gpu_bundle_info bundleInfo = {
-    .layout = state.layouts.data[state.materialLayout].gpu,
+    .layout = layout,
     .bindings = bindings,
     .count = COUNTOF(bindings)
   };
 
-  gpu_bundle_write(&material->bundle, &bundleInfo, 1);
+  // Bindless materials only write their textures, into their own 8 slots of the shared bundle.
+  // The slots are free since the material isn't reused until the GPU is done with it.
+  if (bindless) {
+    uint32_t id = material->block * MATERIALS_PER_BLOCK + material->index;
+
+    for (uint32_t i = 1; i < COUNTOF(bindings); i++) {
+      bindings[i].number = 1;
+      bindings[i].element = id * 8 + (i - 1);
+    }
+
+    bundleInfo.bindings++;
+    bundleInfo.count--;
+
+    lock();
+    gpu_bundle_write(&material->bundle, &bundleInfo, 1);
+    unlock();
+  } else {
+    gpu_bundle_write(&material->bundle, &bundleInfo, 1);
+  }
 
   return material;
 }
 
 void lovrMaterialDestroy(void* ref) {
   Material* material = ref;
+  lock();
   MaterialBlock* block = &state.materialBlocks.data[material->block];
   material->tick = state.tick;
   block->tail = material->index;
   if (block->head == ~0u) block->head = block->tail;
+  unlock();
   lovrRelease(material->info.texture, lovrTextureDestroy);
   lovrRelease(material->info.glowTexture, lovrTextureDestroy);
   lovrRelease(material->info.metalnessTexture, lovrTextureDestroy);
@@ -2106,16 +3282,28 @@ const MaterialInfo* lovrMaterialGetInfo(Material* material) {
 // Font
 
 Font* lovrGraphicsGetDefaultFont() {
-  if (!state.defaultFont) {
-    Rasterizer* rasterizer = lovrRasterizerCreate(NULL, 32);
-    state.defaultFont = lovrFontCreate(&(FontInfo) {
-      .rasterizer = rasterizer,
-      .spread = 4.
-    });
-    lovrRelease(rasterizer, lovrRasterizerDestroy);
+  if (state.defaultFont) {
+    return state.defaultFont;
+  }
+
+  Rasterizer* rasterizer = lovrRasterizerCreate(NULL, 32);
+  Font* font = lovrFontCreate(&(FontInfo) {
+    .rasterizer = rasterizer,
+    .spread = 4.
+  });
+  lovrRelease(rasterizer, lovrRasterizerDestroy);
+
+  // Another thread may have created the default font in the meantime
+  lock();
+  if (state.defaultFont) {
+    unlock();
+    lovrRelease(font, lovrFontDestroy);
+    return state.defaultFont;
   }
 
-  return state.defaultFont;
+  state.defaultFont = font;
+  unlock();
+  return font;
 }
 
 Font* lovrFontCreate(const FontInfo* info) {
@@ -2125,6 +3313,7 @@ Font* lovrFontCreate(const FontInfo* info) {
   font->info = *info;
   lovrRetain(info->rasterizer);
   arr_init(&font->glyphs, realloc);
+  arr_init(&font->skyline, realloc);
   map_init(&font->glyphLookup, 36);
   map_init(&font->kerning, 36);
 
@@ -2144,17 +3333,49 @@ Font* lovrFontCreate(const FontInfo* info) {
     font->atlasHeight <<= 1;
   }
 
+  arr_push(&font->skyline, ((SkylineNode) { 0, 0, font->atlasWidth }));
+
+  // Fonts with a cached atlas start out with all of the glyphs they had last time
+  if (state.config.fontCache) {
+    double params[3] = { lovrRasterizerGetFontSize(info->rasterizer), info->spread, font->padding };
+    font->cacheKey = hash_mix(lovrRasterizerGetHash(info->rasterizer), hash64(params, sizeof(params)));
+
+    lock();
+    uint64_t index = map_get(&state.fontCacheLookup, font->cacheKey);
+    if (index != MAP_NIL) {
+      loadFont(font, &state.fontCache.data[index]);
+    }
+    arr_push(&state.fonts, font);
+    unlock();
+  }
+
   return font;
 }
 
 void lovrFontDestroy(void* ref) {
   Font* font = ref;
+  if (state.initialized) {
+    lock();
+    evictTextLayouts(font);
+    if (font->cacheKey) {
+      saveFont(font);
+      for (size_t i = 0; i < state.fonts.length; i++) {
+        if (state.fonts.data[i] == font) {
+          arr_splice(&state.fonts, i, 1);
+          break;
+        }
+      }
+    }
+    unlock();
+  }
   lovrRelease(font->info.rasterizer, lovrRasterizerDestroy);
   lovrRelease(font->material, lovrMaterialDestroy);
   lovrRelease(font->atlas, lovrTextureDestroy);
   arr_free(&font->glyphs);
+  arr_free(&font->skyline);
   map_free(&font->glyphLookup);
   map_free(&font->kerning);
+  free(font->pixels);
   free(font);
 }
 
@@ -2178,158 +3399,565 @@ void lovrFontSetLineSpacing(Font* font, float spacing) {
   font->lineSpacing = spacing;
 }
 
-static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint, bool* resized) {
-  uint64_t hash = hash64(&codepoint, 4);
-  uint64_t index = map_get(&font->glyphLookup, hash);
+// Runs msdfgen and converts the result to RGBA8.  This only reads from the Rasterizer, so it's okay
+// to call it from the rasterizer threads.  It can't throw there, so it returns NULL when it runs out
+// of memory and the main thread reports the error.
+static uint8_t* rasterizeGlyph(Font* font, uint32_t codepoint, uint32_t width, uint32_t height) {
+  float* pixels = malloc(width * height * 4 * sizeof(float));
+  uint8_t* bytes = malloc(width * height * 4 * sizeof(uint8_t));
 
-  if (index != MAP_NIL) {
-    if (resized) *resized = false;
-    return &font->glyphs.data[index];
+  if (!pixels || !bytes) {
+    free(pixels);
+    free(bytes);
+    return NULL;
   }
 
-  arr_expand(&font->glyphs, 1);
-  map_set(&font->glyphLookup, hash, font->glyphs.length);
-  Glyph* glyph = &font->glyphs.data[font->glyphs.length++];
-
-  glyph->codepoint = codepoint;
-  glyph->advance = lovrRasterizerGetAdvance(font->info.rasterizer, codepoint);
+  lovrRasterizerGetPixels(font->info.rasterizer, codepoint, pixels, width, height, font->info.spread);
+  for (uint32_t i = 0; i < width * height * 4; i++) {
+    float f = pixels[i]; // CLAMP would evaluate this multiple times
+    bytes[i] = (uint8_t) (CLAMP(f, 0.f, 1.f) * 255.f + .5f);
+  }
+  free(pixels);
+  return bytes;
+}
 
-  if (lovrRasterizerIsGlyphEmpty(font->info.rasterizer, codepoint)) {
-    memset(glyph->box, 0, sizeof(glyph->box));
-    if (resized) *resized = false;
-    return glyph;
+// Fonts that get cached keep a CPU copy of their atlas, so it can be saved without a readback
+static void mirrorGlyph(GlyphJob* job) {
+  Font* font = job->font;
+  if (!font->pixels) return;
+  uint32_t stride = font->atlas->info.width * 4;
+  uint32_t rowSize = job->extent[0] * 4;
+  uint8_t* dst = font->pixels + job->offset[1] * stride + job->offset[0] * 4;
+  for (uint32_t y = 0; y < job->extent[1]; y++) {
+    memcpy(dst + y * stride, job->pixels + y * rowSize, rowSize);
   }
+}
 
-  lovrRasterizerGetGlyphBoundingBox(font->info.rasterizer, codepoint, glyph->box);
+static void copyGlyph(GlyphJob* job) {
+  mirrorGlyph(job);
+  beginFrame();
+  uint32_t size = job->extent[0] * job->extent[1] * 4;
+  gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
+  void* data = gpu_map(scratchpad, size, 4, GPU_MAP_STAGING);
+  memcpy(data, job->pixels, size);
+  uint32_t dstOffset[4] = { job->offset[0], job->offset[1], 0, 0 };
+  uint32_t extent[3] = { job->extent[0], job->extent[1], 1 };
+  gpu_copy_buffer_texture(state.stream, scratchpad, job->font->atlas->gpu, 0, dstOffset, extent);
+  state.hasGlyphUpload = true;
+}
 
-  float width = glyph->box[2] - glyph->box[0];
-  float height = glyph->box[3] - glyph->box[1];
-  uint32_t pixelWidth = 2 * font->padding + (uint32_t) ceilf(width);
-  uint32_t pixelHeight = 2 * font->padding + (uint32_t) ceilf(height);
+#ifndef LOVR_DISABLE_THREAD
+static int glyphRasterizer(void* arg) {
+  mtx_lock(&state.glyphLock);
+
+  for (;;) {
+    while (state.glyphQueue.length == 0 && !state.rasterizerQuit) {
+      cnd_wait(&state.glyphSignal, &state.glyphLock);
+    }
+
+    if (state.rasterizerQuit) {
+      break;
+    }
+
+    // Newest first, glyphs for text that's on screen right now are the most urgent
+    GlyphJob job = arr_pop(&state.glyphQueue);
+    mtx_unlock(&state.glyphLock);
 
-  // If the glyph exceeds the width, start a new row
-  if (font->atlasX + pixelWidth > font->atlasWidth) {
-    font->atlasX = font->atlasWidth == font->atlasHeight ? 0 : font->atlasWidth >> 1;
-    font->atlasY += font->rowHeight;
+    job.pixels = rasterizeGlyph(job.font, job.codepoint, job.extent[0], job.extent[1]);
+
+    mtx_lock(&state.glyphLock);
+    arr_push(&state.glyphResults, job);
+    job.font->pendingGlyphs--;
+    cnd_broadcast(&state.glyphDone);
   }
 
-  // If the glyph exceeds the height, expand the atlas
-  if (font->atlasY + pixelHeight > font->atlasHeight) {
-    if (font->atlasWidth == font->atlasHeight) {
-      font->atlasX = font->atlasWidth;
-      font->atlasY = 0;
-      font->atlasWidth <<= 1;
-      font->rowHeight = 0;
+  mtx_unlock(&state.glyphLock);
+  return 0;
+}
+#endif
+
+// Copies glyphs that finished rasterizing into their atlases.  Atlas resizes keep glyphs in the
+// same place, so it's fine if the atlas changed since the glyph was queued.
+static void uploadGlyphs(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.glyphLock);
+  bool failed = false;
+
+  for (size_t i = 0; i < state.glyphResults.length; i++) {
+    GlyphJob* job = &state.glyphResults.data[i];
+    if (job->pixels) {
+      copyGlyph(job);
     } else {
-      font->atlasX = 0;
-      font->atlasY = font->atlasHeight;
-      font->atlasHeight <<= 1;
-      font->rowHeight = 0;
+      failed = true;
     }
+    free(job->pixels);
+    lovrRelease(job->font, lovrFontDestroy);
   }
 
-  glyph->x = font->atlasX + font->padding;
-  glyph->y = font->atlasY + font->padding;
-  glyph->uv[0] = (uint16_t) ((float) glyph->x / font->atlasWidth * 65535.f + .5f);
-  glyph->uv[1] = (uint16_t) ((float) (glyph->y + height) / font->atlasHeight * 65535.f + .5f);
-  glyph->uv[2] = (uint16_t) ((float) (glyph->x + width) / font->atlasWidth * 65535.f + .5f);
-  glyph->uv[3] = (uint16_t) ((float) glyph->y / font->atlasHeight * 65535.f + .5f);
+  arr_clear(&state.glyphResults);
+  mtx_unlock(&state.glyphLock);
+  lovrAssert(!failed, "Out of memory");
+#endif
+}
 
-  font->atlasX += pixelWidth;
-  font->rowHeight = MAX(font->rowHeight, pixelHeight);
+// Makes a new atlas texture with the current atlas size, keeping everything from the old one
+static void resizeAtlas(Font* font) {
+  lovrCheck(font->atlasWidth <= 65536, "Font atlas is way too big!");
 
-  beginFrame();
+  Texture* atlas = lovrTextureCreate(&(TextureInfo) {
+    .type = TEXTURE_2D,
+    .format = FORMAT_RGBA8,
+    .width = font->atlasWidth,
+    .height = font->atlasHeight,
+    .layers = 1,
+    .mipmaps = 1,
+    .samples = 1,
+    .usage = TEXTURE_SAMPLE | TEXTURE_TRANSFER,
+    .label = "Font Atlas"
+  });
 
-  // Atlas resize
-  if (!font->atlas || font->atlasWidth > font->atlas->info.width || font->atlasHeight > font->atlas->info.height) {
-    lovrCheck(font->atlasWidth <= 65536, "Font atlas is way too big!");
+  float clear[4] = { 0.f, 0.f, 0.f, 0.f };
+  gpu_clear_texture(state.stream, atlas->gpu, clear, 0, ~0u, 0, ~0u);
+
+  // This barrier serves 2 purposes:
+  // - Ensure new atlas clear is finished/flushed before copying to it
+  // - Ensure any unsynchronized pending uploads to old atlas finish before copying to new atlas
+  gpu_barrier barrier;
+  barrier.prev = GPU_PHASE_TRANSFER;
+  barrier.next = GPU_PHASE_TRANSFER;
+  barrier.flush = GPU_CACHE_TRANSFER_WRITE;
+  barrier.clear = GPU_CACHE_TRANSFER_READ;
+  gpu_sync(state.stream, &barrier, 1);
+
+  if (font->cacheKey) {
+    uint8_t* pixels = calloc((size_t) font->atlasWidth * font->atlasHeight, 4);
+    lovrAssert(pixels, "Out of memory");
+    if (font->pixels) {
+      uint32_t oldStride = font->atlas->info.width * 4;
+      for (uint32_t y = 0; y < font->atlas->info.height; y++) {
+        memcpy(pixels + y * font->atlasWidth * 4, font->pixels + y * oldStride, oldStride);
+      }
+      free(font->pixels);
+    }
+    font->pixels = pixels;
+  }
 
-    Texture* atlas = lovrTextureCreate(&(TextureInfo) {
-      .type = TEXTURE_2D,
-      .format = FORMAT_RGBA8,
-      .width = font->atlasWidth,
-      .height = font->atlasHeight,
-      .layers = 1,
-      .mipmaps = 1,
-      .samples = 1,
-      .usage = TEXTURE_SAMPLE | TEXTURE_TRANSFER,
-      .label = "Font Atlas"
-    });
+  if (font->atlas) {
+    uint32_t srcOffset[4] = { 0, 0, 0, 0 };
+    uint32_t dstOffset[4] = { 0, 0, 0, 0 };
+    uint32_t extent[3] = { font->atlas->info.width, font->atlas->info.height, 1 };
+    gpu_copy_textures(state.stream, font->atlas->gpu, atlas->gpu, srcOffset, dstOffset, extent);
+    lovrRelease(font->atlas, lovrTextureDestroy);
+  }
 
-    float clear[4] = { 0.f, 0.f, 0.f, 0.f };
-    gpu_clear_texture(state.stream, atlas->gpu, clear, 0, ~0u, 0, ~0u);
+  font->atlas = atlas;
 
-    // This barrier serves 2 purposes:
-    // - Ensure new atlas clear is finished/flushed before copying to it
-    // - Ensure any unsynchronized pending uploads to old atlas finish before copying to new atlas
-    gpu_barrier barrier;
-    barrier.prev = GPU_PHASE_TRANSFER;
-    barrier.next = GPU_PHASE_TRANSFER;
-    barrier.flush = GPU_CACHE_TRANSFER_WRITE;
-    barrier.clear = GPU_CACHE_TRANSFER_READ;
-    gpu_sync(state.stream, &barrier, 1);
+  // Glyph uvs are about to change, so cached text that uses this font is stale
+  evictTextLayouts(font);
 
-    if (font->atlas) {
-      uint32_t srcOffset[4] = { 0, 0, 0, 0 };
-      uint32_t dstOffset[4] = { 0, 0, 0, 0 };
-      uint32_t extent[3] = { font->atlas->info.width, font->atlas->info.height, 1 };
-      gpu_copy_textures(state.stream, font->atlas->gpu, atlas->gpu, srcOffset, dstOffset, extent);
-      lovrRelease(font->atlas, lovrTextureDestroy);
-    }
+  // Material
+  lovrRelease(font->material, lovrMaterialDestroy);
+  font->material = lovrMaterialCreate(&(MaterialInfo) {
+    .data.color = { 1.f, 1.f, 1.f, 1.f },
+    .data.uvScale = { 1.f, 1.f },
+    .data.sdfRange = { font->info.spread / font->atlasWidth, font->info.spread / font->atlasHeight },
+    .texture = font->atlas
+  });
 
-    font->atlas = atlas;
+  // Recompute all glyph uvs after atlas resize
+  for (size_t i = 0; i < font->glyphs.length; i++) {
+    Glyph* g = &font->glyphs.data[i];
+    if (g->box[2] - g->box[0] > 0.f) {
+      g->uv[0] = (uint16_t) ((float) g->x / font->atlasWidth * 65535.f + .5f);
+      g->uv[1] = (uint16_t) ((float) (g->y + g->box[3] - g->box[1]) / font->atlasHeight * 65535.f + .5f);
+      g->uv[2] = (uint16_t) ((float) (g->x + g->box[2] - g->box[0]) / font->atlasWidth * 65535.f + .5f);
+      g->uv[3] = (uint16_t) ((float) g->y / font->atlasHeight * 65535.f + .5f);
+    }
+  }
+}
 
-    // Material
-    lovrRelease(font->material, lovrMaterialDestroy);
-    font->material = lovrMaterialCreate(&(MaterialInfo) {
-      .data.color = { 1.f, 1.f, 1.f, 1.f },
-      .data.uvScale = { 1.f, 1.f },
-      .data.sdfRange = { font->info.spread / font->atlasWidth, font->info.spread / font->atlasHeight },
-      .texture = font->atlas
-    });
+// The font cache is a header (magic, LOVR version, entry count, revision) followed by the entries.
+// Each entry has a 16 byte header (key and size), the atlas size and skyline, the glyphs, and then
+// the atlas pixels.  The key is a hash of the font file, size, spread, and padding.
+#define FONT_CACHE_MAGIC 0x544e464c
+#define FONT_CACHE_VERSION SPIRV_CACHE_VERSION
+#define FONT_CACHE_REVISION 2
 
-    // Recompute all glyph uvs after atlas resize
-    for (size_t i = 0; i < font->glyphs.length; i++) {
-      Glyph* g = &font->glyphs.data[i];
-      if (g->box[2] - g->box[0] > 0.f) {
-        g->uv[0] = (uint16_t) ((float) g->x / font->atlasWidth * 65535.f + .5f);
-        g->uv[1] = (uint16_t) ((float) (g->y + g->box[3] - g->box[1]) / font->atlasHeight * 65535.f + .5f);
-        g->uv[2] = (uint16_t) ((float) (g->x + g->box[2] - g->box[0]) / font->atlasWidth * 65535.f + .5f);
-        g->uv[3] = (uint16_t) ((float) g->y / font->atlasHeight * 65535.f + .5f);
-      }
+// Waits for a font's glyphs to finish rasterizing and copies them to its atlas mirror
+static void flushGlyphs(Font* font) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.glyphLock);
+  while (font->pendingGlyphs > 0) {
+    cnd_wait(&state.glyphDone, &state.glyphLock);
+  }
+  for (size_t i = 0; i < state.glyphResults.length; i++) {
+    if (state.glyphResults.data[i].font == font) {
+      mirrorGlyph(&state.glyphResults.data[i]);
     }
+  }
+  mtx_unlock(&state.glyphLock);
+#endif
+}
 
-    if (resized) *resized = true;
+// Called with the lock held
+static void saveFont(Font* font) {
+  if (!font->pixels) {
+    return;
   }
 
-  gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
+  size_t skylineSize = font->skyline.length * sizeof(SkylineNode);
+  size_t glyphSize = font->glyphs.length * sizeof(Glyph);
+  size_t pixelSize = (size_t) font->atlasWidth * font->atlasHeight * 4;
+  CachedFont entry = { .key = font->cacheKey, .size = 16 + skylineSize + glyphSize + pixelSize };
+  entry.data = malloc(entry.size);
 
-  size_t stack = tempPush();
-  float* pixels = tempAlloc(pixelWidth * pixelHeight * 4 * sizeof(float));
-  lovrRasterizerGetPixels(font->info.rasterizer, glyph->codepoint, pixels, pixelWidth, pixelHeight, font->info.spread);
-  uint8_t* dst = gpu_map(scratchpad, pixelWidth * pixelHeight * 4 * sizeof(uint8_t), 4, GPU_MAP_STAGING);
-  float* src = pixels;
-  for (uint32_t y = 0; y < pixelHeight; y++) {
-    for (uint32_t x = 0; x < pixelWidth; x++) {
-      for (uint32_t c = 0; c < 4; c++) {
-        float f = *src++; // CLAMP would evaluate this multiple times
-        *dst++ = (uint8_t) (CLAMP(f, 0.f, 1.f) * 255.f + .5f);
-      }
-    }
+  if (!entry.data) {
+    return;
   }
-  uint32_t dstOffset[4] = { glyph->x - font->padding, glyph->y - font->padding, 0, 0 };
-  uint32_t extent[3] = { pixelWidth, pixelHeight, 1 };
-  gpu_copy_buffer_texture(state.stream, scratchpad, font->atlas->gpu, 0, dstOffset, extent);
-  tempPop(stack);
 
-  state.hasGlyphUpload = true;
-  return glyph;
+  char* p = entry.data;
+  uint32_t header[4] = {
+    (uint32_t) font->glyphs.length,
+    font->atlasWidth,
+    font->atlasHeight,
+    (uint32_t) font->skyline.length
+  };
+  memcpy(p, header, sizeof(header));
+  memcpy(p + 16, font->skyline.data, skylineSize);
+  memcpy(p + 16 + skylineSize, font->glyphs.data, glyphSize);
+  memcpy(p + 16 + skylineSize + glyphSize, font->pixels, pixelSize);
+
+  uint64_t index = map_get(&state.fontCacheLookup, entry.key);
+  if (index == MAP_NIL) {
+    map_set(&state.fontCacheLookup, entry.key, state.fontCache.length);
+    arr_push(&state.fontCache, entry);
+  } else {
+    free(state.fontCache.data[index].data);
+    state.fontCache.data[index] = entry;
+  }
 }
 
-float lovrFontGetKerning(Font* font, uint32_t first, uint32_t second) {
-  uint32_t codepoints[] = { first, second };
-  uint64_t hash = hash64(codepoints, sizeof(codepoints));
-  union { float f32; uint64_t u64; } kerning = { .u64 = map_get(&font->kerning, hash) };
+// Called with the lock held, from lovrFontCreate.  Entries were validated when the cache was read.
+static void loadFont(Font* font, CachedFont* entry) {
+  uint32_t header[4];
+  char* p = entry->data;
+  memcpy(header, p, sizeof(header));
+  size_t skylineSize = header[3] * sizeof(SkylineNode);
+  size_t glyphSize = header[0] * sizeof(Glyph);
+
+  arr_clear(&font->skyline);
+  arr_expand(&font->skyline, header[3]);
+  memcpy(font->skyline.data, p + 16, skylineSize);
+  font->skyline.length = header[3];
+
+  arr_expand(&font->glyphs, header[0]);
+  memcpy(font->glyphs.data, p + 16 + skylineSize, glyphSize);
+  font->glyphs.length = header[0];
+
+  for (uint32_t i = 0; i < header[0]; i++) {
+    map_set(&font->glyphLookup, hash64(&font->glyphs.data[i].codepoint, 4), i);
+  }
+
+  font->atlasWidth = header[1];
+  font->atlasHeight = header[2];
+
+  beginFrame();
+  resizeAtlas(font);
+
+  GlyphJob job = {
+    .font = font,
+    .offset = { 0, 0 },
+    .extent = { font->atlasWidth, font->atlasHeight },
+    .pixels = (uint8_t*) p + 16 + skylineSize + glyphSize
+  };
+
+  copyGlyph(&job);
+}
+
+void lovrGraphicsGetFontCache(void* data, size_t* size) {
+  lock();
+
+  // Fonts that are still alive get saved the first time, when the size is queried
+  if (!data) {
+    for (size_t i = 0; i < state.fonts.length; i++) {
+      flushGlyphs(state.fonts.data[i]);
+      saveFont(state.fonts.data[i]);
+    }
+  }
+
+  size_t total = 16;
+  for (size_t i = 0; i < state.fontCache.length; i++) {
+    total += 16 + state.fontCache.data[i].size;
+  }
+
+  if (!data) {
+    *size = state.fontCache.length > 0 ? total : 0;
+    unlock();
+    return;
+  }
+
+  if (*size < total) {
+    *size = 0;
+    unlock();
+    return;
+  }
+
+  char* p = data;
+  uint32_t header[4] = { FONT_CACHE_MAGIC, FONT_CACHE_VERSION, (uint32_t) state.fontCache.length, FONT_CACHE_REVISION };
+  memcpy(p, header, sizeof(header));
+  p += sizeof(header);
+
+  for (size_t i = 0; i < state.fontCache.length; i++) {
+    CachedFont* entry = &state.fontCache.data[i];
+    memcpy(p, &entry->key, 8);
+    memcpy(p + 8, &entry->size, 8);
+    memcpy(p + 16, entry->data, entry->size);
+    p += 16 + entry->size;
+  }
+
+  *size = total;
+  unlock();
+}
+
+// Invalid or outdated caches are ignored, glyphs just get rasterized again
+static void loadFontCache(void* data, size_t size) {
+  uint32_t header[4];
+
+  if (!data || size < sizeof(header)) {
+    return;
+  }
+
+  memcpy(header, data, sizeof(header));
+
+  if (header[0] != FONT_CACHE_MAGIC || header[1] != FONT_CACHE_VERSION || header[3] != FONT_CACHE_REVISION) {
+    return;
+  }
+
+  char* p = (char*) data + sizeof(header);
+  size_t remaining = size - sizeof(header);
+
+  for (uint32_t i = 0; i < header[2] && remaining >= 16; i++) {
+    CachedFont entry;
+    memcpy(&entry.key, p, 8);
+    memcpy(&entry.size, p + 8, 8);
+
+    if (entry.size > remaining - 16 || entry.size < 16) {
+      break;
+    }
+
+    uint32_t info[4];
+    memcpy(info, p + 16, sizeof(info));
+    uint64_t expected = 16 + (uint64_t) info[3] * sizeof(SkylineNode) + (uint64_t) info[0] * sizeof(Glyph) + (uint64_t) info[1] * info[2] * 4;
+    bool valid = entry.size == expected && info[1] > 0 && info[2] > 0 && info[1] <= 65536 && info[2] <= 65536 && info[3] > 0;
+
+    if (valid) {
+      entry.data = malloc(entry.size);
+      lovrAssert(entry.data, "Out of memory");
+      memcpy(entry.data, p + 16, entry.size);
+      map_set(&state.fontCacheLookup, entry.key, state.fontCache.length);
+      arr_push(&state.fontCache, entry);
+    }
+
+    p += 16 + entry.size;
+    remaining -= 16 + entry.size;
+  }
+}
+
+// Skyline bottom-left packing: the glyph goes wherever its bottom edge ends up lowest, which keeps
+// the atlas dense even when glyph heights vary a lot (unlike a row packer).
+static bool packGlyph(Font* font, uint32_t width, uint32_t height, uint32_t* x, uint32_t* y) {
+  SkylineNode* nodes = font->skyline.data;
+  size_t count = font->skyline.length;
+  size_t best = ~0u;
+  uint32_t bestY = ~0u;
+  uint32_t bestWidth = ~0u;
+
+  for (size_t i = 0; i < count; i++) {
+    if (nodes[i].x + width > font->atlasWidth) {
+      break;
+    }
+
+    // The glyph rests on the highest node underneath it
+    uint32_t top = 0;
+    uint32_t remaining = width;
+    for (size_t j = i; remaining > 0; j++) {
+      top = MAX(top, nodes[j].y);
+      remaining -= MIN(remaining, nodes[j].width);
+    }
+
+    if (top + height > font->atlasHeight) {
+      continue;
+    }
+
+    if (top < bestY || (top == bestY && nodes[i].width < bestWidth)) {
+      best = i;
+      bestY = top;
+      bestWidth = nodes[i].width;
+    }
+  }
+
+  if (best == ~0u) {
+    return false;
+  }
+
+  *x = nodes[best].x;
+  *y = bestY;
+
+  // Insert a node for the top of the glyph, then trim or remove the nodes it covers
+  SkylineNode node = { *x, bestY + height, width };
+  arr_expand(&font->skyline, 1);
+  nodes = font->skyline.data;
+  memmove(nodes + best + 1, nodes + best, (font->skyline.length - best) * sizeof(SkylineNode));
+  nodes[best] = node;
+  font->skyline.length++;
+
+  size_t i = best + 1;
+  while (i < font->skyline.length && nodes[i].x < node.x + node.width) {
+    uint32_t overlap = node.x + node.width - nodes[i].x;
+    if (overlap >= nodes[i].width) {
+      arr_splice(&font->skyline, i, 1);
+    } else {
+      nodes[i].x += overlap;
+      nodes[i].width -= overlap;
+      break;
+    }
+  }
+
+  // Merge neighbors at the same height
+  for (i = 0; i + 1 < font->skyline.length;) {
+    if (nodes[i].y == nodes[i + 1].y) {
+      nodes[i].width += nodes[i + 1].width;
+      arr_splice(&font->skyline, i + 1, 1);
+    } else {
+      i++;
+    }
+  }
+
+  return true;
+}
+
+static Glyph* lovrFontGetGlyph(Font* font, uint32_t codepoint, bool* resized) {
+  uint64_t hash = hash64(&codepoint, 4);
+  uint64_t index = map_get(&font->glyphLookup, hash);
+
+  if (index != MAP_NIL) {
+    if (resized) *resized = false;
+    return &font->glyphs.data[index];
+  }
+
+  arr_expand(&font->glyphs, 1);
+  map_set(&font->glyphLookup, hash, font->glyphs.length);
+  Glyph* glyph = &font->glyphs.data[font->glyphs.length++];
+
+  glyph->codepoint = codepoint;
+  glyph->advance = lovrRasterizerGetAdvance(font->info.rasterizer, codepoint);
+
+  if (lovrRasterizerIsGlyphEmpty(font->info.rasterizer, codepoint)) {
+    memset(glyph->box, 0, sizeof(glyph->box));
+    if (resized) *resized = false;
+    return glyph;
+  }
+
+  lovrRasterizerGetGlyphBoundingBox(font->info.rasterizer, codepoint, glyph->box);
+
+  float width = glyph->box[2] - glyph->box[0];
+  float height = glyph->box[3] - glyph->box[1];
+  uint32_t pixelWidth = 2 * font->padding + (uint32_t) ceilf(width);
+  uint32_t pixelHeight = 2 * font->padding + (uint32_t) ceilf(height);
+
+  // If the glyph doesn't fit, expand the atlas (alternating width/height) and try again.  The new
+  // space is added to the skyline, glyphs that are already packed stay where they are.
+  uint32_t x, y;
+  while (!packGlyph(font, pixelWidth, pixelHeight, &x, &y)) {
+    lovrCheck(font->atlasWidth < 65536 && font->atlasHeight < 65536, "Font atlas is way too big!");
+    if (font->atlasWidth == font->atlasHeight) {
+      arr_push(&font->skyline, ((SkylineNode) { font->atlasWidth, 0, font->atlasWidth }));
+      font->atlasWidth <<= 1;
+    } else {
+      font->atlasHeight <<= 1;
+    }
+  }
+
+  glyph->x = x + font->padding;
+  glyph->y = y + font->padding;
+  glyph->uv[0] = (uint16_t) ((float) glyph->x / font->atlasWidth * 65535.f + .5f);
+  glyph->uv[1] = (uint16_t) ((float) (glyph->y + height) / font->atlasHeight * 65535.f + .5f);
+  glyph->uv[2] = (uint16_t) ((float) (glyph->x + width) / font->atlasWidth * 65535.f + .5f);
+  glyph->uv[3] = (uint16_t) ((float) glyph->y / font->atlasHeight * 65535.f + .5f);
+
+  beginFrame();
+
+  if (resized) *resized = false;
+
+  // Atlas resize
+  if (!font->atlas || font->atlasWidth > font->atlas->info.width || font->atlasHeight > font->atlas->info.height) {
+    resizeAtlas(font);
+    if (resized) *resized = true;
+  }
+
+  GlyphJob job = {
+    .font = font,
+    .codepoint = codepoint,
+    .offset = { glyph->x - font->padding, glyph->y - font->padding },
+    .extent = { pixelWidth, pixelHeight }
+  };
+
+  // The atlas region is already clear, so the glyph is blank until a rasterizer thread finishes it
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.glyphLock);
+
+  if (state.rasterizerCount == 0) {
+    uint32_t cores = os_get_core_count();
+    uint32_t count = cores > 2 ? cores - 2 : 1;
+    count = MIN(count, COUNTOF(state.rasterizers));
+    for (uint32_t i = 0; i < count; i++) {
+      if (thrd_create(&state.rasterizers[i], glyphRasterizer, NULL) == thrd_success) {
+        state.rasterizerCount++;
+      }
+    }
+  }
+
+  if (state.rasterizerCount > 0) {
+    lovrRetain(font);
+    font->pendingGlyphs++;
+    arr_push(&state.glyphQueue, job);
+    cnd_signal(&state.glyphSignal);
+    mtx_unlock(&state.glyphLock);
+    return glyph;
+  }
+
+  mtx_unlock(&state.glyphLock);
+#endif
+
+  job.pixels = rasterizeGlyph(font, codepoint, pixelWidth, pixelHeight);
+  lovrAssert(job.pixels, "Out of memory");
+  copyGlyph(&job);
+  free(job.pixels);
+  return glyph;
+}
+
+// Queues all of the glyphs up front so they rasterize in parallel, then waits for them.  They get
+// copied to the atlas on the next submit.
+void lovrFontPrewarm(Font* font, const uint32_t* codepoints, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (lovrRasterizerHasGlyph(font->info.rasterizer, codepoints[i])) {
+      lovrFontGetGlyph(font, codepoints[i], NULL);
+    }
+  }
+
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.glyphLock);
+  while (font->pendingGlyphs > 0) {
+    cnd_wait(&state.glyphDone, &state.glyphLock);
+  }
+  mtx_unlock(&state.glyphLock);
+#endif
+}
+
+float lovrFontGetKerning(Font* font, uint32_t first, uint32_t second) {
+  uint32_t codepoints[] = { first, second };
+  uint64_t hash = hash64(codepoints, sizeof(codepoints));
+  union { float f32; uint64_t u64; } kerning = { .u64 = map_get(&font->kerning, hash) };
 
   if (kerning.u64 == MAP_NIL) {
     kerning.f32 = lovrRasterizerGetKerning(font->info.rasterizer, first, second);
@@ -2460,16 +4088,17 @@ void lovrFontGetLines(Font* font, ColoredString* strings, uint32_t count, float
   tempPop(stack);
 }
 
-static void aline(GlyphVertex* vertices, uint32_t head, uint32_t tail, float width, HorizontalAlign align) {
+static void aline(GlyphQuad* quads, uint32_t head, uint32_t tail, float width, HorizontalAlign align) {
   if (align == ALIGN_LEFT) return;
   float shift = align / 2.f * width;
   for (uint32_t i = head; i < tail; i++) {
-    vertices[i].position.x -= shift;
+    quads[i].rect[0] -= shift;
+    quads[i].rect[2] -= shift;
   }
 }
 
-void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, float wrap, HorizontalAlign halign, VerticalAlign valign, GlyphVertex* vertices, uint32_t* glyphCount, uint32_t* lineCount, Material** material, bool flip) {
-  uint32_t vertexCount = 0;
+// Quads store the corners of the glyph that go with the first and last vertex of the quad
+static void layoutText(Font* font, ColoredString* strings, uint32_t count, float wrap, HorizontalAlign halign, GlyphQuad* quads, uint32_t* glyphCount, uint32_t* lineCount, bool flip) {
   uint32_t lineStart = 0;
   uint32_t wordStart = 0;
   *glyphCount = 0;
@@ -2496,16 +4125,16 @@ void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, flo
     while ((bytes = utf8_decode(str, end, &codepoint)) > 0) {
       if (codepoint == ' ' || codepoint == '\t') {
         if (previous) prevWordEndX = x;
-        wordStart = vertexCount;
+        wordStart = *glyphCount;
         x += codepoint == '\t' ? space * 4.f : space;
         wordStartX = x;
         previous = '\0';
         str += bytes;
         continue;
       } else if (codepoint == '\n') {
-        aline(vertices, lineStart, vertexCount, x, halign);
-        lineStart = vertexCount;
-        wordStart = vertexCount;
+        aline(quads, lineStart, *glyphCount, x, halign);
+        lineStart = *glyphCount;
+        wordStart = *glyphCount;
         x = 0.f;
         y -= leading;
         wordStartX = 0.f;
@@ -2523,7 +4152,7 @@ void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, flo
       Glyph* glyph = lovrFontGetGlyph(font, codepoint, &resized);
 
       if (resized) {
-        lovrFontGetVertices(font, strings, count, wrap, halign, valign, vertices, glyphCount, lineCount, material, flip);
+        layoutText(font, strings, count, wrap, halign, quads, glyphCount, lineCount, flip);
         return;
       }
 
@@ -2536,13 +4165,15 @@ void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, flo
         float dx = wordStartX;
         float dy = leading;
 
-        // Shift the vertices of the overflowing word down a line and back to the beginning
-        for (uint32_t v = wordStart; v < vertexCount; v++) {
-          vertices[v].position.x -= dx;
-          vertices[v].position.y -= dy;
+        // Shift the glyphs of the overflowing word down a line and back to the beginning
+        for (uint32_t q = wordStart; q < *glyphCount; q++) {
+          quads[q].rect[0] -= dx;
+          quads[q].rect[1] -= dy;
+          quads[q].rect[2] -= dx;
+          quads[q].rect[3] -= dy;
         }
 
-        aline(vertices, lineStart, wordStart, prevWordEndX, halign);
+        aline(quads, lineStart, wordStart, prevWordEndX, halign);
         lineStart = wordStart;
         wordStartX = 0.f;
         (*lineCount)++;
@@ -2550,21 +4181,14 @@ void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, flo
         y -= dy;
       }
 
-      // Vertices
+      // Quad
       float* bb = glyph->box;
       uint16_t* uv = glyph->uv;
       if (flip) {
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[0], -(y + bb[1]) }, { uv[0], uv[3] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[2], -(y + bb[1]) }, { uv[2], uv[3] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[0], -(y + bb[3]) }, { uv[0], uv[1] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[2], -(y + bb[3]) }, { uv[2], uv[1] }, { r, g, b, a } };
+        quads[(*glyphCount)++] = (GlyphQuad) { { x + bb[0], -(y + bb[1]), x + bb[2], -(y + bb[3]) }, { uv[0], uv[3], uv[2], uv[1] }, { r, g, b, a } };
       } else {
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[0], y + bb[3] }, { uv[0], uv[1] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[2], y + bb[3] }, { uv[2], uv[1] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[0], y + bb[1] }, { uv[0], uv[3] }, { r, g, b, a } };
-        vertices[vertexCount++] = (GlyphVertex) { { x + bb[2], y + bb[1] }, { uv[2], uv[3] }, { r, g, b, a } };
+        quads[(*glyphCount)++] = (GlyphQuad) { { x + bb[0], y + bb[3], x + bb[2], y + bb[1] }, { uv[0], uv[1], uv[2], uv[3] }, { r, g, b, a } };
       }
-      (*glyphCount)++;
 
       // Advance
       x += glyph->advance;
@@ -2573,8 +4197,29 @@ void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, flo
   }
 
   // Align last line
-  aline(vertices, lineStart, vertexCount, x, halign);
+  aline(quads, lineStart, *glyphCount, x, halign);
+}
+
+void lovrFontGetVertices(Font* font, ColoredString* strings, uint32_t count, float wrap, HorizontalAlign halign, VerticalAlign valign, GlyphVertex* vertices, uint32_t* glyphCount, uint32_t* lineCount, Material** material, bool flip) {
+  size_t totalLength = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    totalLength += strings[i].length;
+  }
 
+  size_t stack = tempPush();
+  GlyphQuad* quads = tempAlloc(totalLength * sizeof(GlyphQuad));
+  layoutText(font, strings, count, wrap, halign, quads, glyphCount, lineCount, flip);
+
+  for (uint32_t i = 0; i < *glyphCount; i++) {
+    GlyphQuad* q = &quads[i];
+    for (uint32_t c = 0; c < 4; c++) {
+      uint32_t u = (c & 1) << 1;
+      uint32_t v = 1 + (c & 2);
+      vertices[4 * i + c] = (GlyphVertex) { { q->rect[u], q->rect[v] }, { q->uv[u], q->uv[v] }, { q->color[0], q->color[1], q->color[2], q->color[3] } };
+    }
+  }
+
+  tempPop(stack);
   *material = font->material;
 }
 
@@ -2732,6 +4377,11 @@ Model* lovrModelCreate(const ModelInfo* info) {
     vertexCursor += primitive->attributes[ATTR_POSITION]->count;
   }
 
+  // Bounding boxes (min/max pairs like ModelData's bounding box), used for view culling
+  model->boundingBoxes = malloc(6 * sizeof(float) * data->primitiveCount);
+  model->nodeBoundingBoxes = malloc(6 * sizeof(float) * data->nodeCount);
+  lovrAssert(model->boundingBoxes && model->nodeBoundingBoxes, "Out of memory");
+
   // Vertices
   for (uint32_t i = 0; i < data->primitiveCount; i++) {
     ModelPrimitive* primitive = &data->primitives[map[i] & ~0u];
@@ -2740,6 +4390,19 @@ Model* lovrModelCreate(const ModelInfo* info) {
     size_t stride = sizeof(ModelVertex);
 
     lovrModelDataCopyAttribute(data, attributes[ATTR_POSITION], vertices + 0, F32, 3, false, count, stride, 0);
+
+    float* box = model->boundingBoxes + 6 * (map[i] & ~0u);
+    box[0] = box[2] = box[4] = FLT_MAX;
+    box[1] = box[3] = box[5] = -FLT_MAX;
+    for (uint32_t j = 0; j < count; j++) {
+      float* position = (float*) (vertices + j * stride);
+      box[0] = MIN(box[0], position[0]);
+      box[1] = MAX(box[1], position[0]);
+      box[2] = MIN(box[2], position[1]);
+      box[3] = MAX(box[3], position[1]);
+      box[4] = MIN(box[4], position[2]);
+      box[5] = MAX(box[5], position[2]);
+    }
     lovrModelDataCopyAttribute(data, attributes[ATTR_NORMAL], vertices + 12, F32, 3, false, count, stride, 0);
     lovrModelDataCopyAttribute(data, attributes[ATTR_UV], vertices + 24, F32, 2, false, count, stride, 0);
     lovrModelDataCopyAttribute(data, attributes[ATTR_COLOR], vertices + 32, U8, 4, true, count, stride, 255);
@@ -2759,6 +4422,20 @@ Model* lovrModelCreate(const ModelInfo* info) {
     }
   }
 
+  for (uint32_t i = 0; i < data->nodeCount; i++) {
+    ModelNode* node = &data->nodes[i];
+    float* box = model->nodeBoundingBoxes + 6 * i;
+    box[0] = box[2] = box[4] = FLT_MAX;
+    box[1] = box[3] = box[5] = -FLT_MAX;
+    for (uint32_t j = 0; j < node->primitiveCount; j++) {
+      float* primitiveBox = model->boundingBoxes + 6 * (node->primitiveIndex + j);
+      for (uint32_t k = 0; k < 6; k += 2) {
+        box[k + 0] = MIN(box[k + 0], primitiveBox[k + 0]);
+        box[k + 1] = MAX(box[k + 1], primitiveBox[k + 1]);
+      }
+    }
+  }
+
   for (uint32_t i = 0; i < data->skinCount; i++) {
     lovrCheck(data->skins[i].jointCount <= 256, "Currently, the max number of joints per skin is 256");
   }
@@ -2788,6 +4465,8 @@ void lovrModelDestroy(void* ref) {
   lovrRelease(model->info.data, lovrModelDataDestroy);
   free(model->localTransforms);
   free(model->globalTransforms);
+  free(model->boundingBoxes);
+  free(model->nodeBoundingBoxes);
   free(model->draws);
   free(model->materials);
   free(model->textures);
@@ -2973,19 +4652,19 @@ static void lovrModelReskin(Model* model) {
     return;
   }
 
-  if (!state.animator) {
-    state.animator = lovrShaderCreate(&(ShaderInfo) {
-      .type = SHADER_COMPUTE,
-      .source[0] = { lovr_shader_animator_comp, sizeof(lovr_shader_animator_comp) },
-      .flags = &(ShaderFlag) { NULL, 0, state.device.subgroupSize },
-      .flagCount = 1,
-      .label = "animator"
-    });
-  }
+  lovrProfileBegin("reskin");
+
+  Shader* animator = getBuiltinShader(&state.animator, &(ShaderInfo) {
+    .type = SHADER_COMPUTE,
+    .source[0] = { lovr_shader_animator_comp, sizeof(lovr_shader_animator_comp) },
+    .flags = &(ShaderFlag) { NULL, 0, state.device.subgroupSize },
+    .flagCount = 1,
+    .label = "animator"
+  });
 
-  gpu_pipeline* pipeline = state.pipelines.data[state.animator->computePipelineIndex];
-  gpu_layout* layout = state.layouts.data[state.animator->layout].gpu;
-  gpu_shader* shader = state.animator->gpu;
+  lock();
+  gpu_pipeline* pipeline = state.pipelines.data[animator->computePipelineIndex];
+  gpu_shader* shader = animator->gpu;
   gpu_buffer* joints = tempAlloc(gpu_sizeof_buffer());
 
   uint32_t count = data->skinnedVertexCount;
@@ -3010,9 +4689,7 @@ static void lovrModelReskin(Model* model) {
       joint += 16;
     }
 
-    gpu_bundle* bundle = getBundle(state.animator->layout);
-    gpu_bundle_info bundleInfo = { layout, bindings, COUNTOF(bindings) };
-    gpu_bundle_write(&bundle, &bundleInfo, 1);
+    gpu_bundle* bundle = getBundle(animator->layout, bindings, COUNTOF(bindings));
 
     uint32_t constants[] = { baseVertex, skin->vertexCount };
     uint32_t subgroupSize = state.device.subgroupSize;
@@ -3028,6 +4705,8 @@ static void lovrModelReskin(Model* model) {
 
   model->lastReskin = state.tick;
   state.hasReskin = true;
+  unlock();
+  lovrProfileEnd("reskin");
 }
 
 // Readback
@@ -3174,26 +4853,23 @@ static void lovrTallyResolve(Tally* tally, uint32_t index, uint32_t count, gpu_b
     .clear = GPU_CACHE_STORAGE_READ
   }, 1);
 
-  if (!state.timeWizard) {
-    state.timeWizard = lovrShaderCreate(&(ShaderInfo) {
-      .type = SHADER_COMPUTE,
-      .source[0] = { lovr_shader_timewizard_comp, sizeof(lovr_shader_timewizard_comp) },
-      .label = "timewizard"
-    });
-  }
+  Shader* timeWizard = getBuiltinShader(&state.timeWizard, &(ShaderInfo) {
+    .type = SHADER_COMPUTE,
+    .source[0] = { lovr_shader_timewizard_comp, sizeof(lovr_shader_timewizard_comp) },
+    .label = "timewizard"
+  });
 
-  gpu_pipeline* pipeline = state.pipelines.data[state.timeWizard->computePipelineIndex];
-  gpu_layout* layout = state.layouts.data[state.timeWizard->layout].gpu;
-  gpu_shader* shader = state.timeWizard->gpu;
+  lock();
+  gpu_pipeline* pipeline = state.pipelines.data[timeWizard->computePipelineIndex];
+  gpu_shader* shader = timeWizard->gpu;
+  unlock();
 
   gpu_binding bindings[] = {
     [0] = { 0, GPU_SLOT_STORAGE_BUFFER, .buffer = { tally->buffer, 0, count * 2 * tally->info.views * sizeof(uint32_t) } },
     [1] = { 1, GPU_SLOT_STORAGE_BUFFER, .buffer = { buffer, offset, count * sizeof(uint32_t) } }
   };
 
-  gpu_bundle* bundle = getBundle(state.timeWizard->layout);
-  gpu_bundle_info bundleInfo = { layout, bindings, COUNTOF(bindings) };
-  gpu_bundle_write(&bundle, &bundleInfo, 1);
+  gpu_bundle* bundle = getBundle(timeWizard->layout, bindings, COUNTOF(bindings));
 
   struct { uint32_t first, count, views; float period; } constants = {
     .first = index,
@@ -3210,6 +4886,43 @@ static void lovrTallyResolve(Tally* tally, uint32_t index, uint32_t count, gpu_b
   gpu_compute_end(stream);
 }
 
+// Batch
+
+Batch* lovrBatchCreate(void) {
+  Batch* batch = calloc(1, sizeof(Batch));
+  lovrAssert(batch, "Out of memory");
+  batch->ref = 1;
+  arr_init(&batch->draws, realloc);
+  return batch;
+}
+
+void lovrBatchDestroy(void* ref) {
+  Batch* batch = ref;
+  lovrBatchClear(batch);
+  arr_free(&batch->draws);
+  free(batch);
+}
+
+uint32_t lovrBatchGetCount(Batch* batch) {
+  return (uint32_t) batch->draws.length;
+}
+
+void lovrBatchClear(Batch* batch) {
+  lovrCheck(!batch->pass, "Unable to clear a Batch while it is being recorded");
+
+  for (size_t i = 0; i < batch->draws.length; i++) {
+    BatchDraw* draw = &batch->draws.data[i];
+    lovrRelease(draw->shader, lovrShaderDestroy);
+    lovrRelease(draw->material, lovrMaterialDestroy);
+    lovrRelease(draw->vertex.buffer, lovrBufferDestroy);
+    lovrRelease(draw->index.buffer, lovrBufferDestroy);
+  }
+
+  arr_clear(&batch->draws);
+  lovrRelease(batch->buffer, lovrBufferDestroy);
+  batch->buffer = NULL;
+}
+
 // Pass
 
 static void lovrPassCheckValid(Pass* pass) {
@@ -3251,7 +4964,33 @@ Pass* lovrGraphicsGetPass(PassInfo* info) {
   pass->ref = 1;
   pass->tick = state.tick;
   pass->info = *info;
-  pass->stream = gpu_stream_begin(pass->info.label);
+  pass->stream = NULL;
+
+  // Async compute passes fall back to the main queue if there isn't a separate compute queue
+  if (info->type == PASS_COMPUTE && info->async) {
+    pass->stream = gpu_stream_begin_compute(pass->info.label);
+  }
+
+  pass->info.async = !!pass->stream;
+
+  if (!pass->stream) {
+    pass->stream = gpu_stream_begin(pass->info.label);
+  }
+
+  // Async passes aren't timed, since the compute queue isn't required to support timestamps
+  uint32_t frameIndex = state.tick % COUNTOF(state.timingFrames);
+  TimingFrame* frame = &state.timingFrames[frameIndex];
+  pass->timingIndex = ~0u;
+
+  if (state.timing && !pass->info.async && frame->tick == state.tick && frame->count < MAX_PASSES) {
+    static const char* types[] = { [PASS_RENDER] = "render", [PASS_COMPUTE] = "compute", [PASS_TRANSFER] = "transfer" };
+    const char* label = pass->info.label ? pass->info.label : types[pass->info.type];
+    pass->timingIndex = frame->count++;
+    char* name = frame->names[pass->timingIndex];
+    strncpy(name, label, sizeof(frame->names[0]) - 1);
+    name[sizeof(frame->names[0]) - 1] = '\0';
+    gpu_tally_mark(pass->stream, state.timingTally, (frameIndex * MAX_PASSES + pass->timingIndex) * 2);
+  }
 
   pass->transformIndex = 0;
   pass->transform = tempAlloc(MAX_TRANSFORMS * 16 * sizeof(float));
@@ -3268,6 +5007,13 @@ Pass* lovrGraphicsGetPass(PassInfo* info) {
   pass->bindingMask = 0;
   pass->bindingsDirty = true;
 
+  pass->run.instances = 0;
+  pass->sorting = false;
+  pass->prewarm = false;
+  pass->bindsSaved = 0;
+  memset(&pass->stats, 0, sizeof(pass->stats));
+  pass->deferredShader = NULL;
+
   pass->width = 0;
   pass->height = 0;
   pass->viewCount = 0;
@@ -3399,6 +5145,7 @@ Pass* lovrGraphicsGetPass(PassInfo* info) {
   uint32_t scissor[4] = { 0, 0, pass->width, pass->height };
 
   pass->pipeline->mode = MESH_TRIANGLES;
+  pass->pipeline->viewCull = false;
   memcpy(pass->pipeline->color, color, sizeof(color));
   memcpy(pass->pipeline->viewport, viewport, sizeof(viewport));
   memcpy(pass->pipeline->depthRange, depthRange, sizeof(depthRange));
@@ -3443,9 +5190,12 @@ Pass* lovrGraphicsGetPass(PassInfo* info) {
   pass->drawCount = 0;
 
   pass->builtins[0] = (gpu_binding) { 0, GPU_SLOT_UNIFORM_BUFFER, .buffer = globals };
-  pass->builtins[1] = (gpu_binding) { 1, GPU_SLOT_UNIFORM_BUFFER, .buffer = cameras };
-  pass->builtins[2] = (gpu_binding) { 2, GPU_SLOT_UNIFORM_BUFFER, .buffer = draws };
+  pass->builtins[1] = (gpu_binding) { 1, GPU_SLOT_UNIFORM_BUFFER_DYNAMIC, .buffer = cameras };
+  pass->builtins[2] = (gpu_binding) { 2, GPU_SLOT_UNIFORM_BUFFER_DYNAMIC, .buffer = draws };
   pass->builtins[3] = (gpu_binding) { 3, GPU_SLOT_SAMPLER, .sampler = NULL };
+  pass->builtinBuffers[0] = tempAlloc(gpu_sizeof_buffer());
+  pass->builtinBuffers[1] = tempAlloc(gpu_sizeof_buffer());
+  pass->builtinBundle = NULL;
 
   Globals* global = gpu_map(pass->builtins[0].buffer.object, sizeof(Globals), state.limits.uniformBufferAlign, GPU_MAP_STREAM);
 
@@ -3518,6 +5268,15 @@ void lovrPassGetClear(Pass* pass, float color[4][4], float* depth, uint8_t* sten
 void lovrPassReset(Pass* pass) {
 }
 
+uint32_t lovrPassGetBindsSaved(Pass* pass) {
+  return pass->bindsSaved;
+}
+
+// Barriers are counted when the Pass is submitted
+const PassStats* lovrPassGetStats(Pass* pass) {
+  return &pass->stats;
+}
+
 void lovrPassGetViewMatrix(Pass* pass, uint32_t index, float viewMatrix[16]) {
   lovrCheck(index < pass->viewCount, "Trying to use view '%d', but Pass view count is %d", index + 1, pass->viewCount);
   mat4_init(viewMatrix, pass->cameras[index].view);
@@ -3525,6 +5284,7 @@ void lovrPassGetViewMatrix(Pass* pass, uint32_t index, float viewMatrix[16]) {
 
 void lovrPassSetViewMatrix(Pass* pass, uint32_t index, float viewMatrix[16]) {
   lovrCheck(index < pass->viewCount, "Trying to use view '%d', but Pass view count is %d", index + 1, pass->viewCount);
+  flushDeferredDraws(pass);
   mat4_init(pass->cameras[index].view, viewMatrix);
   pass->cameraDirty = true;
 }
@@ -3536,6 +5296,7 @@ void lovrPassGetProjection(Pass* pass, uint32_t index, float projection[16]) {
 
 void lovrPassSetProjection(Pass* pass, uint32_t index, float projection[16]) {
   lovrCheck(index < pass->viewCount, "Trying to use view '%d', but Pass view count is %d", index + 1, pass->viewCount);
+  flushDeferredDraws(pass);
   mat4_init(pass->cameras[index].projection, projection);
   pass->cameraDirty = true;
 
@@ -3573,6 +5334,15 @@ void lovrPassPop(Pass* pass, StackType stack) {
       pass->transform -= 16;
       break;
     case STACK_STATE:
+      if (pass->pipelineIndex > 0) {
+        Pipeline* previous = pass->pipeline - 1;
+        bool viewportChanged = memcmp(pass->pipeline->viewport, previous->viewport, sizeof(previous->viewport));
+        bool depthRangeChanged = memcmp(pass->pipeline->depthRange, previous->depthRange, sizeof(previous->depthRange));
+        bool scissorChanged = memcmp(pass->pipeline->scissor, previous->scissor, sizeof(previous->scissor));
+        if (viewportChanged || depthRangeChanged || scissorChanged) {
+          flushDeferredDraws(pass);
+        }
+      }
       lovrRelease(pass->pipeline->font, lovrFontDestroy);
       lovrRelease(pass->pipeline->sampler, lovrSamplerDestroy);
       lovrRelease(pass->pipeline->shader, lovrShaderDestroy);
@@ -3769,10 +5539,50 @@ void lovrPassSetSampler(Pass* pass, Sampler* sampler) {
 }
 
 void lovrPassSetScissor(Pass* pass, uint32_t scissor[4]) {
-  if (pass->info.type == PASS_RENDER) gpu_set_scissor(pass->stream, scissor);
+  if (pass->info.type == PASS_RENDER) {
+    if (memcmp(pass->pipeline->scissor, scissor, 4 * sizeof(uint32_t))) {
+      flushDeferredDraws(pass);
+    }
+
+    flushShapeRun(pass);
+    gpu_set_scissor(pass->stream, scissor);
+  }
+
   memcpy(pass->pipeline->scissor, scissor, 4 * sizeof(uint32_t));
 }
 
+// Assign default bindings to any slots used by the shader that are missing resources
+static void bindDefaultResources(Pass* pass, Shader* shader) {
+  uint32_t shaderSlots = (shader->bufferMask | shader->textureMask | shader->samplerMask);
+  uint32_t missingResources = shaderSlots & ~pass->bindingMask;
+
+  if (missingResources) {
+    for (uint32_t i = 0; i < 32; i++) { // TODO biterationtrinsics
+      uint32_t bit = (1u << i);
+
+      if (~missingResources & bit) {
+        continue;
+      }
+
+      pass->bindings[i].number = i;
+
+      if (shader->bufferMask & bit) {
+        pass->bindings[i].buffer.object = state.defaultBuffer->gpu;
+        pass->bindings[i].buffer.offset = 0;
+        pass->bindings[i].buffer.extent = state.defaultBuffer->size;
+      } else if (shader->textureMask & bit) {
+        pass->bindings[i].texture = state.defaultTexture->gpu;
+      } else if (shader->samplerMask & bit) {
+        pass->bindings[i].sampler = state.defaultSamplers[FILTER_LINEAR]->gpu;
+      }
+
+      pass->bindingMask |= bit;
+    }
+
+    pass->bindingsDirty = true;
+  }
+}
+
 void lovrPassSetShader(Pass* pass, Shader* shader) {
   Shader* previous = pass->pipeline->shader;
   if (shader == previous) return;
@@ -3795,35 +5605,7 @@ void lovrPassSetShader(Pass* pass, Shader* shader) {
       }
     }
 
-    uint32_t shaderSlots = (shader->bufferMask | shader->textureMask | shader->samplerMask);
-    uint32_t missingResources = shaderSlots & ~pass->bindingMask;
-
-    // Assign default bindings to any slots used by the shader that are missing resources
-    if (missingResources) {
-      for (uint32_t i = 0; i < 32; i++) { // TODO biterationtrinsics
-        uint32_t bit = (1u << i);
-
-        if (~missingResources & bit) {
-          continue;
-        }
-
-        pass->bindings[i].number = i;
-
-        if (shader->bufferMask & bit) {
-          pass->bindings[i].buffer.object = state.defaultBuffer->gpu;
-          pass->bindings[i].buffer.offset = 0;
-          pass->bindings[i].buffer.extent = state.defaultBuffer->size;
-        } else if (shader->textureMask & bit) {
-          pass->bindings[i].texture = state.defaultTexture->gpu;
-        } else if (shader->samplerMask & bit) {
-          pass->bindings[i].sampler = state.defaultSamplers[FILTER_LINEAR]->gpu;
-        }
-
-        pass->bindingMask |= bit;
-      }
-
-      pass->bindingsDirty = true;
-    }
+    bindDefaultResources(pass, shader);
 
     pass->pipeline->info.shader = shader->gpu;
     pass->pipeline->info.flags = shader->flags;
@@ -3842,6 +5624,18 @@ void lovrPassSetShader(Pass* pass, Shader* shader) {
   }
 }
 
+void lovrPassSetPrewarm(Pass* pass, bool prewarm) {
+  pass->prewarm = prewarm;
+}
+
+void lovrPassSetSorting(Pass* pass, bool sorting) {
+  if (!sorting) {
+    flushDeferredDraws(pass);
+  }
+
+  pass->sorting = sorting;
+}
+
 void lovrPassSetStencilTest(Pass* pass, CompareMode test, uint8_t value, uint8_t mask) {
   TextureFormat depthFormat = pass->info.canvas.depth.texture ? pass->info.canvas.depth.texture->info.format : pass->info.canvas.depth.format;
   lovrCheck(depthFormat == FORMAT_D32FS8 || depthFormat == FORMAT_D24S8, "Trying to set stencil test when no stencil buffer exists");
@@ -3882,11 +5676,23 @@ void lovrPassSetStencilWrite(Pass* pass, StencilAction actions[3], uint8_t value
 }
 
 void lovrPassSetViewport(Pass* pass, float viewport[4], float depthRange[2]) {
-  if (pass->info.type == PASS_RENDER) gpu_set_viewport(pass->stream, viewport, depthRange);
+  if (pass->info.type == PASS_RENDER) {
+    if (memcmp(pass->pipeline->viewport, viewport, 4 * sizeof(float)) || memcmp(pass->pipeline->depthRange, depthRange, 2 * sizeof(float))) {
+      flushDeferredDraws(pass);
+    }
+
+    flushShapeRun(pass);
+    gpu_set_viewport(pass->stream, viewport, depthRange);
+  }
+
   memcpy(pass->pipeline->viewport, viewport, 4 * sizeof(float));
   memcpy(pass->pipeline->depthRange, depthRange, 2 * sizeof(float));
 }
 
+void lovrPassSetViewCull(Pass* pass, bool enable) {
+  pass->pipeline->viewCull = enable;
+}
+
 void lovrPassSetWinding(Pass* pass, Winding winding) {
   if (pass->viewCount > 0 && pass->cameras[0].projection[5] > 0.f) { // Handedness change needs winding flip
     winding = !winding;
@@ -3965,7 +5771,7 @@ void lovrPassSendTexture(Pass* pass, const char* name, size_t length, uint32_t s
     lovrCheck(texture->info.usage & TEXTURE_SAMPLE, "Textures must be created with the 'sample' usage to send them to sampler variables in shaders");
   }
 
-  pass->bindings[slot].texture = texture->gpu;
+  pass->bindings[slot].texture = (shader->storageMask & (1u << slot)) ? texture->gpu : getSampleView(texture);
   pass->bindingMask |= (1u << slot);
   pass->bindingsDirty = true;
 
@@ -4014,7 +5820,8 @@ void lovrPassSendValue(Pass* pass, const char* name, size_t length, void** data,
   lovrThrow("Shader has no push constant named '%s'", name);
 }
 
-static void bindPipeline(Pass* pass, Draw* draw, Shader* shader) {
+// Updates the pipeline state for a draw, returning true if it resolved to a different pipeline
+static bool resolvePipeline(Pass* pass, Draw* draw, Shader* shader) {
   Pipeline* pipeline = pass->pipeline;
 
   if (pipeline->info.drawMode != (gpu_draw_mode) draw->mode) {
@@ -4029,8 +5836,8 @@ static void bindPipeline(Pass* pass, Draw* draw, Shader* shader) {
     pipeline->dirty = true;
   }
 
-  // Vertex formats
-  if (draw->vertex.buffer && pipeline->formatHash != draw->vertex.buffer->hash) {
+  // Vertex formats (instanced vertex data always uses its builtin format, even from a Buffer)
+  if (draw->vertex.buffer && !draw->vertex.instanced && pipeline->formatHash != draw->vertex.buffer->hash) {
     pipeline->formatHash = draw->vertex.buffer->hash;
     pipeline->info.vertex.bufferCount = 2;
     pipeline->info.vertex.attributeCount = shader->attributeCount;
@@ -4066,14 +5873,19 @@ static void bindPipeline(Pass* pass, Draw* draw, Shader* shader) {
         };
       }
     }
-  } else if (!draw->vertex.buffer && pipeline->formatHash != 1 + draw->vertex.format) {
+  } else if ((!draw->vertex.buffer || draw->vertex.instanced) && pipeline->formatHash != 1 + draw->vertex.format) {
     pipeline->formatHash = 1 + draw->vertex.format;
     pipeline->info.vertex = state.vertexFormats[draw->vertex.format];
     pipeline->dirty = true;
 
     if (shader->hasCustomAttributes) {
       for (uint32_t i = 0; i < shader->attributeCount; i++) {
-        if (shader->attributes[i].location < 10) {
+        bool found = false;
+        for (uint32_t j = 0; j < pipeline->info.vertex.attributeCount; j++) {
+          found |= pipeline->info.vertex.attributes[j].location == shader->attributes[i].location;
+        }
+
+        if (shader->attributes[i].location < 10 && !found) {
           pipeline->info.vertex.attributes[pipeline->info.vertex.attributeCount++] = (gpu_attribute) {
             .buffer = 1,
             .location = shader->attributes[i].location,
@@ -4086,101 +5898,235 @@ static void bindPipeline(Pass* pass, Draw* draw, Shader* shader) {
   }
 
   if (!pipeline->dirty) {
-    return;
+    pass->stats.pipelineHits++;
+    return false;
   }
 
+  pass->stats.pipelineMisses++;
   uint64_t hash = hash64(&pipeline->info, sizeof(pipeline->info));
-  uint64_t index = map_get(&state.pipelineLookup, hash);
 
-  if (index == MAP_NIL) {
-    gpu_pipeline* gpu = malloc(gpu_sizeof_pipeline());
-    lovrAssert(gpu, "Out of memory");
-    gpu_pipeline_init_graphics(gpu, &pipeline->info);
-    index = state.pipelines.length;
-    arr_push(&state.pipelines, gpu);
-    map_set(&state.pipelineLookup, hash, index);
+  // Pipelines are compiled in the background when prewarming or when async pipelines are enabled.
+  // Batches need every draw, so they always wait for their pipelines.
+  bool async = pass->prewarm || (state.config.asyncPipelines && !pass->batch);
+
+  lock();
+  uint64_t index = map_get(&state.pipelineLookup, hash);
+  gpu_pipeline* gpu = index == MAP_NIL ? NULL : state.pipelines.data[index];
+  unlock();
+
+  // New pipelines are compiled outside of the lock, since compiling can fail.  If another thread
+  // made the same pipeline in the meantime, this one is thrown away.
+  if (!gpu) {
+    gpu_pipeline* created = calloc(1, gpu_sizeof_pipeline());
+    lovrAssert(created, "Out of memory");
+
+    async = async && startPipelineCompilers();
+
+    if (!async) {
+      lovrProfileBegin("pipeline");
+      gpu_pipeline_init_graphics(created, &pipeline->info);
+      lovrProfileEnd("pipeline");
+    }
+
+    lock();
+    index = map_get(&state.pipelineLookup, hash);
+
+    if (index == MAP_NIL) {
+      map_set(&state.pipelineLookup, hash, state.pipelines.length);
+      arr_push(&state.pipelines, created);
+      if (async) queuePipeline(created, &pipeline->info, shader);
+      pass->stats.pipelinesCreated++;
+      gpu = created;
+      unlock();
+    } else {
+      gpu = state.pipelines.data[index];
+      unlock();
+      if (!async) gpu_pipeline_destroy(created);
+      free(created);
+    }
+  }
+
+  // While a pipeline is compiling, the Pipeline stays dirty so the draws after it check it again
+  if (isPipelinePending(gpu)) {
+    if (async) {
+      pass->boundPipeline = NULL;
+      return true;
+    }
+
+    waitForPipeline(gpu);
   }
 
-  gpu_bind_pipeline(pass->stream, state.pipelines.data[index], false);
+  pass->boundPipeline = gpu;
   pipeline->dirty = false;
+  return true;
 }
 
-static void bindBundles(Pass* pass, Draw* draw, Shader* shader) {
-  size_t stack = tempPush();
-
-  gpu_bundle* bundles[3];
-  uint32_t bundleMask = 0;
+static void bindPipeline(Pass* pass, Draw* draw, Shader* shader) {
+  if (resolvePipeline(pass, draw, shader) && pass->boundPipeline) {
+    flushShapeRun(pass);
+    gpu_bind_pipeline(pass->stream, pass->boundPipeline, false);
+  }
+}
 
-  // Set 0 - Builtins
-  if (pass->info.type == PASS_RENDER) {
-    bool builtinsDirty = false;
-
-    if (pass->cameraDirty) {
-      for (uint32_t i = 0; i < pass->viewCount; i++) {
-        mat4_init(pass->cameras[i].viewProjection, pass->cameras[i].projection);
-        mat4_init(pass->cameras[i].inverseProjection, pass->cameras[i].projection);
-        mat4_mul(pass->cameras[i].viewProjection, pass->cameras[i].view);
-        mat4_invert(pass->cameras[i].inverseProjection);
-      }
+static void writeDrawData(Pass* pass, Draw* draw, DrawData* data) {
+  float m[16];
+  float* transform;
+  if (draw->transform) {
+    transform = mat4_mul(mat4_init(m, pass->transform), draw->transform);
+  } else {
+    transform = pass->transform;
+  }
 
-      uint32_t size = pass->viewCount * sizeof(Camera);
-      void* data = gpu_map(pass->builtins[1].buffer.object, size, state.limits.uniformBufferAlign, GPU_MAP_STREAM);
-      memcpy(data, pass->cameras, size);
-      pass->cameraDirty = false;
-      builtinsDirty = true;
+  float cofactor[16];
+  mat4_init(cofactor, transform);
+  cofactor[12] = 0.f;
+  cofactor[13] = 0.f;
+  cofactor[14] = 0.f;
+  cofactor[15] = 1.f;
+  mat4_cofactor(cofactor);
+
+  // The normal matrix is only used as a mat3, so bindless mode stores the material index in the
+  // last element
+  if (state.features.bindless) {
+    Material* material = draw->material ? draw->material : pass->pipeline->material;
+    material = material ? material : state.defaultMaterial;
+    uint32_t id = material->block * MATERIALS_PER_BLOCK + material->index;
+    memcpy(&cofactor[15], &id, sizeof(id));
+  }
+
+  memcpy(data->transform, transform, 64);
+  memcpy(data->cofactor, cofactor, 64);
+  memcpy(data->color, pass->pipeline->color, 16);
+}
+
+// Cameras and draw data are bound with dynamic offsets relative to the buffer the builtin bundle was
+// written with.  The bundle only has to be rewritten if the stream buffer was replaced.
+static void rebaseBuiltin(Pass* pass, uint32_t index) {
+  gpu_buffer* buffer = pass->builtinBuffers[index - 1];
+  gpu_buffer* base = pass->builtins[index].buffer.object;
+
+  if (!pass->builtinBundle || !gpu_rebase(buffer, base, &pass->builtinOffsets[index - 1])) {
+    pass->builtins[index].buffer.object = buffer;
+    pass->builtinBuffers[index - 1] = base;
+    pass->builtinOffsets[index - 1] = 0;
+    pass->builtinBundle = NULL;
+  }
+}
+
+// Updates the camera, draw data, and sampler builtins, returning whether they need to be rebound
+static bool updateBuiltins(Pass* pass) {
+  bool builtinsDirty = false;
+
+  if (pass->cameraDirty) {
+    for (uint32_t i = 0; i < pass->viewCount; i++) {
+      mat4_init(pass->cameras[i].viewProjection, pass->cameras[i].projection);
+      mat4_init(pass->cameras[i].inverseProjection, pass->cameras[i].projection);
+      mat4_mul(pass->cameras[i].viewProjection, pass->cameras[i].view);
+      mat4_invert(pass->cameras[i].inverseProjection);
     }
 
-    if (pass->drawCount % 256 == 0) {
-      uint32_t size = 256 * sizeof(DrawData);
-      pass->drawData = gpu_map(pass->builtins[2].buffer.object, size, state.limits.uniformBufferAlign, GPU_MAP_STREAM);
-      builtinsDirty = true;
-    }
+    uint32_t size = pass->viewCount * sizeof(Camera);
+    void* data = gpu_map(pass->builtinBuffers[0], size, state.limits.uniformBufferAlign, GPU_MAP_STREAM);
+    memcpy(data, pass->cameras, size);
+    rebaseBuiltin(pass, 1);
+    pass->cameraDirty = false;
+    builtinsDirty = true;
+  }
+
+  if (pass->drawCount % 256 == 0) {
+    uint32_t size = 256 * sizeof(DrawData);
+    pass->drawData = gpu_map(pass->builtinBuffers[1], size, state.limits.uniformBufferAlign, GPU_MAP_STREAM);
+    rebaseBuiltin(pass, 2);
+    builtinsDirty = true;
+  }
 
-    if (pass->samplerDirty) {
-      Sampler* sampler = pass->pipeline->sampler ? pass->pipeline->sampler : state.defaultSamplers[FILTER_LINEAR];
+  // A dirty sampler always rebinds the builtins, since that's also used to restore descriptor sets
+  // that were disturbed, but the bundle is only rewritten if the sampler actually changed
+  if (pass->samplerDirty) {
+    Sampler* sampler = pass->pipeline->sampler ? pass->pipeline->sampler : state.defaultSamplers[FILTER_LINEAR];
+    if (pass->builtins[3].sampler != sampler->gpu) {
       pass->builtins[3].sampler = sampler->gpu;
-      pass->samplerDirty = false;
-      builtinsDirty = true;
+      pass->builtinBundle = NULL;
     }
+    pass->samplerDirty = false;
+    builtinsDirty = true;
+  }
 
-    if (builtinsDirty) {
-      gpu_bundle_info bundleInfo = {
-        .layout = state.layouts.data[state.builtinLayout].gpu,
-        .bindings = pass->builtins,
-        .count = COUNTOF(pass->builtins)
-      };
+  if (!pass->builtinBundle) {
+    pass->builtinBundle = getBundle(state.builtinLayout, pass->builtins, COUNTOF(pass->builtins));
+    pass->stats.bundleWrites++;
+    builtinsDirty = true;
+  }
 
-      bundles[0] = getBundle(state.builtinLayout);
-      gpu_bundle_write(&bundles[0], &bundleInfo, 1);
-      bundleMask |= (1 << 0);
-    }
+  return builtinsDirty;
+}
 
-    // Draw data
+static gpu_bundle* getResourceBundle(Pass* pass, Shader* shader) {
+  size_t stack = tempPush();
+  gpu_binding* bindings = tempAlloc(shader->resourceCount * sizeof(gpu_binding));
 
-    float m[16];
-    float* transform;
-    if (draw->transform) {
-      transform = mat4_mul(mat4_init(m, pass->transform), draw->transform);
-    } else {
-      transform = pass->transform;
+  for (uint32_t i = 0; i < shader->resourceCount; i++) {
+    bindings[i] = pass->bindings[shader->resources[i].binding];
+    bindings[i].type = shader->resources[i].type;
+  }
+
+  gpu_bundle* bundle = getBundle(shader->layout, bindings, shader->resourceCount);
+  pass->stats.bundleWrites++;
+  pass->bindingsDirty = false;
+  tempPop(stack);
+  return bundle;
+}
+
+// Binds the contiguous range of descriptor sets covering all of the bits in the mask
+static void bindBundleMask(Pass* pass, Shader* shader, gpu_bundle** bundles, uint32_t bundleMask) {
+  if (bundleMask) {
+    uint32_t first = 0;
+    while (~bundleMask & 0x1) {
+      bundleMask >>= 1;
+      first++;
     }
 
-    float cofactor[16];
-    mat4_init(cofactor, transform);
-    cofactor[12] = 0.f;
-    cofactor[13] = 0.f;
-    cofactor[14] = 0.f;
-    cofactor[15] = 1.f;
-    mat4_cofactor(cofactor);
+    uint32_t count = 0;
+    while (bundleMask) {
+      bundleMask >>= 1;
+      count++;
+    }
 
-    memcpy(pass->drawData->transform, transform, 64);
-    memcpy(pass->drawData->cofactor, cofactor, 64);
-    memcpy(pass->drawData->color, pass->pipeline->color, 16);
-    pass->drawData++;
+    // The builtin set has dynamic offsets for the cameras and draw data
+    bool builtins = first == 0 && pass->info.type == PASS_RENDER;
+    uint32_t* offsets = builtins ? pass->builtinOffsets : NULL;
+    uint32_t offsetCount = builtins ? COUNTOF(pass->builtinOffsets) : 0;
+
+    flushShapeRun(pass);
+    gpu_bind_bundles(pass->stream, shader->gpu, bundles + first, first, count, offsets, offsetCount);
   }
+}
 
-  // Set 1 - Material
+static void bindBundles(Pass* pass, Draw* draw, Shader* shader) {
+  gpu_bundle* bundles[3];
+  uint32_t bundleMask = 0;
+
+  // Set 0 - Builtins
   if (pass->info.type == PASS_RENDER) {
+    if (updateBuiltins(pass)) {
+      bundles[0] = pass->builtinBundle;
+      bundleMask |= (1 << 0);
+    }
+
+    writeDrawData(pass, draw, pass->drawData++);
+  }
+
+  // Set 1 - Material
+  if (pass->info.type == PASS_RENDER && state.features.bindless) {
+    Material* material = draw->material ? draw->material : pass->pipeline->material;
+    trackMaterial(pass, material ? material : state.defaultMaterial, GPU_PHASE_SHADER_VERTEX | GPU_PHASE_SHADER_FRAGMENT, GPU_CACHE_TEXTURE);
+    bundles[1] = state.bindlessBundle;
+
+    if (pass->materialDirty) {
+      pass->materialDirty = false;
+      bundleMask |= (1 << 1);
+    }
+  } else if (pass->info.type == PASS_RENDER) {
     if (draw->material && draw->material != pass->pipeline->material) {
       trackMaterial(pass, draw->material, GPU_PHASE_SHADER_VERTEX | GPU_PHASE_SHADER_FRAGMENT, GPU_CACHE_TEXTURE);
       pass->materialDirty = true;
@@ -4199,46 +6145,12 @@ static void bindBundles(Pass* pass, Draw* draw, Shader* shader) {
 
   // Set 2 - Resources
   if (pass->bindingsDirty && shader->resourceCount > 0) {
-    gpu_binding* bindings = tempAlloc(shader->resourceCount * sizeof(gpu_binding));
-
-    for (uint32_t i = 0; i < shader->resourceCount; i++) {
-      bindings[i] = pass->bindings[shader->resources[i].binding];
-      bindings[i].type = shader->resources[i].type;
-    }
-
-    gpu_bundle_info info = {
-      .layout = state.layouts.data[shader->layout].gpu,
-      .bindings = bindings,
-      .count = shader->resourceCount
-    };
-
-    gpu_bundle* bundle = getBundle(shader->layout);
-    gpu_bundle_write(&bundle, &info, 1);
-    pass->bindingsDirty = false;
-
     uint32_t set = pass->info.type == PASS_RENDER ? 2 : 0;
+    bundles[set] = getResourceBundle(pass, shader);
     bundleMask |= (1 << set);
-    bundles[set] = bundle;
-  }
-
-  // Bind
-  if (bundleMask) {
-    uint32_t first = 0;
-    while (~bundleMask & 0x1) {
-      bundleMask >>= 1;
-      first++;
-    }
-
-    uint32_t count = 0;
-    while (bundleMask) {
-      bundleMask >>= 1;
-      count++;
-    }
-
-    gpu_bind_bundles(pass->stream, shader->gpu, bundles + first, first, count, NULL, 0);
   }
 
-  tempPop(stack);
+  bindBundleMask(pass, shader, bundles, bundleMask);
 }
 
 static void bindBuffers(Pass* pass, Draw* draw) {
@@ -4248,11 +6160,13 @@ static void bindBuffers(Pass* pass, Draw* draw) {
     cache = &pass->shapeCache[draw->hash & (COUNTOF(pass->shapeCache) - 1)];
     if (cache->hash == draw->hash) {
       if (pass->vertexBuffer != cache->vertices) {
+        flushShapeRun(pass);
         gpu_bind_vertex_buffers(pass->stream, &cache->vertices, NULL, 0, 1);
         pass->vertexBuffer = cache->vertices;
       }
 
       if (pass->indexBuffer != cache->indices) {
+        flushShapeRun(pass);
         gpu_bind_index_buffer(pass->stream, cache->indices, 0, GPU_INDEX_U16);
         pass->indexBuffer = cache->indices;
       }
@@ -4263,6 +6177,8 @@ static void bindBuffers(Pass* pass, Draw* draw) {
     }
   }
 
+  flushShapeRun(pass);
+
   if (!draw->vertex.buffer && draw->vertex.count > 0) {
     lovrCheck(draw->vertex.count < UINT16_MAX, "This draw has too many vertices (max is 65534), try splitting it up into multiple draws or using a Buffer");
     uint32_t stride = state.vertexFormats[draw->vertex.format].bufferStrides[0];
@@ -4270,6 +6186,7 @@ static void bindBuffers(Pass* pass, Draw* draw) {
 
     gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
     *draw->vertex.pointer = gpu_map(scratchpad, size, stride, GPU_MAP_STREAM);
+    pass->stats.vertexBytes += size;
 
     gpu_bind_vertex_buffers(pass->stream, &scratchpad, NULL, 0, 1);
     pass->vertexBuffer = scratchpad;
@@ -4285,6 +6202,7 @@ static void bindBuffers(Pass* pass, Draw* draw) {
 
     gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
     *draw->index.pointer = gpu_map(scratchpad, size, sizeof(uint16_t), GPU_MAP_STREAM);
+    pass->stats.indexBytes += size;
 
     gpu_bind_index_buffer(pass->stream, scratchpad, 0, GPU_INDEX_U16);
     pass->indexBuffer = scratchpad;
@@ -4304,17 +6222,368 @@ static void bindBuffers(Pass* pass, Draw* draw) {
 
 static void pushConstants(Pass* pass, Shader* shader) {
   if (pass->constantsDirty && shader->constantSize > 0) {
+    flushShapeRun(pass);
     gpu_push_constants(pass->stream, shader->gpu, pass->constants, shader->constantSize);
     pass->constantsDirty = false;
   }
 }
 
+// Captures a draw that was just recorded, so it can be replayed later without resolving its state.
+// Temporary vertices/indices are referenced by pointer until the Batch is finished.
+static void recordBatchDraw(Pass* pass, Draw* draw, Shader* shader, uint32_t count, uint32_t instances) {
+  Material* material = draw->material ? draw->material : pass->pipeline->material;
+
+  BatchDraw batchDraw = {
+    .pipeline = pass->boundPipeline,
+    .shader = shader,
+    .material = material ? material : state.defaultMaterial,
+    .vertex.buffer = draw->vertex.buffer,
+    .index.buffer = draw->index.buffer,
+    .indexType = draw->index.buffer && draw->index.buffer->info.stride == 4 ? GPU_INDEX_U32 : GPU_INDEX_U16,
+    .indexed = draw->index.buffer || draw->index.count > 0,
+    .instanced = draw->vertex.instanced,
+    .start = draw->start,
+    .count = count,
+    .instances = instances,
+    .base = draw->base,
+    .data = pass->drawData[-1]
+  };
+
+  if (!draw->vertex.buffer && draw->vertex.count > 0) {
+    batchDraw.vertex.data = *draw->vertex.pointer;
+    batchDraw.vertex.size = draw->vertex.count * state.vertexFormats[draw->vertex.format].bufferStrides[0];
+  }
+
+  if (!draw->index.buffer && draw->index.count > 0) {
+    batchDraw.index.data = *draw->index.pointer;
+    batchDraw.index.size = draw->index.count * sizeof(uint16_t);
+  }
+
+  lovrRetain(batchDraw.shader);
+  lovrRetain(batchDraw.material);
+  lovrRetain(batchDraw.vertex.buffer);
+  lovrRetain(batchDraw.index.buffer);
+  arr_push(&pass->batch->draws, batchDraw);
+}
+
+// Draws are skipped while their pipeline is compiling.  Callers still write vertices and indices
+// after the draw, so they get some temporary memory to write to.
+static void skipDraw(Draw* draw) {
+  if (!draw->vertex.buffer && draw->vertex.count > 0) {
+    *draw->vertex.pointer = tempAlloc(draw->vertex.count * state.vertexFormats[draw->vertex.format].bufferStrides[0]);
+  }
+
+  if (!draw->index.buffer && draw->index.count > 0) {
+    *draw->index.pointer = tempAlloc(draw->index.count * sizeof(uint16_t));
+  }
+}
+
+// In sorted mode, draws are resolved into DeferredDraws up front (pipeline, material, resources,
+// constants, buffers, and draw data) and encoded later by flushDeferredDraws, in sorted order.
+static void deferDraw(Pass* pass, Draw* draw, Shader* shader) {
+  resolvePipeline(pass, draw, shader);
+
+  if (!pass->boundPipeline) {
+    skipDraw(draw);
+    return;
+  }
+
+  Material* material = draw->material ? draw->material : pass->pipeline->material;
+  material = material ? material : state.defaultMaterial;
+  trackMaterial(pass, material, GPU_PHASE_SHADER_VERTEX | GPU_PHASE_SHADER_FRAGMENT, GPU_CACHE_TEXTURE);
+
+  Sampler* sampler = pass->pipeline->sampler ? pass->pipeline->sampler : state.defaultSamplers[FILTER_LINEAR];
+
+  // Resources and constants are snapshotted whenever they change, since they can change again
+  // before the draws are encoded
+  if (shader != pass->deferredShader) {
+    pass->deferredShader = shader;
+    pass->bindingsDirty = true;
+    pass->constantsDirty = true;
+  }
+
+  if (pass->bindingsDirty) {
+    pass->deferredBundle = shader->resourceCount > 0 ? getResourceBundle(pass, shader) : NULL;
+    pass->bindingsDirty = false;
+  }
+
+  if (pass->constantsDirty) {
+    pass->deferredConstants = shader->constantSize > 0 ? tempAlloc(shader->constantSize) : NULL;
+    if (shader->constantSize > 0) memcpy(pass->deferredConstants, pass->constants, shader->constantSize);
+    pass->constantsDirty = false;
+  }
+
+  // Buffers
+  gpu_buffer* vertexBuffer = NULL;
+  gpu_buffer* indexBuffer = NULL;
+  gpu_index_type indexType = GPU_INDEX_U16;
+  Shape* cache = draw->hash ? &pass->shapeCache[draw->hash & (COUNTOF(pass->shapeCache) - 1)] : NULL;
+
+  if (cache && cache->hash == draw->hash) {
+    vertexBuffer = cache->vertices;
+    indexBuffer = cache->indices;
+    *draw->vertex.pointer = NULL;
+    *draw->index.pointer = NULL;
+  } else {
+    if (!draw->vertex.buffer && draw->vertex.count > 0) {
+      lovrCheck(draw->vertex.count < UINT16_MAX, "This draw has too many vertices (max is 65534), try splitting it up into multiple draws or using a Buffer");
+      uint32_t stride = state.vertexFormats[draw->vertex.format].bufferStrides[0];
+      vertexBuffer = tempAlloc(gpu_sizeof_buffer());
+      *draw->vertex.pointer = gpu_map(vertexBuffer, draw->vertex.count * stride, stride, GPU_MAP_STREAM);
+      pass->stats.vertexBytes += draw->vertex.count * stride;
+    } else if (draw->vertex.buffer) {
+      lovrCheck(draw->vertex.buffer->info.stride <= state.limits.vertexBufferStride, "Vertex buffer stride exceeds vertexBufferStride limit");
+      vertexBuffer = draw->vertex.buffer->gpu;
+      trackBuffer(pass, draw->vertex.buffer, GPU_PHASE_INPUT_VERTEX, GPU_CACHE_VERTEX);
+    }
+
+    if (!draw->index.buffer && draw->index.count > 0) {
+      indexBuffer = tempAlloc(gpu_sizeof_buffer());
+      *draw->index.pointer = gpu_map(indexBuffer, draw->index.count * sizeof(uint16_t), sizeof(uint16_t), GPU_MAP_STREAM);
+      pass->stats.indexBytes += draw->index.count * sizeof(uint16_t);
+    } else if (draw->index.buffer) {
+      indexType = draw->index.buffer->info.stride == 4 ? GPU_INDEX_U32 : GPU_INDEX_U16;
+      indexBuffer = draw->index.buffer->gpu;
+      trackBuffer(pass, draw->index.buffer, GPU_PHASE_INPUT_INDEX, GPU_CACHE_INDEX);
+    }
+
+    if (cache) {
+      cache->hash = draw->hash;
+      cache->vertices = vertexBuffer;
+      cache->indices = indexBuffer;
+    }
+  }
+
+  uint32_t defaultCount = draw->index.count > 0 ? draw->index.count : draw->vertex.count;
+
+  DeferredDraw deferred = {
+    .index = (uint32_t) pass->deferred.length,
+    .pipeline = pass->boundPipeline,
+    .shader = shader,
+    .material = material,
+    .sampler = sampler->gpu,
+    .bundle = pass->deferredBundle,
+    .constants = pass->deferredConstants,
+    .vertexBuffer = vertexBuffer,
+    .indexBuffer = indexBuffer,
+    .indexType = indexType,
+    .indexed = draw->index.buffer || draw->index.count > 0,
+    .instanced = draw->vertex.instanced,
+    .hash = draw->hash,
+    .start = draw->start,
+    .count = draw->count > 0 ? draw->count : defaultCount,
+    .instances = MAX(draw->instances, 1),
+    .base = draw->base
+  };
+
+  writeDrawData(pass, draw, &deferred.data);
+  lovrRetain(shader);
+  lovrRetain(material);
+  arr_push(&pass->deferred, deferred);
+}
+
+static int compareDeferredDraws(const void* a, const void* b) {
+  const DeferredDraw* x = a;
+  const DeferredDraw* y = b;
+  if (x->pipeline != y->pipeline) return (uintptr_t) x->pipeline < (uintptr_t) y->pipeline ? -1 : 1;
+  if (x->material != y->material) return (uintptr_t) x->material < (uintptr_t) y->material ? -1 : 1;
+  if (x->vertexBuffer != y->vertexBuffer) return (uintptr_t) x->vertexBuffer < (uintptr_t) y->vertexBuffer ? -1 : 1;
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+static uint32_t countDeferredBinds(DeferredDraw* draws, size_t count) {
+  uint32_t binds = 0;
+  for (size_t i = 1; i < count; i++) {
+    binds += draws[i].pipeline != draws[i - 1].pipeline;
+    binds += draws[i].material != draws[i - 1].material;
+    binds += draws[i].bundle != draws[i - 1].bundle;
+    binds += draws[i].vertexBuffer != draws[i - 1].vertexBuffer;
+    binds += draws[i].indexBuffer != draws[i - 1].indexBuffer;
+  }
+  return binds;
+}
+
+// Sorts the deferred draws by pipeline, material, and vertex buffer, then records them.  Called
+// before anything that has to stay in order relative to draws (viewport/scissor/camera changes,
+// tallies, batches, indirect draws, and the end of the pass).
+static void flushDeferredDraws(Pass* pass) {
+  if (pass->deferred.length == 0) {
+    return;
+  }
+
+  DeferredDraw* draws = pass->deferred.data;
+  size_t count = pass->deferred.length;
+
+  uint32_t before = countDeferredBinds(draws, count);
+  qsort(draws, count, sizeof(DeferredDraw), compareDeferredDraws);
+  uint32_t after = countDeferredBinds(draws, count);
+  pass->bindsSaved += before > after ? before - after : 0;
+
+  flushShapeRun(pass);
+
+  gpu_pipeline* pipeline = NULL;
+  Shader* shader = NULL;
+  gpu_bundle* materialBundle = NULL;
+  gpu_bundle* bundle = NULL;
+  void* constants = NULL;
+  gpu_buffer* vertexBuffer = pass->vertexBuffer;
+  gpu_buffer* indexBuffer = pass->indexBuffer;
+  bool builtinsDisturbed = false;
+
+  // The sampler is tracked per draw, so it is managed here instead of by updateBuiltins
+  pass->samplerDirty = false;
+
+  for (size_t i = 0; i < count; i++) {
+    DeferredDraw* draw = &draws[i];
+    gpu_bundle* bundles[3];
+    uint32_t bundleMask = 0;
+
+    if (draw->pipeline != pipeline) {
+      flushShapeRun(pass);
+      gpu_bind_pipeline(pass->stream, draw->pipeline, false);
+      pipeline = draw->pipeline;
+    }
+
+    // Different push constant ranges disturb the descriptor sets
+    if (draw->shader != shader) {
+      if (!shader || shader->constantSize != draw->shader->constantSize) {
+        builtinsDisturbed = true;
+        materialBundle = NULL;
+        bundle = NULL;
+      }
+
+      shader = draw->shader;
+      constants = NULL;
+    }
+
+    if (pass->builtins[3].sampler != draw->sampler) {
+      pass->builtins[3].sampler = draw->sampler;
+      pass->builtinBundle = NULL;
+    }
+
+    if (updateBuiltins(pass) || builtinsDisturbed) {
+      bundles[0] = pass->builtinBundle;
+      bundleMask |= (1 << 0);
+      builtinsDisturbed = false;
+    }
+
+    memcpy(pass->drawData++, &draw->data, sizeof(DrawData));
+
+    // Bindless materials all share a bundle, so only the draw data changes between materials
+    bundles[1] = draw->material->bundle;
+
+    if (draw->material->bundle != materialBundle) {
+      bundleMask |= (1 << 1);
+      materialBundle = draw->material->bundle;
+    }
+
+    if (draw->bundle && draw->bundle != bundle) {
+      bundles[2] = draw->bundle;
+      bundleMask |= (1 << 2);
+      bundle = draw->bundle;
+    }
+
+    bindBundleMask(pass, shader, bundles, bundleMask);
+
+    if (draw->constants && draw->constants != constants) {
+      flushShapeRun(pass);
+      gpu_push_constants(pass->stream, shader->gpu, draw->constants, shader->constantSize);
+      constants = draw->constants;
+    }
+
+    if (draw->vertexBuffer && draw->vertexBuffer != vertexBuffer) {
+      flushShapeRun(pass);
+      gpu_bind_vertex_buffers(pass->stream, &draw->vertexBuffer, NULL, 0, 1);
+      vertexBuffer = draw->vertexBuffer;
+    }
+
+    if (draw->indexBuffer && draw->indexBuffer != indexBuffer) {
+      flushShapeRun(pass);
+      gpu_bind_index_buffer(pass->stream, draw->indexBuffer, 0, draw->indexType);
+      indexBuffer = draw->indexBuffer;
+    }
+
+    uint32_t id = pass->drawCount & 0xff;
+    ShapeRun* run = &pass->run;
+
+    if (draw->hash && draw->instances == 1 && run->instances > 0 && run->hash == draw->hash && run->id + run->instances == id) {
+      run->instances++;
+    } else if (draw->hash && draw->instances == 1) {
+      flushShapeRun(pass);
+      *run = (ShapeRun) {
+        .hash = draw->hash,
+        .start = draw->start,
+        .count = draw->count,
+        .base = draw->base,
+        .id = id,
+        .instances = 1,
+        .indexed = draw->indexed
+      };
+    } else {
+      flushShapeRun(pass);
+
+      if (draw->indexed) {
+        gpu_draw_indexed(pass->stream, draw->count, draw->instances, draw->start, draw->base, id);
+      } else if (draw->instanced) {
+        gpu_draw(pass->stream, draw->count, draw->instances, id, 0);
+      } else {
+        gpu_draw(pass->stream, draw->count, draw->instances, draw->start, id);
+      }
+    }
+
+    pass->drawCount++;
+    lovrRelease(draw->shader, lovrShaderDestroy);
+    lovrRelease(draw->material, lovrMaterialDestroy);
+  }
+
+  arr_clear(&pass->deferred);
+
+  // Everything bound here needs to be rebound by the next draw
+  pass->pipeline->dirty = true;
+  pass->materialDirty = true;
+  pass->samplerDirty = true;
+  pass->bindingsDirty = true;
+  pass->constantsDirty = true;
+  pass->deferredShader = NULL;
+  pass->vertexBuffer = vertexBuffer;
+  pass->indexBuffer = indexBuffer;
+}
+
 static void lovrPassDraw(Pass* pass, Draw* draw) {
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_RENDER, "This function can only be called on a render pass");
-  Shader* shader = pass->pipeline->shader ? pass->pipeline->shader : lovrGraphicsGetDefaultShader(draw->shader);
+  Shader* shader = pass->pipeline->shader ? pass->pipeline->shader :
+    draw->internalShader ? draw->internalShader :
+    lovrGraphicsGetDefaultShader(draw->shader);
+
+  if (pass->batch) {
+    lovrCheck(!draw->vertex.buffer || !lovrBufferIsTemporary(draw->vertex.buffer), "Temporary Buffers can not be recorded into a Batch");
+    lovrCheck(!draw->index.buffer || !lovrBufferIsTemporary(draw->index.buffer), "Temporary Buffers can not be recorded into a Batch");
+    draw->hash = 0; // The shape cache uses temporary memory, so Batches always get their own copy
+  }
+
+  if (pass->prewarm) {
+    resolvePipeline(pass, draw, shader);
+    pass->pipeline->dirty = true;
+    skipDraw(draw);
+    return;
+  }
+
+  pass->stats.draws++;
+  pass->stats.instances += MAX(draw->instances, 1);
+
+  if (pass->sorting && !pass->batch) {
+    deferDraw(pass, draw, shader);
+    return;
+  }
 
   bindPipeline(pass, draw, shader);
+
+  if (!pass->boundPipeline) {
+    skipDraw(draw);
+    return;
+  }
+
   bindBundles(pass, draw, shader);
   bindBuffers(pass, draw);
   pushConstants(pass, shader);
@@ -4323,11 +6592,42 @@ static void lovrPassDraw(Pass* pass, Draw* draw) {
   uint32_t count = draw->count > 0 ? draw->count : defaultCount;
   uint32_t instances = MAX(draw->instances, 1);
   uint32_t id = pass->drawCount & 0xff;
+  bool indexed = draw->index.buffer || draw->index.count > 0;
 
-  if (draw->index.buffer || draw->index.count > 0) {
-    gpu_draw_indexed(pass->stream, count, instances, draw->start, draw->base, id);
+  // Consecutive draws of the same cached shape get merged into a single instanced draw.  Anything
+  // that records a command flushes the run first, so if the run is still open and this draw is the
+  // next one in the DrawData block, nothing could have changed between them.
+  if (draw->hash && instances == 1 && !pass->batch) {
+    ShapeRun* run = &pass->run;
+
+    if (run->instances > 0 && run->hash == draw->hash && run->id + run->instances == id) {
+      run->instances++;
+    } else {
+      flushShapeRun(pass);
+      *run = (ShapeRun) {
+        .hash = draw->hash,
+        .start = draw->start,
+        .count = count,
+        .base = draw->base,
+        .id = id,
+        .instances = 1,
+        .indexed = indexed
+      };
+    }
   } else {
-    gpu_draw(pass->stream, count, instances, draw->start, id);
+    flushShapeRun(pass);
+
+    if (indexed) {
+      gpu_draw_indexed(pass->stream, count, instances, draw->start, draw->base, id);
+    } else if (draw->vertex.instanced) {
+      gpu_draw(pass->stream, count, instances, id, 0);
+    } else {
+      gpu_draw(pass->stream, count, instances, draw->start, id);
+    }
+  }
+
+  if (pass->batch) {
+    recordBatchDraw(pass, draw, shader, count, instances);
   }
 
   pass->drawCount++;
@@ -4970,55 +7270,241 @@ void lovrPassTorus(Pass* pass, float* transform, uint32_t segmentsT, uint32_t se
   }
 }
 
-void lovrPassText(Pass* pass, ColoredString* strings, uint32_t count, float* transform, float wrap, HorizontalAlign halign, VerticalAlign valign) {
-  Font* font = pass->pipeline->font ? pass->pipeline->font : lovrGraphicsGetDefaultFont();
+// Text layouts are cached in a small LRU keyed by the font, strings, colors, wrap, and alignment.
+// The first time some text is seen only its hash is recorded, and if it's drawn again on a later
+// tick its glyphs are kept in a Buffer.  Text that changes every frame never gets a Buffer.  The
+// Buffers are limited to MAX_TEXT_LAYOUT_BYTES, and when there's more text in a frame than there
+// are slots, the extra text just isn't cached, instead of evicting layouts that are still in use.
+// Called with the lock.
+static TextLayout* findTextLayout(uint64_t hash) {
+  for (uint32_t i = 0; i < COUNTOF(state.textLayouts); i++) {
+    if (state.textLayouts[i].hash == hash) {
+      return &state.textLayouts[i];
+    }
+  }
 
-  size_t totalLength = 0;
-  for (uint32_t i = 0; i < count; i++) {
-    totalLength += strings[i].length;
+  return NULL;
+}
+
+static void releaseTextLayout(TextLayout* layout) {
+  if (layout->quads) {
+    state.textLayoutBytes -= layout->glyphCount * sizeof(GlyphQuad);
+    lovrRelease(layout->quads, lovrBufferDestroy);
+    layout->quads = NULL;
   }
+}
 
-  size_t stack = tempPush();
-  GlyphVertex* vertices = tempAlloc(totalLength * 4 * sizeof(GlyphVertex));
-  uint32_t glyphCount;
-  uint32_t lineCount;
+static TextLayout* addTextLayout(uint64_t hash, Font* font) {
+  TextLayout* layout = &state.textLayouts[0];
 
-  float leading = lovrRasterizerGetLeading(font->info.rasterizer) * font->lineSpacing;
-  float ascent = lovrRasterizerGetAscent(font->info.rasterizer);
+  for (uint32_t i = 1; i < COUNTOF(state.textLayouts) && layout->hash; i++) {
+    if (!state.textLayouts[i].hash || state.textLayouts[i].tick < layout->tick) {
+      layout = &state.textLayouts[i];
+    }
+  }
+
+  if (layout->hash && layout->tick == state.tick) {
+    return NULL;
+  }
+
+  releaseTextLayout(layout);
+  *layout = (TextLayout) { .hash = hash, .font = font, .tick = state.tick };
+  return layout;
+}
+
+// Frees up space for a layout's Buffer, dropping the Buffers of the least recently used layouts
+static bool reserveTextLayoutBytes(size_t size) {
+  while (state.textLayoutBytes + size > MAX_TEXT_LAYOUT_BYTES) {
+    TextLayout* oldest = NULL;
+
+    for (uint32_t i = 0; i < COUNTOF(state.textLayouts); i++) {
+      TextLayout* layout = &state.textLayouts[i];
+      if (layout->quads && layout->tick < state.tick && (!oldest || layout->tick < oldest->tick)) {
+        oldest = layout;
+      }
+    }
+
+    if (!oldest) {
+      return false;
+    }
+
+    releaseTextLayout(oldest);
+  }
+
+  state.textLayoutBytes += size;
+  return true;
+}
+
+static void evictTextLayouts(Font* font) {
+  for (uint32_t i = 0; i < COUNTOF(state.textLayouts); i++) {
+    TextLayout* layout = &state.textLayouts[i];
+    if (layout->font == font) {
+      releaseTextLayout(layout);
+      memset(layout, 0, sizeof(*layout));
+    }
+  }
+}
+
+static uint64_t hashText(Font* font, ColoredString* strings, uint32_t count, float wrap, HorizontalAlign halign, VerticalAlign valign, bool flip) {
+  float params[6] = { font->lineSpacing, wrap, (float) halign, (float) valign, (float) flip, (float) count };
+  uint64_t hash = hash_mix((uint64_t) (uintptr_t) font, hash64(params, sizeof(params)));
+  for (uint32_t i = 0; i < count; i++) {
+    hash = hash_mix(hash ^ hash64(strings[i].string, strings[i].length), hash64(strings[i].color, sizeof(strings[i].color)));
+  }
+  return hash ? hash : 1;
+}
+
+void lovrPassText(Pass* pass, ColoredString* strings, uint32_t count, float* transform, float wrap, HorizontalAlign halign, VerticalAlign valign) {
+  Font* font = pass->pipeline->font ? pass->pipeline->font : lovrGraphicsGetDefaultFont();
+
+  size_t totalLength = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    totalLength += strings[i].length;
+  }
+
+  uint32_t glyphCount;
+  uint32_t lineCount;
+
+  float leading = lovrRasterizerGetLeading(font->info.rasterizer) * font->lineSpacing;
+  float ascent = lovrRasterizerGetAscent(font->info.rasterizer);
   float scale = 1.f / font->pixelDensity;
   wrap /= scale;
 
-  Material* material;
   bool flip = pass->cameras[0].projection[5] > 0.f;
-  lovrFontGetVertices(font, strings, count, wrap, halign, valign, vertices, &glyphCount, &lineCount, &material, flip);
+  size_t stack = tempPush();
+
+  // Custom shaders get regular vertices, since they don't know how to expand glyph quads
+  if (pass->pipeline->shader) {
+    GlyphVertex* vertices = tempAlloc(totalLength * 4 * sizeof(GlyphVertex));
+    Material* material;
+
+    lock();
+    lovrFontGetVertices(font, strings, count, wrap, halign, valign, vertices, &glyphCount, &lineCount, &material, flip);
+    unlock();
+
+    mat4_scale(transform, scale, scale, scale);
+    float offset = -ascent + valign / 2.f * (leading * lineCount);
+    mat4_translate(transform, 0.f, flip ? -offset : offset, 0.f);
+
+    GlyphVertex* vertexPointer;
+    uint16_t* indices;
+    lovrPassDraw(pass, &(Draw) {
+      .mode = MESH_TRIANGLES,
+      .shader = SHADER_FONT,
+      .material = font->material,
+      .transform = transform,
+      .vertex.format = VERTEX_GLYPH,
+      .vertex.pointer = (void**) &vertexPointer,
+      .vertex.count = glyphCount * 4,
+      .index.pointer = (void**) &indices,
+      .index.count = glyphCount * 6
+    });
+
+    memcpy(vertexPointer, vertices, glyphCount * 4 * sizeof(GlyphVertex));
+
+    for (uint32_t i = 0; i < glyphCount * 4; i += 4) {
+      uint16_t quad[] = { i + 0, i + 2, i + 1, i + 1, i + 2, i + 3 };
+      memcpy(indices, quad, sizeof(quad));
+      indices += COUNTOF(quad);
+    }
+
+    // Deferred draws reference temporary memory until they are flushed
+    if (!pass->sorting) {
+      tempPop(stack);
+    }
+
+    return;
+  }
+
+  // The glyph shader expands quads, so it isn't a DefaultShader that can be used for other draws
+  Shader* glyphShader = getBuiltinShader(&state.glyphShader, &(ShaderInfo) {
+    .type = SHADER_GRAPHICS,
+    .source[0] = state.features.bindless ?
+      (ShaderSource) { lovr_shader_font_vert_bindless, sizeof(lovr_shader_font_vert_bindless) } :
+      (ShaderSource) { lovr_shader_font_vert, sizeof(lovr_shader_font_vert) },
+    .source[1] = lovrGraphicsGetDefaultShaderSource(SHADER_FONT, STAGE_FRAGMENT),
+    .label = "glyph"
+  });
+
+  uint64_t hash = hashText(font, strings, count, wrap, halign, valign, flip);
+  GlyphQuad* quads = NULL;
+  Buffer* buffer = NULL;
+
+  lock();
+  TextLayout* layout = findTextLayout(hash);
+
+  if (layout && layout->quads) {
+    glyphCount = layout->glyphCount;
+    lineCount = layout->lineCount;
+    buffer = layout->quads;
+    layout->tick = state.tick;
+  } else {
+    quads = tempAlloc(totalLength * sizeof(GlyphQuad));
+    layoutText(font, strings, count, wrap, halign, quads, &glyphCount, &lineCount, flip);
+
+    // Look it up again, since an atlas resize evicts layouts
+    layout = findTextLayout(hash);
+
+    if (!layout) {
+      addTextLayout(hash, font);
+    } else if (layout->tick == state.tick || glyphCount == 0 || !reserveTextLayoutBytes(glyphCount * sizeof(GlyphQuad))) {
+      layout->tick = state.tick;
+    } else {
+      void* data = NULL;
+      layout->quads = lovrBufferCreate(&(BufferInfo) {
+        .length = glyphCount,
+        .stride = sizeof(GlyphQuad),
+        .fieldCount = 3,
+        .fields[0] = { 0, 0, FIELD_F32x4, offsetof(GlyphQuad, rect) },
+        .fields[1] = { 0, 1, FIELD_UN16x4, offsetof(GlyphQuad, uv) },
+        .fields[2] = { 0, 2, FIELD_UN8x4, offsetof(GlyphQuad, color) },
+        .label = "Text"
+      }, &data);
+      memcpy(data, quads, glyphCount * sizeof(GlyphQuad));
+      layout->glyphCount = glyphCount;
+      layout->lineCount = lineCount;
+      layout->tick = state.tick;
+      buffer = layout->quads;
+    }
+  }
+
+  // Another thread could evict the layout as soon as the lock is released
+  lovrRetain(buffer);
+  unlock();
+
+  if (glyphCount == 0) {
+    tempPop(stack);
+    return;
+  }
 
   mat4_scale(transform, scale, scale, scale);
   float offset = -ascent + valign / 2.f * (leading * lineCount);
   mat4_translate(transform, 0.f, flip ? -offset : offset, 0.f);
 
-  GlyphVertex* vertexPointer;
-  uint16_t* indices;
+  GlyphQuad* pointer = NULL;
   lovrPassDraw(pass, &(Draw) {
     .mode = MESH_TRIANGLES,
-    .shader = SHADER_FONT,
+    .internalShader = glyphShader,
     .material = font->material,
     .transform = transform,
-    .vertex.format = VERTEX_GLYPH,
-    .vertex.pointer = (void**) &vertexPointer,
-    .vertex.count = glyphCount * 4,
-    .index.pointer = (void**) &indices,
-    .index.count = glyphCount * 6
+    .vertex.buffer = buffer,
+    .vertex.format = VERTEX_GLYPH_QUAD,
+    .vertex.pointer = (void**) &pointer,
+    .vertex.count = glyphCount,
+    .vertex.instanced = true,
+    .count = 6,
+    .instances = glyphCount
   });
 
-  memcpy(vertexPointer, vertices, glyphCount * 4 * sizeof(GlyphVertex));
-
-  for (uint32_t i = 0; i < glyphCount * 4; i += 4) {
-    uint16_t quad[] = { i + 0, i + 2, i + 1, i + 1, i + 2, i + 3 };
-    memcpy(indices, quad, sizeof(quad));
-    indices += COUNTOF(quad);
+  if (!buffer) {
+    memcpy(pointer, quads, glyphCount * sizeof(GlyphQuad));
   }
 
-  tempPop(stack);
+  lovrRelease(buffer, lovrBufferDestroy);
+
+  if (!pass->sorting) {
+    tempPop(stack);
+  }
 }
 
 void lovrPassSkybox(Pass* pass, Texture* texture) {
@@ -5099,20 +7585,71 @@ void lovrPassMonkey(Pass* pass, float* transform) {
   memcpy(indices, monkey_indices, sizeof(monkey_indices));
 }
 
-static void renderNode(Pass* pass, Model* model, uint32_t index, bool recurse, uint32_t instances) {
+// Tests a box against the frustum planes of a clip-from-local matrix (Gribb/Hartmann)
+static bool isBoxVisible(float* box, float* m) {
+  float planes[6][4];
+  for (uint32_t i = 0; i < 4; i++) {
+    planes[0][i] = m[4 * i + 3] + m[4 * i + 0];
+    planes[1][i] = m[4 * i + 3] - m[4 * i + 0];
+    planes[2][i] = m[4 * i + 3] + m[4 * i + 1];
+    planes[3][i] = m[4 * i + 3] - m[4 * i + 1];
+    planes[4][i] = m[4 * i + 2];
+    planes[5][i] = m[4 * i + 3] - m[4 * i + 2];
+  }
+
+  for (uint32_t i = 0; i < 6; i++) {
+    float* p = planes[i];
+    float x = p[0] > 0.f ? box[1] : box[0];
+    float y = p[1] > 0.f ? box[3] : box[2];
+    float z = p[2] > 0.f ? box[5] : box[4];
+    if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.f) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// A box is visible if it's inside the frustum of any of the views
+static bool isBoxVisibleInViews(float* box, float* transform, float* viewProjections, uint32_t viewCount) {
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float m[16];
+    mat4_mul(mat4_init(m, viewProjections + 16 * i), transform);
+    if (isBoxVisible(box, m)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void renderNode(Pass* pass, Model* model, uint32_t index, bool recurse, uint32_t instances, float* viewProjections) {
   ModelNode* node = &model->info.data->nodes[index];
   mat4 globalTransform = model->globalTransforms + 16 * index;
 
-  for (uint32_t i = 0; i < node->primitiveCount; i++) {
-    Draw draw = model->draws[node->primitiveIndex + i];
-    if (node->skin == ~0u) draw.transform = globalTransform;
-    draw.instances = instances;
-    lovrPassDraw(pass, &draw);
+  // Skinned and instanced nodes can end up anywhere, so they aren't culled
+  bool cull = viewProjections && node->skin == ~0u && instances == 1 && node->primitiveCount > 0;
+
+  if (!cull || isBoxVisibleInViews(model->nodeBoundingBoxes + 6 * index, globalTransform, viewProjections, pass->viewCount)) {
+    for (uint32_t i = 0; i < node->primitiveCount; i++) {
+      uint32_t primitive = node->primitiveIndex + i;
+
+      if (cull && node->primitiveCount > 1) {
+        if (!isBoxVisibleInViews(model->boundingBoxes + 6 * primitive, globalTransform, viewProjections, pass->viewCount)) {
+          continue;
+        }
+      }
+
+      Draw draw = model->draws[primitive];
+      if (node->skin == ~0u) draw.transform = globalTransform;
+      draw.instances = instances;
+      lovrPassDraw(pass, &draw);
+    }
   }
 
   if (recurse) {
     for (uint32_t i = 0; i < node->childCount; i++) {
-      renderNode(pass, model, node->children[i], true, instances);
+      renderNode(pass, model, node->children[i], true, instances, viewProjections);
     }
   }
 }
@@ -5130,7 +7667,20 @@ void lovrPassDrawModel(Pass* pass, Model* model, float* transform, uint32_t node
 
   lovrPassPush(pass, STACK_TRANSFORM);
   lovrPassTransform(pass, transform);
-  renderNode(pass, model, node, recurse, instances);
+
+  float* viewProjections = NULL;
+  float matrices[6][16];
+
+  if (pass->pipeline->viewCull && pass->viewCount <= COUNTOF(matrices)) {
+    viewProjections = matrices[0];
+    for (uint32_t i = 0; i < pass->viewCount; i++) {
+      mat4_init(matrices[i], pass->cameras[i].projection);
+      mat4_mul(matrices[i], pass->cameras[i].view);
+      mat4_mul(matrices[i], pass->transform);
+    }
+  }
+
+  renderNode(pass, model, node, recurse, instances, viewProjections);
   lovrPassPop(pass, STACK_TRANSFORM);
 }
 
@@ -5169,6 +7719,19 @@ void lovrPassMeshIndirect(Pass* pass, Buffer* vertices, Buffer* indices, Buffer*
   stride = stride ? stride : commandSize;
   uint32_t totalSize = stride * (count - 1) + commandSize;
   lovrCheck(offset + totalSize < draws->size, "Draw buffer range exceeds the size of the buffer");
+  lovrCheck(!pass->batch, "Draws sourced from a Buffer can not be recorded into a Batch");
+
+  // The auto instance bit in the base instance is reserved for merged shape draws.  Draws written
+  // on the GPU can't be checked, but temporary buffers are still on the CPU.
+  if (draws->pointer) {
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t* command = (uint32_t*) (draws->pointer + offset + i * stride);
+      uint32_t firstInstance = command[indices ? 4 : 3];
+      lovrCheck(firstInstance < AUTO_INSTANCE_BIT, "Base instance of a draw sourced from a Buffer must be less than %d", AUTO_INSTANCE_BIT);
+    }
+  }
+
+  flushDeferredDraws(pass);
 
   Draw draw = (Draw) {
     .mode = pass->pipeline->mode,
@@ -5180,10 +7743,17 @@ void lovrPassMeshIndirect(Pass* pass, Buffer* vertices, Buffer* indices, Buffer*
   lovrCheck(shader, "A custom Shader must be bound to source draws from a Buffer");
 
   bindPipeline(pass, &draw, shader);
+
+  if (!pass->boundPipeline) {
+    return;
+  }
+
   bindBundles(pass, &draw, shader);
   bindBuffers(pass, &draw);
   pushConstants(pass, shader);
 
+  flushShapeRun(pass);
+
   if (indices) {
     gpu_draw_indirect_indexed(pass->stream, draws->gpu, offset, count, stride);
   } else {
@@ -5193,6 +7763,212 @@ void lovrPassMeshIndirect(Pass* pass, Buffer* vertices, Buffer* indices, Buffer*
   trackBuffer(pass, draws, GPU_PHASE_INDIRECT, GPU_CACHE_INDIRECT);
 }
 
+void lovrPassBeginBatch(Pass* pass, Batch* batch) {
+  lovrPassCheckValid(pass);
+  lovrCheck(pass->info.type == PASS_RENDER, "This function can only be called on a render pass");
+  lovrCheck(!pass->batch, "Pass is already recording a Batch");
+  lovrCheck(!batch->pass, "Batch is already being recorded by another Pass");
+  flushDeferredDraws(pass);
+  lovrBatchClear(batch);
+  batch->pass = pass;
+  batch->target = getTargetHash(pass);
+  pass->batch = batch;
+  lovrRetain(batch);
+}
+
+void lovrPassEndBatch(Pass* pass) {
+  Batch* batch = pass->batch;
+  lovrCheck(batch, "Pass is not recording a Batch");
+
+  // Temporary vertices and indices are copied to a Buffer owned by the Batch, so they outlive the frame
+  uint32_t size = 0;
+  for (size_t i = 0; i < batch->draws.length; i++) {
+    BatchDraw* draw = &batch->draws.data[i];
+    draw->vertex.offset = size;
+    size = ALIGN(size + draw->vertex.size, 4);
+    draw->index.offset = size;
+    size = ALIGN(size + draw->index.size, 4);
+  }
+
+  if (size > 0) {
+    char* data;
+    lock();
+    batch->buffer = lovrBufferCreate(&(BufferInfo) {
+      .length = size,
+      .stride = 1,
+      .label = "Batch"
+    }, (void**) &data);
+    unlock();
+
+    for (size_t i = 0; i < batch->draws.length; i++) {
+      BatchDraw* draw = &batch->draws.data[i];
+      if (draw->vertex.data) memcpy(data + draw->vertex.offset, draw->vertex.data, draw->vertex.size);
+      if (draw->index.data) memcpy(data + draw->index.offset, draw->index.data, draw->index.size);
+      draw->vertex.data = NULL;
+      draw->index.data = NULL;
+    }
+  }
+
+  batch->pass = NULL;
+  pass->batch = NULL;
+  lovrRelease(batch, lovrBatchDestroy);
+}
+
+// Replays draws from a Batch.  Pipelines and materials were resolved when the Batch was recorded,
+// so this only has to write draw data and bind things that change between draws.  The camera,
+// sampler, resources, and constants come from the Pass.
+void lovrPassDrawBatch(Pass* pass, Batch* batch, float* transform) {
+  lovrPassCheckValid(pass);
+  lovrCheck(pass->info.type == PASS_RENDER, "This function can only be called on a render pass");
+  lovrCheck(!pass->batch, "Unable to draw a Batch while recording a Batch");
+  lovrCheck(!batch->pass, "Unable to draw a Batch before it has finished recording");
+
+  if (batch->draws.length == 0) {
+    return;
+  }
+
+  flushDeferredDraws(pass);
+  flushShapeRun(pass);
+
+  lovrCheck(batch->target == getTargetHash(pass), "Batch was recorded with a different canvas format than this Pass");
+
+  float m[16];
+  float cofactor[16];
+  mat4_init(m, pass->transform);
+  if (transform) mat4_mul(m, transform);
+  static const float identity[16] = MAT4_IDENTITY;
+  bool moved = memcmp(m, identity, sizeof(identity));
+
+  if (moved) {
+    mat4_init(cofactor, m);
+    cofactor[12] = 0.f;
+    cofactor[13] = 0.f;
+    cofactor[14] = 0.f;
+    cofactor[15] = 1.f;
+    mat4_cofactor(cofactor);
+  }
+
+  if (batch->buffer) {
+    trackBuffer(pass, batch->buffer, GPU_PHASE_INPUT_VERTEX | GPU_PHASE_INPUT_INDEX, GPU_CACHE_VERTEX | GPU_CACHE_INDEX);
+  }
+
+  gpu_pipeline* pipeline = NULL;
+  Shader* shader = NULL;
+  Material* material = NULL;
+  gpu_bundle* materialBundle = NULL;
+  gpu_buffer* vertexBuffer = NULL;
+  gpu_buffer* indexBuffer = NULL;
+  uint32_t vertexOffset = ~0u;
+  uint32_t indexOffset = ~0u;
+
+  // Descriptor sets may have been disturbed by the pipeline that was bound before the replay
+  pass->samplerDirty = true;
+
+  for (size_t i = 0; i < batch->draws.length; i++) {
+    BatchDraw* draw = &batch->draws.data[i];
+    gpu_bundle* bundles[3];
+    uint32_t bundleMask = 0;
+
+    if (draw->pipeline != pipeline) {
+      gpu_bind_pipeline(pass->stream, draw->pipeline, false);
+      pipeline = draw->pipeline;
+    }
+
+    if (draw->shader != shader) {
+      if (shader && shader->constantSize != draw->shader->constantSize) {
+        pass->samplerDirty = true;
+        materialBundle = NULL;
+      }
+
+      shader = draw->shader;
+      bindDefaultResources(pass, shader);
+      pass->bindingsDirty = true;
+      pass->constantsDirty = true;
+    }
+
+    if (updateBuiltins(pass)) {
+      bundles[0] = pass->builtinBundle;
+      bundleMask |= (1 << 0);
+    }
+
+    if (moved) {
+      mat4_mul(mat4_init(pass->drawData->transform, m), draw->data.transform);
+      mat4_mul(mat4_init(pass->drawData->cofactor, cofactor), draw->data.cofactor);
+      memcpy(&pass->drawData->cofactor[15], &draw->data.cofactor[15], sizeof(float)); // Material index
+      memcpy(pass->drawData->color, draw->data.color, 16);
+    } else {
+      memcpy(pass->drawData, &draw->data, sizeof(DrawData));
+    }
+
+    pass->drawData++;
+
+    if (draw->material != material) {
+      trackMaterial(pass, draw->material, GPU_PHASE_SHADER_VERTEX | GPU_PHASE_SHADER_FRAGMENT, GPU_CACHE_TEXTURE);
+      material = draw->material;
+    }
+
+    bundles[1] = material->bundle;
+
+    if (material->bundle != materialBundle) {
+      bundleMask |= (1 << 1);
+      materialBundle = material->bundle;
+    }
+
+    if (pass->bindingsDirty && shader->resourceCount > 0) {
+      bundles[2] = getResourceBundle(pass, shader);
+      bundleMask |= (1 << 2);
+    }
+
+    bindBundleMask(pass, shader, bundles, bundleMask);
+    pushConstants(pass, shader);
+
+    if (draw->vertex.buffer && (draw->vertex.buffer->gpu != vertexBuffer || vertexOffset != 0)) {
+      trackBuffer(pass, draw->vertex.buffer, GPU_PHASE_INPUT_VERTEX, GPU_CACHE_VERTEX);
+      vertexBuffer = draw->vertex.buffer->gpu;
+      vertexOffset = 0;
+      gpu_bind_vertex_buffers(pass->stream, &vertexBuffer, NULL, 0, 1);
+    } else if (draw->vertex.size > 0 && (batch->buffer->gpu != vertexBuffer || draw->vertex.offset != vertexOffset)) {
+      vertexBuffer = batch->buffer->gpu;
+      vertexOffset = draw->vertex.offset;
+      gpu_bind_vertex_buffers(pass->stream, &vertexBuffer, &vertexOffset, 0, 1);
+    }
+
+    if (draw->index.buffer && (draw->index.buffer->gpu != indexBuffer || indexOffset != 0)) {
+      trackBuffer(pass, draw->index.buffer, GPU_PHASE_INPUT_INDEX, GPU_CACHE_INDEX);
+      indexBuffer = draw->index.buffer->gpu;
+      indexOffset = 0;
+      gpu_bind_index_buffer(pass->stream, indexBuffer, 0, draw->indexType);
+    } else if (draw->index.size > 0 && (batch->buffer->gpu != indexBuffer || draw->index.offset != indexOffset)) {
+      indexBuffer = batch->buffer->gpu;
+      indexOffset = draw->index.offset;
+      gpu_bind_index_buffer(pass->stream, indexBuffer, indexOffset, GPU_INDEX_U16);
+    }
+
+    uint32_t id = pass->drawCount & 0xff;
+
+    if (draw->indexed) {
+      gpu_draw_indexed(pass->stream, draw->count, draw->instances, draw->start, draw->base, id);
+    } else if (draw->instanced) {
+      gpu_draw(pass->stream, draw->count, draw->instances, id, 0);
+    } else {
+      gpu_draw(pass->stream, draw->count, draw->instances, draw->start, id);
+    }
+
+    pass->stats.draws++;
+    pass->stats.instances += draw->instances;
+    pass->drawCount++;
+  }
+
+  // Everything the replay bound needs to be rebound by the next regular draw
+  pass->pipeline->dirty = true;
+  pass->materialDirty = true;
+  pass->samplerDirty = true;
+  pass->bindingsDirty = true;
+  pass->constantsDirty = true;
+  pass->vertexBuffer = NULL;
+  pass->indexBuffer = NULL;
+}
+
 void lovrPassCompute(Pass* pass, uint32_t x, uint32_t y, uint32_t z, Buffer* indirect, uint32_t offset) {
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_COMPUTE, "This function can only be called on a compute pass");
@@ -5203,9 +7979,10 @@ void lovrPassCompute(Pass* pass, uint32_t x, uint32_t y, uint32_t z, Buffer* ind
   lovrCheck(y <= state.limits.workgroupCount[1], "Compute %s count exceeds workgroupCount limit", "y");
   lovrCheck(z <= state.limits.workgroupCount[2], "Compute %s count exceeds workgroupCount limit", "z");
 
-  gpu_pipeline* pipeline = state.pipelines.data[shader->computePipelineIndex];
-
   if (pass->pipeline->dirty) {
+    lock();
+    gpu_pipeline* pipeline = state.pipelines.data[shader->computePipelineIndex];
+    unlock();
     gpu_bind_pipeline(pass->stream, pipeline, true);
     pass->pipeline->dirty = false;
   }
@@ -5223,11 +8000,117 @@ void lovrPassCompute(Pass* pass, uint32_t x, uint32_t y, uint32_t z, Buffer* ind
   }
 }
 
+// Tests a bounding sphere (vec4) for each instance against the view frustums, writing the indices of
+// the visible instances to a Buffer and setting the instance count of an indirect draw to the
+// number of visible instances.  The draw's other fields are left alone, so it acts as a template,
+// and a vertex shader can look up the real instance index in the visible Buffer.
+void lovrPassCull(Pass* pass, Buffer* bounds, Buffer* visible, uint32_t count, Buffer* draws, uint32_t offset, float* viewProjections, uint32_t viewCount) {
+  lovrPassCheckValid(pass);
+  lovrCheck(pass->info.type == PASS_COMPUTE, "This function can only be called on a compute pass");
+  lovrCheck(!lovrBufferIsTemporary(bounds) && !lovrBufferIsTemporary(visible) && !lovrBufferIsTemporary(draws), "Temporary buffers can not be used for culling");
+  lovrCheck(viewCount > 0 && viewCount <= 6, "Culling requires between 1 and 6 views");
+  lovrCheck(bounds->info.stride == 16, "Bounds Buffer must have a stride of 16 bytes (one sphere per instance)");
+  lovrCheck(count * 16 <= bounds->size, "Bounds Buffer is too small to hold %d instances", count);
+  lovrCheck(count * 4 <= visible->size, "Visible Buffer is too small to hold %d instances", count);
+  lovrCheck(offset % 4 == 0, "Indirect draw offset must be a multiple of 4");
+  lovrCheck(offset + 8 <= draws->size, "Indirect draw offset overflows the Buffer");
+  lovrCheck(MAX(bounds->size, MAX(visible->size, draws->size)) <= state.limits.storageBufferRange, "Buffer size exceeds storageBufferRange limit");
+
+  Shader* culler = getBuiltinShader(&state.culler, &(ShaderInfo) {
+    .type = SHADER_COMPUTE,
+    .source[0] = { lovr_shader_cull_comp, sizeof(lovr_shader_cull_comp) },
+    .label = "culler"
+  });
+
+  lock();
+  gpu_pipeline* pipeline = state.pipelines.data[culler->computePipelineIndex];
+  gpu_shader* shader = culler->gpu;
+  unlock();
+
+  // Frustum planes, normalized so spheres can be tested against them
+  gpu_buffer* frustums = tempAlloc(gpu_sizeof_buffer());
+  float* planes = gpu_map(frustums, 36 * 4 * sizeof(float), state.limits.uniformBufferAlign, GPU_MAP_STREAM);
+
+  for (uint32_t i = 0; i < viewCount; i++) {
+    float* m = viewProjections + 16 * i;
+    for (uint32_t j = 0; j < 4; j++) {
+      planes[0 + j] = m[4 * j + 3] + m[4 * j + 0];
+      planes[4 + j] = m[4 * j + 3] - m[4 * j + 0];
+      planes[8 + j] = m[4 * j + 3] + m[4 * j + 1];
+      planes[12 + j] = m[4 * j + 3] - m[4 * j + 1];
+      planes[16 + j] = m[4 * j + 2];
+      planes[20 + j] = m[4 * j + 3] - m[4 * j + 2];
+    }
+
+    for (uint32_t j = 0; j < 6; j++, planes += 4) {
+      float length = sqrtf(planes[0] * planes[0] + planes[1] * planes[1] + planes[2] * planes[2]);
+      if (length > 0.f) {
+        planes[0] /= length;
+        planes[1] /= length;
+        planes[2] /= length;
+        planes[3] /= length;
+      }
+    }
+  }
+
+  gpu_binding bindings[] = {
+    [0] = { 0, GPU_SLOT_STORAGE_BUFFER, .buffer = { bounds->gpu, 0, bounds->size } },
+    [1] = { 1, GPU_SLOT_STORAGE_BUFFER, .buffer = { visible->gpu, 0, visible->size } },
+    [2] = { 2, GPU_SLOT_STORAGE_BUFFER, .buffer = { draws->gpu, 0, draws->size } },
+    [3] = { 3, GPU_SLOT_UNIFORM_BUFFER, .buffer = { frustums, 0, 36 * 4 * sizeof(float) } }
+  };
+
+  gpu_bundle* bundle = getBundle(culler->layout, bindings, COUNTOF(bindings));
+
+  struct { uint32_t count, views, draw; } constants = {
+    .count = count,
+    .views = viewCount,
+    .draw = offset / 4
+  };
+
+  // If an earlier dispatch in this Pass used the draw Buffer, it has to finish before the clear
+  for (uint32_t i = 0; i < pass->access.length; i++) {
+    if (pass->access.data[i].sync == &draws->sync) {
+      gpu_sync(pass->stream, &(gpu_barrier) {
+        .prev = GPU_PHASE_SHADER_COMPUTE,
+        .next = GPU_PHASE_TRANSFER,
+        .flush = GPU_CACHE_STORAGE_WRITE
+      }, 1);
+      break;
+    }
+  }
+
+  // Reset the instance count before counting visible instances
+  gpu_clear_buffer(pass->stream, draws->gpu, offset + 4, 4);
+
+  gpu_sync(pass->stream, &(gpu_barrier) {
+    .prev = GPU_PHASE_TRANSFER,
+    .next = GPU_PHASE_SHADER_COMPUTE,
+    .flush = GPU_CACHE_TRANSFER_WRITE,
+    .clear = GPU_CACHE_STORAGE_READ | GPU_CACHE_STORAGE_WRITE
+  }, 1);
+
+  gpu_bind_pipeline(pass->stream, pipeline, true);
+  gpu_bind_bundles(pass->stream, shader, &bundle, 0, 1, NULL, 0);
+  gpu_push_constants(pass->stream, shader, &constants, sizeof(constants));
+  gpu_compute(pass->stream, (count + 31) / 32, 1, 1);
+
+  trackBuffer(pass, bounds, GPU_PHASE_SHADER_COMPUTE, GPU_CACHE_STORAGE_READ);
+  trackBuffer(pass, visible, GPU_PHASE_SHADER_COMPUTE, GPU_CACHE_STORAGE_WRITE);
+  trackBuffer(pass, draws, GPU_PHASE_TRANSFER | GPU_PHASE_SHADER_COMPUTE, GPU_CACHE_TRANSFER_WRITE | GPU_CACHE_STORAGE_READ | GPU_CACHE_STORAGE_WRITE);
+
+  // The Pass's own pipeline, resources, and constants need to be rebound for the next dispatch
+  pass->pipeline->dirty = true;
+  pass->bindingsDirty = true;
+  pass->constantsDirty = true;
+}
+
 void lovrPassClearBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint32_t extent) {
   if (extent == 0) return;
   if (extent == ~0u) extent = buffer->size - offset;
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!lovrBufferIsTemporary(buffer), "Temporary buffers can not be cleared");
   lovrCheck(offset % 4 == 0, "Buffer clear offset must be a multiple of 4");
   lovrCheck(extent % 4 == 0, "Buffer clear extent must be a multiple of 4");
@@ -5239,6 +8122,7 @@ void lovrPassClearBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint32_t e
 void lovrPassClearTexture(Pass* pass, Texture* texture, float value[4], uint32_t layer, uint32_t layerCount, uint32_t level, uint32_t levelCount) {
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!texture->info.parent, "Texture views can not be cleared");
   lovrCheck(texture->info.usage & TEXTURE_TRANSFER, "Texture must be created with 'transfer' usage to clear it");
   lovrCheck(texture->info.type == TEXTURE_3D || layer + layerCount <= texture->info.layers, "Texture clear range exceeds texture layer count");
@@ -5250,6 +8134,7 @@ void lovrPassClearTexture(Pass* pass, Texture* texture, float value[4], uint32_t
 void* lovrPassCopyDataToBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint32_t extent) {
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!lovrBufferIsTemporary(buffer), "Temporary buffers can not be copied to, use Buffer:setData");
   lovrCheck(offset + extent <= buffer->size, "Buffer copy range goes past the end of the Buffer");
   gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
@@ -5262,6 +8147,7 @@ void* lovrPassCopyDataToBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint
 void lovrPassCopyBufferToBuffer(Pass* pass, Buffer* src, Buffer* dst, uint32_t srcOffset, uint32_t dstOffset, uint32_t extent) {
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!lovrBufferIsTemporary(dst), "Temporary buffers can not be copied to");
   lovrCheck(srcOffset + extent <= src->size, "Buffer copy range goes past the end of the source Buffer");
   lovrCheck(dstOffset + extent <= dst->size, "Buffer copy range goes past the end of the destination Buffer");
@@ -5274,6 +8160,7 @@ void lovrPassCopyTallyToBuffer(Pass* pass, Tally* tally, Buffer* buffer, uint32_
   lovrPassCheckValid(pass);
   if (count == ~0u) count = tally->info.count;
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!lovrBufferIsTemporary(buffer), "Temporary buffers can not be copied to");
   lovrCheck(srcIndex + count <= tally->info.count, "Tally copy range exceeds the number of slots in the Tally");
   lovrCheck(dstOffset + count * 4 <= buffer->size, "Buffer copy range goes past the end of the destination Buffer");
@@ -5295,6 +8182,7 @@ void lovrPassCopyImageToTexture(Pass* pass, Image* image, Texture* texture, uint
   if (extent[2] == ~0u) extent[2] = MIN(texture->info.layers - dstOffset[2], lovrImageGetLayerCount(image) - srcOffset[2]);
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(texture->info.usage & TEXTURE_TRANSFER, "Texture must be created with the 'transfer' usage to copy to it");
   lovrCheck(!texture->info.parent, "Texture views can not be written to");
   lovrCheck(texture->info.samples == 1, "Multisampled Textures can not be written to");
@@ -5329,6 +8217,7 @@ void lovrPassCopyTextureToTexture(Pass* pass, Texture* src, Texture* dst, uint32
   if (extent[2] == ~0u) extent[2] = MIN(src->info.layers - srcOffset[2], dst->info.layers - dstOffset[0]);
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(src->info.usage & TEXTURE_TRANSFER, "Texture must be created with the 'transfer' usage to copy %s it", "from");
   lovrCheck(dst->info.usage & TEXTURE_TRANSFER, "Texture must be created with the 'transfer' usage to copy %s it", "to");
   lovrCheck(!src->info.parent && !dst->info.parent, "Can not copy texture views");
@@ -5350,6 +8239,7 @@ void lovrPassBlit(Pass* pass, Texture* src, Texture* dst, uint32_t srcOffset[4],
   if (dstExtent[2] == ~0u) dstExtent[2] = dst->info.layers - dstOffset[2];
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!src->info.parent && !dst->info.parent, "Can not blit Texture views");
   lovrCheck(src->info.samples == 1 && dst->info.samples == 1, "Multisampled textures can not be used for blits");
   lovrCheck(src->info.usage & TEXTURE_TRANSFER, "Texture must be created with the 'transfer' usage to blit %s it", "from");
@@ -5370,6 +8260,7 @@ void lovrPassMipmap(Pass* pass, Texture* texture, uint32_t base, uint32_t count)
   if (count == ~0u) count = texture->info.mipmaps - (base + 1);
   lovrPassCheckValid(pass);
   lovrCheck(pass->info.type == PASS_TRANSFER, "This function can only be called on a transfer pass");
+  flushReadbacks(pass);
   lovrCheck(!texture->info.parent, "Can not mipmap a Texture view");
   lovrCheck(texture->info.samples == 1, "Can not mipmap a multisampled texture");
   lovrCheck(texture->info.usage & TEXTURE_TRANSFER, "Texture must be created with the 'transfer' usage to mipmap it");
@@ -5391,7 +8282,11 @@ Readback* lovrPassReadBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint32
     .buffer.offset = offset,
     .buffer.extent = extent
   });
-  gpu_copy_buffers(pass->stream, buffer->gpu, readback->buffer, offset, 0, extent);
+  if (state.device.transferQueue) {
+    readback->pending = true;
+  } else {
+    recordReadback(pass->stream, readback);
+  }
   trackBuffer(pass, buffer, GPU_PHASE_TRANSFER, GPU_CACHE_TRANSFER_READ);
   arr_push(&pass->readbacks, readback);
   return readback;
@@ -5413,7 +8308,11 @@ Readback* lovrPassReadTexture(Pass* pass, Texture* texture, uint32_t offset[4],
     .texture.offset = { offset[0], offset[1], offset[2], offset[3] },
     .texture.extent = { extent[0], extent[1] }
   });
-  gpu_copy_texture_buffer(pass->stream, texture->gpu, readback->buffer, offset, 0, extent);
+  if (state.device.transferImages && !texture->info.handle && texture != state.window) {
+    readback->pending = true;
+  } else {
+    recordReadback(pass->stream, readback);
+  }
   trackTexture(pass, texture, GPU_PHASE_TRANSFER, GPU_CACHE_TRANSFER_READ);
   arr_push(&pass->readbacks, readback);
   return readback;
@@ -5446,11 +8345,16 @@ void lovrPassTick(Pass* pass, Tally* tally, uint32_t index) {
   lovrCheck(tally->info.views == pass->viewCount, "Tally view count does not match Pass view count");
   lovrCheck(index < tally->info.count, "Trying to use tally slot #%d, but the tally only has %d slots", index + 1, tally->info.count);
 
+  lock();
   if (tally->tick != state.tick) {
     uint32_t multiplier = tally->info.type == TALLY_TIME ? 2 * tally->info.count * tally->info.views : 1;
     gpu_clear_tally(state.stream, tally->gpu, 0, tally->info.count * multiplier);
     tally->tick = state.tick;
   }
+  unlock();
+
+  flushDeferredDraws(pass);
+  flushShapeRun(pass);
 
   if (tally->info.type == TALLY_TIME) {
     gpu_tally_mark(pass->stream, tally->gpu, index * 2 * tally->info.views);
@@ -5463,6 +8367,9 @@ void lovrPassTock(Pass* pass, Tally* tally, uint32_t index) {
   lovrCheck(tally->info.views == pass->viewCount, "Tally view count does not match Pass view count");
   lovrCheck(index < tally->info.count, "Trying to use tally slot #%d, but the tally only has %d slots", index + 1, tally->info.count);
 
+  flushDeferredDraws(pass);
+  flushShapeRun(pass);
+
   if (tally->info.type == TALLY_TIME) {
     gpu_tally_mark(pass->stream, tally->gpu, index * 2 * tally->info.views + tally->info.views);
   } else {
@@ -5472,24 +8379,197 @@ void lovrPassTock(Pass* pass, Tally* tally, uint32_t index) {
 
 // Helpers
 
+// The main thread uses state.allocator, other threads lazily create their own allocator, which is
+// reset the first time it's used in a new frame.  Other threads only get a 64MB reservation, and
+// their allocator is released by the thread-specific storage destructor when the thread exits.
+static Allocator* getAllocator(void) {
+#ifdef LOVR_DISABLE_THREAD
+  return &state.allocator;
+#else
+  Allocator* allocator = tss_get(state.allocatorKey);
+  uint32_t tick = atomic_fetch_add(&state.allocatorTick, 0);
+
+  if (!allocator) {
+    allocator = malloc(sizeof(Allocator));
+    lovrAssert(allocator, "Out of memory");
+    allocator->cursor = 0;
+    allocator->length = 1 << 14;
+    allocator->limit = 1 << 26;
+    allocator->memory = os_vm_init(allocator->limit);
+    allocator->tick = tick;
+    os_vm_commit(allocator->memory, allocator->length);
+    lock();
+    arr_push(&state.allocators, allocator);
+    unlock();
+    tss_set(state.allocatorKey, allocator);
+  } else if (allocator->tick != tick && allocator != &state.allocator) {
+    allocator->tick = tick;
+    allocator->cursor = 0;
+  }
+
+  return allocator;
+#endif
+}
+
+#ifndef LOVR_DISABLE_THREAD
+// Gives back the temp memory of a thread that exited before the graphics module was destroyed
+static void releaseAllocator(void* arg) {
+  Allocator* allocator = arg;
+
+  if (!allocator || allocator == &state.allocator) {
+    return;
+  }
+
+  lock();
+  for (size_t i = 0; i < state.allocators.length; i++) {
+    if (state.allocators.data[i] == allocator) {
+      arr_splice(&state.allocators, i, 1);
+      break;
+    }
+  }
+  unlock();
+
+  os_vm_free(allocator->memory, allocator->limit);
+  free(allocator);
+}
+#endif
+
 static void* tempAlloc(size_t size) {
-  while (state.allocator.cursor + size > state.allocator.length) {
-    lovrAssert(state.allocator.length << 1 <= state.allocator.limit, "Out of memory");
-    os_vm_commit(state.allocator.memory + state.allocator.length, state.allocator.length);
-    state.allocator.length <<= 1;
+  Allocator* allocator = getAllocator();
+
+  while (allocator->cursor + size > allocator->length) {
+    lovrAssert(allocator->length << 1 <= allocator->limit, "Out of memory");
+    os_vm_commit(allocator->memory + allocator->length, allocator->length);
+    allocator->length <<= 1;
   }
 
-  uint32_t cursor = ALIGN(state.allocator.cursor, 8);
-  state.allocator.cursor = cursor + size;
-  return state.allocator.memory + cursor;
+  uint32_t cursor = ALIGN(allocator->cursor, 8);
+  allocator->cursor = cursor + size;
+  return allocator->memory + cursor;
 }
 
 static size_t tempPush(void) {
-  return state.allocator.cursor;
+  return getAllocator()->cursor;
 }
 
 static void tempPop(size_t stack) {
-  state.allocator.cursor = stack;
+  getAllocator()->cursor = stack;
+}
+
+// Guards state that can be modified while recording passes (pipelines, bundles, internal uploads)
+static void lock(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.lock);
+  lockDepth++;
+#endif
+}
+
+static void unlock(void) {
+#ifndef LOVR_DISABLE_THREAD
+  lockDepth--;
+  mtx_unlock(&state.lock);
+#endif
+}
+
+// Releases the lock however many times this thread is holding it.  Errors call this before they're
+// thrown, since throwing skips the unlocks and every other thread would deadlock on the lock.
+static void unlockAll(void) {
+#ifndef LOVR_DISABLE_THREAD
+  while (lockDepth > 0) {
+    unlock();
+  }
+#endif
+}
+
+#ifndef LOVR_DISABLE_THREAD
+static int pipelineCompiler(void* arg) {
+  mtx_lock(&state.compileLock);
+
+  for (;;) {
+    while (state.compileQueue.length == 0 && !state.compilerQuit) {
+      cnd_wait(&state.compileSignal, &state.compileLock);
+    }
+
+    if (state.compilerQuit) {
+      break;
+    }
+
+    PipelineJob job = state.compileQueue.data[0];
+    arr_splice(&state.compileQueue, 0, 1);
+    mtx_unlock(&state.compileLock);
+
+    lovrProfileBegin("pipeline");
+    gpu_pipeline_init_graphics(job.gpu, &job.info);
+    lovrProfileEnd("pipeline");
+    lovrRelease(job.shader, lovrShaderDestroy);
+
+    mtx_lock(&state.compileLock);
+    map_remove(&state.pendingPipelines, hash64(&job.gpu, sizeof(job.gpu)));
+    cnd_broadcast(&state.compileDone);
+  }
+
+  mtx_unlock(&state.compileLock);
+  return 0;
+}
+#endif
+
+// Starts the pipeline compiler threads if they aren't running yet, returns whether any are running
+static bool startPipelineCompilers(void) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.compileLock);
+
+  if (state.compilerCount == 0) {
+    uint32_t cores = os_get_core_count();
+    uint32_t count = cores > 2 ? cores - 2 : 1;
+    count = MIN(count, COUNTOF(state.compilers));
+    for (uint32_t i = 0; i < count; i++) {
+      if (thrd_create(&state.compilers[i], pipelineCompiler, NULL) == thrd_success) {
+        state.compilerCount++;
+      }
+    }
+  }
+
+  bool started = state.compilerCount > 0;
+  mtx_unlock(&state.compileLock);
+  return started;
+#else
+  return false;
+#endif
+}
+
+// Hands a graphics pipeline to the compiler threads.  The Shader is retained until the pipeline is
+// done, since the pipeline info references its flags.
+static void queuePipeline(gpu_pipeline* gpu, gpu_pipeline_info* info, Shader* shader) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.compileLock);
+  PipelineJob job = { gpu, *info, shader };
+  lovrRetain(shader);
+  arr_push(&state.compileQueue, job);
+  map_set(&state.pendingPipelines, hash64(&gpu, sizeof(gpu)), 1);
+  cnd_signal(&state.compileSignal);
+  mtx_unlock(&state.compileLock);
+#endif
+}
+
+static bool isPipelinePending(gpu_pipeline* gpu) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.compileLock);
+  bool pending = state.pendingPipelines.used > 0 && map_get(&state.pendingPipelines, hash64(&gpu, sizeof(gpu))) != MAP_NIL;
+  mtx_unlock(&state.compileLock);
+  return pending;
+#else
+  return false;
+#endif
+}
+
+static void waitForPipeline(gpu_pipeline* gpu) {
+#ifndef LOVR_DISABLE_THREAD
+  mtx_lock(&state.compileLock);
+  while (map_get(&state.pendingPipelines, hash64(&gpu, sizeof(gpu))) != MAP_NIL) {
+    cnd_wait(&state.compileDone, &state.compileLock);
+  }
+  mtx_unlock(&state.compileLock);
+#endif
 }
 
 static int u64cmp(const void* a, const void* b) {
@@ -5502,12 +8582,46 @@ static void beginFrame(void) {
     return;
   }
 
+  lovrProfileBegin("beginFrame");
   state.active = true;
   state.tick = gpu_begin();
+  atomic_fetch_add(&state.allocatorTick, 1);
   state.stream = gpu_stream_begin("Internal");
   state.scratchBufferIndex = 0;
   state.allocator.cursor = 0;
   processReadbacks();
+
+  if (state.timing) {
+    resolveTimings();
+    uint32_t index = state.tick % COUNTOF(state.timingFrames);
+    TimingFrame* frame = &state.timingFrames[index];
+    frame->tick = state.tick;
+    frame->count = 0;
+    frame->time = os_get_time();
+    gpu_clear_tally(state.stream, state.timingTally, index * MAX_PASSES * 2, MAX_PASSES * 2);
+  }
+
+  lovrProfileEnd("beginFrame");
+}
+
+// Large uploads are recorded on the dedicated transfer queue when the GPU has one, so they can
+// overlap with rendering.  Returns NULL if there isn't a transfer queue.  Texture uploads should
+// check transferImages first, otherwise they'd start a transfer stream that ends up empty.
+static gpu_stream* getTransferStream(void) {
+  if (!state.transfer) {
+    state.transfer = gpu_stream_begin_transfer("Transfer");
+  }
+
+  return state.transfer;
+}
+
+// Readbacks are recorded at submit, on the transfer queue after the rest of the frame's work
+static gpu_stream* getReadbackStream(void) {
+  if (!state.readback) {
+    state.readback = gpu_stream_begin_readback("Readback");
+  }
+
+  return state.readback;
 }
 
 static void releasePassResources(void) {
@@ -5533,6 +8647,22 @@ static void releasePassResources(void) {
         pipeline->material = NULL;
       }
     }
+
+    // Draws that were deferred but never submitted
+    for (size_t j = 0; j < pass->deferred.length; j++) {
+      lovrRelease(pass->deferred.data[j].shader, lovrShaderDestroy);
+      lovrRelease(pass->deferred.data[j].material, lovrMaterialDestroy);
+    }
+
+    arr_clear(&pass->deferred);
+
+    // An unfinished Batch references temporary memory from this frame, so it gets discarded
+    if (pass->batch) {
+      pass->batch->pass = NULL;
+      lovrBatchClear(pass->batch);
+      lovrRelease(pass->batch, lovrBatchDestroy);
+      pass->batch = NULL;
+    }
   }
 
   state.passCount = 0;
@@ -5561,12 +8691,148 @@ static void processReadbacks(void) {
   }
 }
 
+// Called from any thread that marks a zone.  Each thread matches up its own zones with a stack in
+// thread-local storage, so there's no limit on the number of threads, and finished zones go in a
+// ring buffer.  An event's ready field counts how many times its slot has been written, and is
+// bumped last, so the resolver can tell whether the slot holds the event it's looking for (only
+// fetch_add is used, for the stdatomic shim).  The stack is reset whenever timing is re-enabled,
+// since zones may have been left open while the callback was removed.
+static void recordTiming(void* userdata, const char* name, bool begin) {
+  static LOVR_THREAD_LOCAL uint32_t thread;
+  static LOVR_THREAD_LOCAL uint32_t generation;
+  static LOVR_THREAD_LOCAL uint32_t depth;
+  static LOVR_THREAD_LOCAL double stack[MAX_TIMING_DEPTH];
+
+  if (!thread) {
+    thread = atomic_fetch_add(&state.timingThreads, 1) + 1;
+  }
+
+  uint32_t current = atomic_fetch_add(&state.timingGeneration, 0);
+
+  if (generation != current) {
+    generation = current;
+    depth = 0;
+  }
+
+  if (begin) {
+    if (depth < MAX_TIMING_DEPTH) stack[depth] = os_get_time();
+    depth++;
+    return;
+  }
+
+  if (depth == 0 || --depth >= MAX_TIMING_DEPTH) {
+    return;
+  }
+
+  uint32_t index = atomic_fetch_add(&state.timingHead, 1);
+  TimingEvent* event = &state.timingEvents[index % MAX_TIMING_EVENTS];
+  event->name = name;
+  event->start = stack[depth];
+  event->duration = os_get_time() - stack[depth];
+  event->thread = thread;
+  atomic_fetch_add(&event->ready, 1);
+}
+
+static void pushTimingZone(const char* name, uint32_t thread, double start, double duration) {
+  if (state.timings.length < MAX_TIMING_ZONES) {
+    TimingZone zone = { .thread = thread, .start = start, .duration = duration };
+    strncpy(zone.name, name, sizeof(zone.name) - 1);
+    arr_push(&state.timings, zone);
+  }
+}
+
+// Collects the CPU zones finished by each thread, and reads back the timestamps of any frames that
+// the GPU has finished
+static void resolveTimings(void) {
+  lock();
+
+  uint32_t head = atomic_fetch_add(&state.timingHead, 0);
+
+  while ((int32_t) (head - state.timingTail) > 0) {
+    TimingEvent* event = &state.timingEvents[state.timingTail % MAX_TIMING_EVENTS];
+    uint32_t writes = atomic_fetch_add(&event->ready, 0);
+    int32_t lag = (int32_t) (writes - (state.timingTail / MAX_TIMING_EVENTS + 1));
+
+    // Still being written, try again later
+    if (lag < 0) {
+      break;
+    }
+
+    // Writers lapped the ring buffer, skip the zones that were lost
+    if (lag > 0) {
+      state.timingTail += lag * MAX_TIMING_EVENTS;
+    }
+
+    pushTimingZone(event->name, event->thread, event->start, event->duration);
+    state.timingTail++;
+  }
+
+  double period = state.limits.timestampPeriod / 1e9;
+
+  for (uint32_t i = 0; i < COUNTOF(state.timingFrames); i++) {
+    TimingFrame* frame = &state.timingFrames[i];
+
+    if (frame->count == 0 || !gpu_is_complete(frame->tick)) {
+      continue;
+    }
+
+    uint32_t base = i * MAX_PASSES * 2;
+    uint32_t first = 0;
+    bool anchored = false;
+
+    for (uint32_t j = 0; j < frame->count; j++) {
+      uint32_t times[2];
+
+      // Passes that were never submitted don't have timestamps
+      if (!gpu_tally_get_data(state.timingTally, base + 2 * j, 2, times)) {
+        continue;
+      }
+
+      if (!anchored) {
+        first = times[0];
+        anchored = true;
+      }
+
+      double start = frame->time + (int32_t) (times[0] - first) * period;
+      double duration = (uint32_t) (times[1] - times[0]) * period;
+      pushTimingZone(frame->names[j], 0, start, duration);
+    }
+
+    frame->count = 0;
+  }
+
+  unlock();
+}
+
+// Creates a builtin shader on first use.  The shader is created outside of the lock since creating
+// it can throw, and if another thread created it in the meantime, that one is used instead.
+static Shader* getBuiltinShader(Shader** slot, ShaderInfo* info) {
+  if (*slot) {
+    return *slot;
+  }
+
+  Shader* shader = lovrShaderCreate(info);
+
+  lock();
+  if (*slot) {
+    unlock();
+    lovrRelease(shader, lovrShaderDestroy);
+    return *slot;
+  }
+
+  *slot = shader;
+  unlock();
+  return shader;
+}
+
 static size_t getLayout(gpu_slot* slots, uint32_t count) {
   uint64_t hash = hash64(slots, count * sizeof(gpu_slot));
 
+  lock();
   size_t index;
   for (size_t index = 0; index < state.layouts.length; index++) {
     if (state.layouts.data[index].hash == hash) {
+      unlock();
       return index;
     }
   }
@@ -5587,10 +8853,29 @@ static size_t getLayout(gpu_slot* slots, uint32_t count) {
 
   index = state.layouts.length;
   arr_push(&state.layouts, layout);
+  unlock();
   return index;
 }
 
-static gpu_bundle* getBundle(size_t layoutIndex) {
+// Allocates a bundle from one of the layout's pools and writes the bindings to it.  The pools are
+// shared by all threads, but the bundle is written outside of the lock.
+static gpu_bundle* getBundle(size_t layoutIndex, gpu_binding* bindings, uint32_t count) {
+  lock();
+  gpu_layout* gpu = state.layouts.data[layoutIndex].gpu;
+  gpu_bundle* bundle = allocateBundle(layoutIndex);
+  unlock();
+
+  gpu_bundle_info info = {
+    .layout = gpu,
+    .bindings = bindings,
+    .count = count
+  };
+
+  gpu_bundle_write(&bundle, &info, 1);
+  return bundle;
+}
+
+static gpu_bundle* allocateBundle(size_t layoutIndex) {
   Layout* layout = &state.layouts.data[layoutIndex];
   BundlePool* pool = layout->head;
   const uint32_t POOL_SIZE = 512;
@@ -5765,6 +9050,151 @@ static void mipmapTexture(gpu_stream* stream, Texture* texture, uint32_t base, u
   }
 }
 
+// Streaming textures are sampled through a view of the mipmaps that have been uploaded so far
+static gpu_texture* getSampleView(Texture* texture) {
+  uint32_t level = texture->baseLevel;
+  return level > 0 ? (gpu_texture*) ((char*) texture->levelViews + (level - 1) * gpu_sizeof_texture()) : texture->gpu;
+}
+
+// Image sizes were already validated by lovrTextureCreate
+static void uploadTextureLevel(Texture* texture, Image** images, uint32_t imageCount, uint32_t level) {
+  const TextureInfo* info = &texture->info;
+  uint32_t width = MAX(info->width >> level, 1);
+  uint32_t height = MAX(info->height >> level, 1);
+  uint32_t size = measureTexture(info->format, width, height, info->layers);
+  uint32_t layerSize = size / info->layers;
+
+  gpu_buffer* scratchpad = tempAlloc(gpu_sizeof_buffer());
+  char* data = gpu_map(scratchpad, size, 64, GPU_MAP_STAGING);
+
+  for (uint32_t layer = 0; layer < info->layers; layer++) {
+    Image* image = imageCount == 1 ? images[0] : images[layer];
+    uint32_t slice = imageCount == 1 ? layer : 0;
+    memcpy(data, lovrImageGetLayerData(image, level, slice), layerSize);
+    data += layerSize;
+  }
+
+  uint32_t dstOffset[4] = { 0, 0, 0, level };
+  uint32_t extent[3] = { width, height, info->layers };
+  gpu_copy_buffer_texture(state.stream, scratchpad, texture->gpu, 0, dstOffset, extent);
+}
+
+// The texture's Material has the old view in its bundle, and may be in use by frames in flight, so
+// it gets replaced instead of rewritten
+static void setTextureBaseLevel(Texture* texture, uint32_t level) {
+  texture->baseLevel = level;
+
+  if (texture->material) {
+    Material* material = createMaterial(&texture->material->info);
+    Material* old = texture->material;
+    texture->material = material;
+
+    // The old Material's reference to the texture was released when it was created, and it will be
+    // released again when the Material is destroyed.  The new Material's reference makes up for it.
+    lovrRelease(old, lovrMaterialDestroy);
+  }
+}
+
+static void removeTextureStream(size_t index) {
+  TextureStream* stream = &state.textureStreams.data[index];
+  for (uint32_t i = 0; i < stream->imageCount; i++) {
+    lovrRelease(stream->images[i], lovrImageDestroy);
+  }
+  Texture* texture = stream->texture;
+  free(stream->images);
+  arr_splice(&state.textureStreams, index, 1);
+  lovrRelease(texture, lovrTextureDestroy);
+}
+
+// Uploads the rest of a streaming texture's mipmaps right away
+static void finishTextureStream(Texture* texture) {
+  if (texture->baseLevel == 0) {
+    return;
+  }
+
+  lock();
+  for (size_t i = 0; i < state.textureStreams.length; i++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+
+    if (stream->texture != texture) {
+      continue;
+    }
+
+    beginFrame();
+
+    gpu_sync(state.stream, &(gpu_barrier) {
+      .prev = GPU_PHASE_ALL,
+      .next = GPU_PHASE_TRANSFER,
+      .clear = GPU_CACHE_TRANSFER_WRITE
+    }, 1);
+
+    for (uint32_t level = texture->baseLevel; level-- > 0;) {
+      uploadTextureLevel(texture, stream->images, stream->imageCount, level);
+    }
+
+    setTextureBaseLevel(texture, 0);
+    removeTextureStream(i);
+    state.hasTextureUpload = true;
+    break;
+  }
+  unlock();
+}
+
+// Uploads the next mipmap level of streaming textures, oldest first, until the staging budget for
+// the frame runs out.  At least one level is uploaded each frame so big levels don't get stuck.
+static void streamTextures(void) {
+  lock();
+
+  for (size_t i = state.textureStreams.length; i-- > 0;) {
+    // If nothing else is using the texture, there's no point in finishing the upload
+    if (state.textureStreams.data[i].texture->ref == 1) {
+      removeTextureStream(i);
+    }
+  }
+
+  if (state.textureStreams.length == 0) {
+    unlock();
+    return;
+  }
+
+  // The levels being written aren't in any of the views used for sampling, this just orders the
+  // uploads after earlier work on the textures
+  gpu_sync(state.stream, &(gpu_barrier) {
+    .prev = GPU_PHASE_ALL,
+    .next = GPU_PHASE_TRANSFER,
+    .clear = GPU_CACHE_TRANSFER_WRITE
+  }, 1);
+
+  uint32_t budget = TEXTURE_STREAM_BUDGET;
+  uint32_t count = 0;
+
+  for (size_t i = 0; i < state.textureStreams.length; i++, count++) {
+    TextureStream* stream = &state.textureStreams.data[i];
+    TextureInfo* info = &stream->texture->info;
+    uint32_t level = stream->texture->baseLevel - 1;
+    uint32_t width = MAX(info->width >> level, 1);
+    uint32_t height = MAX(info->height >> level, 1);
+    uint32_t size = measureTexture(info->format, width, height, info->layers);
+
+    if (size > budget && count > 0) {
+      break;
+    }
+
+    uploadTextureLevel(stream->texture, stream->images, stream->imageCount, level);
+    setTextureBaseLevel(stream->texture, level);
+    budget -= MIN(size, budget);
+  }
+
+  for (uint32_t i = count; i-- > 0;) {
+    if (state.textureStreams.data[i].texture->baseLevel == 0) {
+      removeTextureStream(i);
+    }
+  }
+
+  state.hasTextureUpload = true;
+  unlock();
+}
+
 static ShaderResource* findShaderResource(Shader* shader, const char* name, size_t length, uint32_t slot) {
   if (name) {
     uint32_t hash = (uint32_t) hash64(name, length);
@@ -5824,6 +9254,43 @@ static void trackTexture(Pass* pass, Texture* texture, gpu_phase phase, gpu_cach
   lovrRetain(texture);
 }
 
+// Emits the pending run of shape draws.  When a run has multiple instances, the auto instance bit in
+// the base instance tells lovr.glsl to use the instance index as the DrawID, so each instance gets
+// its own transform and color.
+static void flushShapeRun(Pass* pass) {
+  ShapeRun* run = &pass->run;
+
+  if (run->instances == 0) {
+    return;
+  }
+
+  uint32_t id = run->instances > 1 ? (run->id | AUTO_INSTANCE_BIT) : run->id;
+
+  if (run->indexed) {
+    gpu_draw_indexed(pass->stream, run->count, run->instances, run->start, run->base, id);
+  } else {
+    gpu_draw(pass->stream, run->count, run->instances, run->start, id);
+  }
+
+  run->instances = 0;
+}
+
+// Batches can only be replayed in passes with the same attachment formats, since they store pipelines
+static uint64_t getTargetHash(Pass* pass) {
+  gpu_pipeline_info* info = &pass->pipeline->info;
+  uint32_t key[] = {
+    info->attachmentCount,
+    info->multisample.count,
+    info->viewCount,
+    info->depth.format,
+    info->color[0].format, info->color[0].srgb,
+    info->color[1].format, info->color[1].srgb,
+    info->color[2].format, info->color[2].srgb,
+    info->color[3].format, info->color[3].srgb
+  };
+  return hash64(key, sizeof(key));
+}
+
 static void trackMaterial(Pass* pass, Material* material, gpu_phase phase, gpu_cache cache) {
   if (!material->hasWritableTexture) {
     return;
@@ -5838,6 +9305,46 @@ static void trackMaterial(Pass* pass, Material* material, gpu_phase phase, gpu_c
   trackTexture(pass, material->info.normalTexture, phase, cache);
 }
 
+static void recordReadback(gpu_stream* stream, Readback* readback) {
+  ReadbackInfo* info = &readback->info;
+
+  if (info->type == READBACK_BUFFER) {
+    gpu_copy_buffers(stream, info->buffer.object->gpu, readback->buffer, info->buffer.offset, 0, info->buffer.extent);
+  } else if (info->type == READBACK_TEXTURE) {
+    uint32_t extent[3] = { info->texture.extent[0], info->texture.extent[1], 1 };
+    gpu_copy_texture_buffer(stream, info->texture.object->gpu, readback->buffer, info->texture.offset, 0, extent);
+  }
+
+  readback->pending = false;
+}
+
+// Readbacks are deferred to the transfer queue, so they have to be recorded before anything else in
+// the pass modifies the data they read
+static void flushReadbacks(Pass* pass) {
+  for (uint32_t i = 0; i < pass->readbacks.length; i++) {
+    if (pass->readbacks.data[i]->pending) {
+      recordReadback(pass->stream, pass->readbacks.data[i]);
+    }
+  }
+}
+
+static bool isWrittenLater(Pass** passes, uint32_t count, uint32_t index, Readback* readback) {
+  Sync* sync = readback->info.type == READBACK_BUFFER ?
+    &readback->info.buffer.object->sync :
+    &readback->info.texture.object->sync;
+
+  for (uint32_t i = index + 1; i < count; i++) {
+    for (uint32_t j = 0; j < passes[i]->access.length; j++) {
+      Access* access = &passes[i]->access.data[j];
+      if (access->sync == sync && (access->cache & GPU_CACHE_WRITE_MASK)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
 static void updateModelTransforms(Model* model, uint32_t nodeIndex, float* parent) {
   mat4 global = model->globalTransforms + 16 * nodeIndex;
   NodeTransform* local = &model->localTransforms[nodeIndex];
@@ -5906,10 +9413,11 @@ static void checkShaderFeatures(uint32_t* features, uint32_t count) {
       case 4427: break; // ShaderDrawParameters
       case 4437: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "multigpu");
       case 4439: lovrCheck(state.limits.renderSize[2] > 1, "GPU does not support shader feature #%d: %s", features[i], "multiview"); break;
-      case 5301: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "non-uniform indexing");
+      case 5301: lovrCheck(state.features.bindless, "GPU does not support shader feature #%d: %s", features[i], "non-uniform indexing"); break;
+      case 5302: lovrCheck(state.features.bindless, "GPU does not support shader feature #%d: %s", features[i], "runtime descriptor arrays"); break;
       case 5306: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "non-uniform indexing");
-      case 5307: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "non-uniform indexing");
-      case 5308: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "non-uniform indexing");
+      case 5307: lovrCheck(state.features.bindless, "GPU does not support shader feature #%d: %s", features[i], "non-uniform indexing"); break;
+      case 5308: lovrCheck(state.features.bindless, "GPU does not support shader feature #%d: %s", features[i], "non-uniform indexing"); break;
       case 5309: lovrThrow("Shader uses unsupported feature #%d: %s", features[i], "non-uniform indexing");
       default: lovrThrow("Shader uses unknown feature #%d", features[i]);
     }
@@ -5931,6 +9439,7 @@ static void onResize(uint32_t width, uint32_t height) {
 
 static void onMessage(void* context, const char* message, bool severe) {
   if (severe) {
+    unlockAll();
     lovrThrow("GPU error: %s", message);
   } else {
     lovrLog(LOG_DEBUG, "GPU", message);
@@ -18,6 +18,7 @@ typedef struct Font Font;
 typedef struct Model Model;
 typedef struct Readback Readback;
 typedef struct Tally Tally;
+typedef struct Batch Batch;
 typedef struct Pass Pass;
 
 typedef struct {
@@ -25,8 +26,16 @@ typedef struct {
   bool vsync;
   bool stencil;
   bool antialias;
+  bool asyncPipelines;
+  bool asyncCompute;
+  bool bindless;
   void* cacheData;
   size_t cacheSize;
+  void* spirvCacheData;
+  size_t spirvCacheSize;
+  bool fontCache;
+  void* fontCacheData;
+  size_t fontCacheSize;
 } GraphicsConfig;
 
 typedef struct {
@@ -48,6 +57,7 @@ typedef struct {
   bool float64;
   bool int64;
   bool int16;
+  bool bindless;
 } GraphicsFeatures;
 
 typedef struct {
@@ -83,6 +93,43 @@ typedef struct {
   float pointSize;
 } GraphicsLimits;
 
+typedef enum {
+  MEMORY_BUFFER,
+  MEMORY_STREAM,
+  MEMORY_STAGING,
+  MEMORY_READBACK,
+  MEMORY_TEXTURE,
+  MEMORY_USAGE_COUNT
+} MemoryUsage;
+
+typedef struct {
+  struct {
+    uint64_t allocated;
+    uint64_t used;
+    uint64_t free;
+    uint64_t largestFree;
+    uint32_t blocks;
+    uint32_t allocations;
+  } types[MEMORY_USAGE_COUNT];
+  struct {
+    uint64_t size;
+    uint64_t budget;
+    uint64_t usage;
+    bool deviceLocal;
+  } heaps[16];
+  uint32_t heapCount;
+  bool budget;
+  uint64_t scratchpad[3];
+  uint32_t condemned;
+} GraphicsMemoryStats;
+
+typedef struct {
+  char name[32];
+  uint32_t thread;
+  double start;
+  double duration;
+} TimingZone;
+
 enum {
   TEXTURE_FEATURE_SAMPLE   = (1 << 0),
   TEXTURE_FEATURE_FILTER   = (1 << 1),
@@ -103,6 +150,13 @@ void lovrGraphicsGetFeatures(GraphicsFeatures* features);
 void lovrGraphicsGetLimits(GraphicsLimits* limits);
 bool lovrGraphicsIsFormatSupported(uint32_t format, uint32_t features);
 void lovrGraphicsGetShaderCache(void* data, size_t* size);
+void lovrGraphicsGetSpirvCache(void* data, size_t* size);
+void lovrGraphicsGetFontCache(void* data, size_t* size);
+uint32_t lovrGraphicsGetPendingPipelineCount(void);
+void lovrGraphicsGetMemoryStats(GraphicsMemoryStats* stats);
+bool lovrGraphicsIsTimingEnabled(void);
+void lovrGraphicsSetTimingEnabled(bool enable);
+TimingZone* lovrGraphicsGetTimings(uint32_t* count);
 
 void lovrGraphicsGetBackgroundColor(float background[4]);
 void lovrGraphicsSetBackgroundColor(float background[4]);
@@ -222,6 +276,7 @@ typedef struct {
   uint32_t imageCount;
   struct Image** images;
   const char* label;
+  bool stream;
 } TextureInfo;
 
 Texture* lovrGraphicsGetWindowTexture(void);
@@ -312,6 +367,7 @@ typedef struct {
 } ShaderInfo;
 
 ShaderSource lovrGraphicsCompileShader(ShaderStage stage, ShaderSource* source);
+void lovrGraphicsCompileShaders(const ShaderInfo* infos, Shader** shaders, uint32_t count);
 ShaderSource lovrGraphicsGetDefaultShaderSource(DefaultShader type, ShaderStage stage);
 Shader* lovrGraphicsGetDefaultShader(DefaultShader type);
 Shader* lovrShaderCreate(const ShaderInfo* info);
@@ -393,6 +449,7 @@ float lovrFontGetPixelDensity(Font* font);
 void lovrFontSetPixelDensity(Font* font, float pixelDensity);
 float lovrFontGetLineSpacing(Font* font);
 void lovrFontSetLineSpacing(Font* font, float spacing);
+void lovrFontPrewarm(Font* font, const uint32_t* codepoints, uint32_t count);
 float lovrFontGetKerning(Font* font, uint32_t first, uint32_t second);
 float lovrFontGetWidth(Font* font, ColoredString* strings, uint32_t count);
 void lovrFontGetLines(Font* font, ColoredString* strings, uint32_t count, float wrap, void (*callback)(void* context, const char* string, size_t length), void* context);
@@ -495,6 +552,13 @@ Tally* lovrTallyCreate(const TallyInfo* info);
 void lovrTallyDestroy(void* ref);
 const TallyInfo* lovrTallyGetInfo(Tally* tally);
 
+// Batch
+
+Batch* lovrBatchCreate(void);
+void lovrBatchDestroy(void* ref);
+uint32_t lovrBatchGetCount(Batch* batch);
+void lovrBatchClear(Batch* batch);
+
 // Pass
 
 typedef enum {
@@ -578,8 +642,21 @@ typedef struct {
   PassType type;
   Canvas canvas;
   const char* label;
+  bool async;
 } PassInfo;
 
+typedef struct {
+  uint32_t draws;
+  uint32_t instances;
+  uint32_t pipelineHits;
+  uint32_t pipelineMisses;
+  uint32_t pipelinesCreated;
+  uint32_t bundleWrites;
+  uint64_t vertexBytes;
+  uint64_t indexBytes;
+  uint32_t barriers;
+} PassStats;
+
 Pass* lovrGraphicsGetWindowPass(void);
 Pass* lovrGraphicsGetPass(PassInfo* info);
 void lovrPassDestroy(void* ref);
@@ -590,6 +667,8 @@ uint32_t lovrPassGetViewCount(Pass* pass);
 uint32_t lovrPassGetSampleCount(Pass* pass);
 void lovrPassGetTarget(Pass* pass, Texture* color[4], Texture** depth, uint32_t* count);
 void lovrPassGetClear(Pass* pass, float color[4][4], float* depth, uint8_t* stencil, uint32_t* count);
+uint32_t lovrPassGetBindsSaved(Pass* pass);
+const PassStats* lovrPassGetStats(Pass* pass);
 
 void lovrPassGetViewMatrix(Pass* pass, uint32_t index, float viewMatrix[16]);
 void lovrPassSetViewMatrix(Pass* pass, uint32_t index, float viewMatrix[16]);
@@ -619,8 +698,11 @@ void lovrPassSetMeshMode(Pass* pass, MeshMode mode);
 void lovrPassSetSampler(Pass* pass, Sampler* sampler);
 void lovrPassSetScissor(Pass* pass, uint32_t scissor[4]);
 void lovrPassSetShader(Pass* pass, Shader* shader);
+void lovrPassSetPrewarm(Pass* pass, bool prewarm);
+void lovrPassSetSorting(Pass* pass, bool sorting);
 void lovrPassSetStencilTest(Pass* pass, CompareMode test, uint8_t value, uint8_t mask);
 void lovrPassSetStencilWrite(Pass* pass, StencilAction actions[3], uint8_t value, uint8_t mask);
+void lovrPassSetViewCull(Pass* pass, bool enable);
 void lovrPassSetViewport(Pass* pass, float viewport[4], float depthRange[2]);
 void lovrPassSetWinding(Pass* pass, Winding winding);
 void lovrPassSetWireframe(Pass* pass, bool wireframe);
@@ -647,8 +729,12 @@ void lovrPassMonkey(Pass* pass, float* transform);
 void lovrPassDrawModel(Pass* pass, Model* model, float* transform, uint32_t node, bool recurse, uint32_t instances);
 void lovrPassMesh(Pass* pass, Buffer* vertices, Buffer* indices, float* transform, uint32_t start, uint32_t count, uint32_t instances, uint32_t base);
 void lovrPassMeshIndirect(Pass* pass, Buffer* vertices, Buffer* indices, Buffer* indirect, uint32_t count, uint32_t offset, uint32_t stride);
+void lovrPassBeginBatch(Pass* pass, Batch* batch);
+void lovrPassEndBatch(Pass* pass);
+void lovrPassDrawBatch(Pass* pass, Batch* batch, float* transform);
 
 void lovrPassCompute(Pass* pass, uint32_t x, uint32_t y, uint32_t z, Buffer* indirect, uint32_t offset);
+void lovrPassCull(Pass* pass, Buffer* bounds, Buffer* visible, uint32_t count, Buffer* draws, uint32_t offset, float* viewProjections, uint32_t viewCount);
 
 void lovrPassClearBuffer(Pass* pass, Buffer* buffer, uint32_t offset, uint32_t extent);
 void lovrPassClearTexture(Pass* pass, Texture* texture, float value[4], uint32_t layer, uint32_t layerCount, uint32_t level, uint32_t levelCount);
@@ -178,6 +178,8 @@ void lovrWorldDestroyData(World* world) {
 }
 
 void lovrWorldUpdate(World* world, float dt, CollisionResolver resolver, void* userdata) {
+  lovrProfileBegin("physics");
+
   if (resolver) {
     resolver(world, userdata);
   } else {
@@ -189,6 +191,7 @@ void lovrWorldUpdate(World* world, float dt, CollisionResolver resolver, void* u
   }
 
   dJointGroupEmpty(world->contactGroup);
+  lovrProfileEnd("physics");
 }
 
 int lovrWorldGetStepCount(World* world) {
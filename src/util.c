@@ -36,6 +36,19 @@ void lovrLog(int level, const char* tag, const char* format, ...) {
   va_end(args);
 }
 
+// Profiling
+profileFn* lovrProfileCallback;
+void* lovrProfileUserdata;
+
+void lovrSetProfileCallback(profileFn* callback, void* userdata) {
+  lovrProfileUserdata = userdata;
+#ifdef _MSC_VER
+  *(profileFn* volatile*) &lovrProfileCallback = callback;
+#else
+  __atomic_store_n(&lovrProfileCallback, callback, __ATOMIC_RELEASE);
+#endif
+}
+
 // Refcounting
 #if ATOMIC_INT_LOCK_FREE != 2
 #error "Lock-free integer atomics are not supported on this platform, but are required for refcounting"
@@ -119,12 +132,18 @@ uint64_t map_get(map_t* map, uint64_t hash) {
 }
 
 void map_set(map_t* map, uint64_t hash, uint64_t value) {
-  if (map->used >= (map->size >> 1) + (map->size >> 2)) {
-    map_rehash(map);
+  uint64_t h = map_find(map, hash);
+
+  // Only grow when adding a new key, overwriting an existing one at the load limit shouldn't rehash
+  if (map->hashes[h] == MAP_NIL) {
+    if (map->used >= (map->size >> 1) + (map->size >> 2)) {
+      map_rehash(map);
+      h = map_find(map, hash);
+    }
+
+    map->used++;
   }
 
-  uint64_t h = map_find(map, hash);
-  map->used += map->hashes[h] == MAP_NIL;
   map->hashes[h] = hash;
   map->values[h] = value;
 }
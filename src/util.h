@@ -1,6 +1,8 @@
 #include <stdarg.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #pragma once
 
@@ -46,14 +48,90 @@ enum { LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR };
 void lovrSetLogCallback(logFn* callback, void* userdata);
 void lovrLog(int level, const char* tag, const char* format, ...);
 
-// Hash function (FNV1a)
+// Profiling (zones are only recorded while a profiler is installed, names must be string literals)
+typedef void profileFn(void*, const char*, bool);
+extern profileFn* lovrProfileCallback;
+extern void* lovrProfileUserdata;
+void lovrSetProfileCallback(profileFn* callback, void* userdata);
+#define lovrProfileBegin(name) lovrProfile(name, true)
+#define lovrProfileEnd(name) lovrProfile(name, false)
+
+// The callback can be changed on another thread, so it's loaded once (aligned pointer loads are
+// atomic on the platforms MSVC targets)
+static inline void lovrProfile(const char* name, bool begin) {
+#ifdef _MSC_VER
+  profileFn* callback = *(profileFn* volatile*) &lovrProfileCallback;
+#else
+  profileFn* callback = __atomic_load_n(&lovrProfileCallback, __ATOMIC_ACQUIRE);
+#endif
+  if (callback) callback(lovrProfileUserdata, name, begin);
+}
+
+// Hashing (wyhash, public domain, reads 8 bytes at a time)
+static inline void hash_mul(uint64_t* a, uint64_t* b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t r = (__uint128_t) *a * *b;
+  *a = (uint64_t) r;
+  *b = (uint64_t) (r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t hash_mix(uint64_t a, uint64_t b) {
+  hash_mul(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t hash_read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline uint64_t hash_read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
 static inline uint64_t hash64(const void* data, size_t length) {
-  const uint8_t* bytes = (const uint8_t*) data;
-  uint64_t hash = 0xcbf29ce484222325;
-  for (size_t i = 0; i < length; i++) {
-    hash = (hash ^ bytes[i]) * 0x100000001b3;
+  static const uint64_t secret[] = { 0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47 };
+  const uint8_t* p = (const uint8_t*) data;
+  uint64_t seed = 0xca813bf4c7abf0a9; // hash_mix(secret[0], secret[1])
+  uint64_t a, b;
+
+  if (length <= 16) {
+    if (length >= 4) {
+      a = (hash_read32(p) << 32) | hash_read32(p + ((length >> 3) << 2));
+      b = (hash_read32(p + length - 4) << 32) | hash_read32(p + length - 4 - ((length >> 3) << 2));
+    } else if (length > 0) {
+      a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8) | p[length - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = length;
+    if (i > 48) {
+      uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = hash_mix(hash_read64(p) ^ secret[1], hash_read64(p + 8) ^ seed);
+        seed1 = hash_mix(hash_read64(p + 16) ^ secret[2], hash_read64(p + 24) ^ seed1);
+        seed2 = hash_mix(hash_read64(p + 32) ^ secret[3], hash_read64(p + 40) ^ seed2);
+        p += 48, i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed = hash_mix(hash_read64(p) ^ secret[1], hash_read64(p + 8) ^ seed);
+      p += 16, i -= 16;
+    }
+    a = hash_read64(p + i - 16);
+    b = hash_read64(p + i - 8);
   }
-  return hash;
+
+  a ^= secret[1];
+  b ^= seed;
+  hash_mul(&a, &b);
+  return hash_mix(a ^ secret[0] ^ length, b ^ secret[1]);
 }
 
 // Refcounting